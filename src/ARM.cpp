@@ -17,9 +17,13 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include "NDS.h"
 #include "ARM.h"
 #include "ARMInterpreter.h"
+#include "ARMJIT.h"
+#include "IdleLoop.h"
+#include "Config.h"
 
 
 // instruction timing notes
@@ -82,11 +86,16 @@ void ARM::Reset()
 {
     Cycles = 0;
     Halted = 0;
+    Attention = 1;
+
+    InstrCount = 0;
+    HaltedCycles = 0;
 
     for (int i = 0; i < 16; i++)
         R[i] = 0;
 
     CPSR = 0x000000D3;
+    NZPending = 0;
 
     ExceptionBase = Num ? 0x00000000 : 0xFFFF0000;
 
@@ -112,6 +121,8 @@ void ARM::DoSavestate(Savestate* file)
     file->Var32(&Halted);
 
     file->VarArray(R, 16*sizeof(u32));
+    if (file->Saving) UpdateNZ();
+    else              { NZPending = 0; Attention = 1; }
     file->Var32(&CPSR);
     file->VarArray(R_FIQ, 8*sizeof(u32));
     file->VarArray(R_SVC, 3*sizeof(u32));
@@ -128,7 +139,7 @@ void ARM::DoSavestate(Savestate* file)
         if (!Num)
         {
             SetupCodeMem(R[15]); // should fix it
-            ((ARMv5*)this)->RegionCodeCycles = ((ARMv5*)this)->MemTimings[R[15] >> 12][0];
+            ((ARMv5*)this)->RegionCodeCycles = ((ARMv5*)this)->MemBlocks[R[15] >> 12].Timings[0];
         }
         else
         {
@@ -162,6 +173,10 @@ void ARM::SetupCodeMem(u32 addr)
 
 void ARMv5::JumpTo(u32 addr, bool restorecpsr)
 {
+    // polling loops jump back to their start over and over
+    if (!restorecpsr)
+        IdleLoop::CheckBranch(this, addr);
+
     if (restorecpsr)
     {
         RestoreCPSR();
@@ -180,7 +195,7 @@ void ARMv5::JumpTo(u32 addr, bool restorecpsr)
     u32 oldregion = R[15] >> 24;
     u32 newregion = addr >> 24;
 
-    RegionCodeCycles = MemTimings[addr >> 12][0];
+    RegionCodeCycles = MemBlocks[addr >> 12].Timings[0];
 
     if (addr & 0x1)
     {
@@ -235,6 +250,9 @@ void ARMv5::JumpTo(u32 addr, bool restorecpsr)
 
 void ARMv4::JumpTo(u32 addr, bool restorecpsr)
 {
+    if (!restorecpsr)
+        IdleLoop::CheckBranch(this, addr);
+
     if (restorecpsr)
     {
         RestoreCPSR();
@@ -277,8 +295,73 @@ void ARMv4::JumpTo(u32 addr, bool restorecpsr)
     }
 }
 
+// see ARMv5::GetMultiplePtr()
+u8* ARMv4::GetMultiplePtr(u32 addr, u32 num, bool write)
+{
+    u32 len = num << 2;
+    u32 end = addr + len - 1;
+    if ((addr >> 12) != (end >> 12))
+        return NULL;
+
+    if (addr >= 0x10000000) return NULL;
+    if (write && (addr & 0xFE000000) != 0x02000000)
+        return NULL;
+
+    NDS::MemPage& page = NDS::ARM7ReadMap[addr >> 14];
+    if (!page.Mem || ((addr & page.Mask) + len - 1) > page.Mask)
+        return NULL;
+
+    DataRegion = addr >> 24;
+    DataCycles = NDS::ARM7MemTimings[DataRegion][2] + (num - 1) * NDS::ARM7MemTimings[DataRegion][3];
+    return &page.Mem[addr & page.Mask];
+}
+
+void ARMv4::DataRead32Multiple(u32 addr, u32* vals, u32 num)
+{
+    addr &= ~3;
+
+    u8* mem = GetMultiplePtr(addr, num, false);
+    if (mem)
+    {
+        memcpy(vals, mem, num << 2);
+        return;
+    }
+
+    DataRead32(addr, &vals[0]);
+    for (u32 i = 1; i < num; i++)
+        DataRead32S(addr + (i << 2), &vals[i]);
+}
+
+void ARMv4::DataWrite32Multiple(u32 addr, u32* vals, u32 num)
+{
+    addr &= ~3;
+
+    u8* mem = GetMultiplePtr(addr, num, true);
+    if (mem)
+    {
+        memcpy(mem, vals, num << 2);
+
+        for (u32 i = 0; i < num; i++)
+        {
+            if (DataRegion == 0x02)
+                ARMJIT::InvalidateMainRAMIfNecessary(addr + (i << 2));
+            else if (mem >= NDS::SharedWRAM && mem < &NDS::SharedWRAM[0x8000])
+                ARMJIT::InvalidateSWRAMIfNecessary((mem - NDS::SharedWRAM) + (i << 2));
+            else
+                ARMJIT::InvalidateARM7WRAMIfNecessary(addr + (i << 2));
+        }
+        return;
+    }
+
+    DataWrite32(addr, vals[0]);
+    for (u32 i = 1; i < num; i++)
+        DataWrite32S(addr + (i << 2), vals[i]);
+}
+
 void ARM::RestoreCPSR()
 {
+    // all of CPSR gets replaced
+    NZPending = 0;
     u32 oldcpsr = CPSR;
 
     switch (CPSR & 0x1F)
@@ -316,6 +399,10 @@ void ARM::UpdateMode(u32 oldmode, u32 newmode)
     u32 temp;
     #define SWAP(a, b)  temp = a; a = b; b = temp;
 
+    // everything that writes CPSR comes through here, IRQs may have
+    // been enabled
+    if ((oldmode & ~newmode) & 0x80) Attention = 1;
+
     if ((oldmode & 0x1F) == (newmode & 0x1F)) return;
 
     switch (oldmode & 0x1F)
@@ -401,6 +488,7 @@ void ARM::TriggerIRQ()
     if (CPSR & 0x80)
         return;
 
+    UpdateNZ();
     u32 oldcpsr = CPSR;
     CPSR &= ~0xFF;
     CPSR |= 0xD2;
@@ -415,6 +503,7 @@ void ARMv5::PrefetchAbort()
 {
     printf("prefetch abort\n");
 
+    UpdateNZ();
     u32 oldcpsr = CPSR;
     CPSR &= ~0xBF;
     CPSR |= 0x97;
@@ -438,6 +527,7 @@ void ARMv5::DataAbort()
 {
     printf("data abort\n");
 
+    UpdateNZ();
     u32 oldcpsr = CPSR;
     CPSR &= ~0xBF;
     CPSR |= 0x97;
@@ -450,6 +540,8 @@ void ARMv5::DataAbort()
 
 void ARMv5::Execute()
 {
+    IdleLoop::NewRun(Num);
+
     if (Halted)
     {
         if (Halted == 2)
@@ -464,15 +556,34 @@ void ARMv5::Execute()
         }
         else
         {
+            HaltedCycles += NDS::ARM9Target - NDS::ARM9Timestamp;
             NDS::ARM9Timestamp = NDS::ARM9Target;
             return;
         }
     }
 
+    bool jit = Config::JIT_Enable != 0;
+
     while (NDS::ARM9Timestamp < NDS::ARM9Target)
     {
-        if (CPSR & 0x20) // THUMB
+        // compiled blocks assume they start with no pending cycles, and
+        // that no IRQ is going to be taken after the first instruction
+        ARMJIT::JitBlock* block = NULL;
+        if (jit && !Cycles && !IRQPending())
+            block = ARMJIT::LookUpBlock(this);
+
+        if (block)
+        {
+            // runs until the interpreter loop would have stopped, or until
+            // the end of the block. the checks below are still done for the
+            // last instruction it executed
+            ARMJIT::BlockInvalidated = false;
+            ARMJIT::RunBlock(this, block);
+        }
+        else if (CPSR & 0x20) // THUMB
         {
+            InstrCount++;
+
             // prefetch
             R[15] += 2;
             CurInstr = NextInstr[0];
@@ -482,10 +593,12 @@ void ARMv5::Execute()
 
             // actually execute
             u32 icode = (CurInstr >> 6) & 0x3FF;
-            ARMInterpreter::THUMBInstrTable[icode](this);
+            ARMInterpreter::InstrTables<ARMv5>::THUMBInstrTable[icode](this);
         }
         else
         {
+            InstrCount++;
+
             // prefetch
             R[15] += 4;
             CurInstr = NextInstr[0];
@@ -496,7 +609,7 @@ void ARMv5::Execute()
             if (CheckCondition(CurInstr >> 28))
             {
                 u32 icode = ((CurInstr >> 4) & 0xF) | ((CurInstr >> 16) & 0xFF0);
-                ARMInterpreter::ARMInstrTable[icode](this);
+                ARMInterpreter::InstrTables<ARMv5>::ARMInstrTable[icode](this);
             }
             else if ((CurInstr & 0xFE000000) == 0xFA000000)
             {
@@ -506,19 +619,26 @@ void ARMv5::Execute()
                 AddCycles_C();
         }
 
-        // TODO optimize this shit!!!
-        if (Halted)
+        if (Attention)
         {
-            if (Halted == 1 && NDS::ARM9Timestamp < NDS::ARM9Target)
+            // (stays set when halting, the IRQ check still has to be done
+            // once it's running again)
+            if (Halted)
             {
-                NDS::ARM9Timestamp = NDS::ARM9Target;
+                if (Halted == 1 && NDS::ARM9Timestamp < NDS::ARM9Target)
+                {
+                    HaltedCycles += NDS::ARM9Target - NDS::ARM9Timestamp;
+                    NDS::ARM9Timestamp = NDS::ARM9Target;
+                }
+                break;
+            }
+
+            Attention = 0;
+            if (NDS::IF[0] & NDS::IE[0])
+            {
+                if (NDS::IME[0] & 0x1)
+                    TriggerIRQ();
             }
-            break;
-        }
-        if (NDS::IF[0] & NDS::IE[0])
-        {
-            if (NDS::IME[0] & 0x1)
-                TriggerIRQ();
         }
 
         NDS::ARM9Timestamp += Cycles;
@@ -531,6 +651,8 @@ void ARMv5::Execute()
 
 void ARMv4::Execute()
 {
+    IdleLoop::NewRun(Num);
+
     if (Halted)
     {
         if (Halted == 2)
@@ -545,15 +667,30 @@ void ARMv4::Execute()
         }
         else
         {
+            HaltedCycles += NDS::ARM7Target - NDS::ARM7Timestamp;
             NDS::ARM7Timestamp = NDS::ARM7Target;
             return;
         }
     }
 
+    bool jit = Config::JIT_EnableARM7 != 0;
+
     while (NDS::ARM7Timestamp < NDS::ARM7Target)
     {
-        if (CPSR & 0x20) // THUMB
+        // same deal as the ARM9
+        ARMJIT::JitBlock* block = NULL;
+        if (jit && !Cycles && !IRQPending())
+            block = ARMJIT::LookUpBlock(this);
+
+        if (block)
+        {
+            ARMJIT::BlockInvalidated = false;
+            ARMJIT::RunBlock(this, block);
+        }
+        else if (CPSR & 0x20) // THUMB
         {
+            InstrCount++;
+
             // prefetch
             R[15] += 2;
             CurInstr = NextInstr[0];
@@ -562,10 +699,12 @@ void ARMv4::Execute()
 
             // actually execute
             u32 icode = (CurInstr >> 6);
-            ARMInterpreter::THUMBInstrTable[icode](this);
+            ARMInterpreter::InstrTables<ARMv4>::THUMBInstrTable[icode](this);
         }
         else
         {
+            InstrCount++;
+
             // prefetch
             R[15] += 4;
             CurInstr = NextInstr[0];
@@ -576,25 +715,32 @@ void ARMv4::Execute()
             if (CheckCondition(CurInstr >> 28))
             {
                 u32 icode = ((CurInstr >> 4) & 0xF) | ((CurInstr >> 16) & 0xFF0);
-                ARMInterpreter::ARMInstrTable[icode](this);
+                ARMInterpreter::InstrTables<ARMv4>::ARMInstrTable[icode](this);
             }
             else
                 AddCycles_C();
         }
 
-        // TODO optimize this shit!!!
-        if (Halted)
+        if (Attention)
         {
-            if (Halted == 1 && NDS::ARM7Timestamp < NDS::ARM7Target)
+            // (stays set when halting, the IRQ check still has to be done
+            // once it's running again)
+            if (Halted)
             {
-                NDS::ARM7Timestamp = NDS::ARM7Target;
+                if (Halted == 1 && NDS::ARM7Timestamp < NDS::ARM7Target)
+                {
+                    HaltedCycles += NDS::ARM7Target - NDS::ARM7Timestamp;
+                    NDS::ARM7Timestamp = NDS::ARM7Target;
+                }
+                break;
+            }
+
+            Attention = 0;
+            if (NDS::IF[1] & NDS::IE[1])
+            {
+                if (NDS::IME[1] & 0x1)
+                    TriggerIRQ();
             }
-            break;
-        }
-        if (NDS::IF[1] & NDS::IE[1])
-        {
-            if (NDS::IME[1] & 0x1)
-                TriggerIRQ();
         }
 
         NDS::ARM7Timestamp += Cycles;
@@ -26,6 +26,12 @@
 
 #define ROR(x, n) (((x) >> (n)) | ((x) << (32-(n))))
 
+// keeps computing N/Z the old way next to the lazy flags and complains when
+// they don't match. also scrambles N/Z in CPSR until they're worked out, so
+// anything that reads them without calling UpdateNZ() first goes wrong.
+// the CHECK_LAZYFLAGS CMake option defines it
+//#define DEBUG_CHECK_LAZYFLAGS
+
 enum
 {
     RWFlags_Nonseq = (1<<5),
@@ -49,6 +55,7 @@ public:
     {
         if (halt==2 && Halted==1) return;
         Halted = halt;
+        Attention = 1;
     }
 
     // TODO: is this actually used??
@@ -61,35 +68,68 @@ public:
         }
     }
 
+    // whether TriggerIRQ() would do anything
+    bool IRQPending()
+    {
+        return (NDS::IF[Num] & NDS::IE[Num]) && (NDS::IME[Num] & 0x1) && !(CPSR & 0x80);
+    }
+
     virtual void Execute() = 0;
 
     bool CheckCondition(u32 code)
     {
         if (code == 0xE) return true;
+        UpdateNZ();
         if (ConditionTable[code] & (1 << (CPSR>>28))) return true;
         return false;
     }
 
+    // N and Z are mostly overwritten before anything looks at them, so
+    // flag setting ops only keep the result around. N and Z in CPSR are
+    // stale while NZPending is set, anything that reads them (or copies
+    // CPSR somewhere) needs to call this first. anything that overwrites
+    // them needs to clear NZPending
+    void UpdateNZ()
+    {
+        if (!NZPending) return;
+        NZPending = 0;
+
+        u32 nz = (NZResult & 0x80000000) | (NZResult ? 0 : 0x40000000);
+#ifdef DEBUG_CHECK_LAZYFLAGS
+        if (nz != CheckNZ)
+            printf("ARM%d: lazy N/Z %08X, should be %08X @ %08X\n", Num?7:9, nz, CheckNZ, R[15]);
+#endif
+        CPSR = (CPSR & ~0xC0000000) | nz;
+    }
+
     void SetC(bool c)
     {
         if (c) CPSR |= 0x20000000;
         else CPSR &= ~0x20000000;
     }
 
-    void SetNZ(bool n, bool z)
+    void SetNZ(u32 res)
     {
-        CPSR &= ~0xC0000000;
-        if (n) CPSR |= 0x80000000;
-        if (z) CPSR |= 0x40000000;
+        NZResult = res;
+        NZPending = 1;
+#ifdef DEBUG_CHECK_LAZYFLAGS
+        CheckNZ = 0;
+        if (res & 0x80000000) CheckNZ |= 0x80000000;
+        if (!res) CheckNZ |= 0x40000000;
+        CPSR = (CPSR & ~0xC0000000) | (~CheckNZ & 0xC0000000);
+#endif
     }
 
-    void SetNZCV(bool n, bool z, bool c, bool v)
+    // N from bit 63, Z if all 64 bits are zero
+    void SetNZ64(u64 res)
     {
-        CPSR &= ~0xF0000000;
-        if (n) CPSR |= 0x80000000;
-        if (z) CPSR |= 0x40000000;
-        if (c) CPSR |= 0x20000000;
-        if (v) CPSR |= 0x10000000;
+        SetNZ((u32)(res >> 32) | ((u32)res ? 1 : 0));
+    }
+
+    void SetNZCV(u32 res, bool c, bool v)
+    {
+        SetNZ(res);
+        CPSR = (CPSR & ~0x30000000) | (c ? 0x20000000 : 0) | (v ? 0x10000000 : 0);
     }
 
     void UpdateMode(u32 oldmode, u32 newmode);
@@ -119,6 +159,15 @@ public:
     s32 Cycles;
     u32 Halted;
 
+    // set whenever something changes that may halt the CPU or make it take
+    // an IRQ (Halt(), IF/IE/IME, CPSR I bit getting cleared). the execute
+    // loops only look at the rest when this is set
+    u32 Attention;
+
+    // for NDS::FrameStats
+    u64 InstrCount;
+    u64 HaltedCycles;
+
     u32 CodeRegion;
     s32 CodeCycles;
 
@@ -127,6 +176,11 @@ public:
 
     u32 R[16]; // heh
     u32 CPSR;
+    u32 NZResult;
+    u32 NZPending;
+#ifdef DEBUG_CHECK_LAZYFLAGS
+    u32 CheckNZ;
+#endif
     u32 R_FIQ[8]; // holding SPSR too
     u32 R_SVC[3];
     u32 R_ABT[3];
@@ -142,7 +196,7 @@ public:
     static u32 ConditionTable[16];
 };
 
-class ARMv5 : public ARM
+class ARMv5 final : public ARM
 {
 public:
     ARMv5();
@@ -172,6 +226,10 @@ public:
     void DataWrite32(u32 addr, u32 val);
     void DataWrite32S(u32 addr, u32 val);
 
+    // LDM/STM and friends: one DataRead32() then DataRead32S() for the rest
+    void DataRead32Multiple(u32 addr, u32* vals, u32 num);
+    void DataWrite32Multiple(u32 addr, u32* vals, u32 num);
+
     void AddCycles_C()
     {
         // code only. always nonseq 32-bit for ARM9.
@@ -218,15 +276,31 @@ public:
 
     void UpdateDTCMSetting();
     void UpdateITCMSetting();
+    void UpdateTCMBlocks(u32 addrstart, u32 addrend);
+    void UpdateMemBlocks(u32 addrstart, u32 addrend);
 
     void UpdatePURegions();
 
+    u8* GetMultiplePtr(u32 addr, u32 num, bool write);
+
     u32 RandomLineIndex();
 
     void ICacheLookup(u32 addr);
+    s32 ICacheFindLine(u32 addr);
     void ICacheInvalidateByAddr(u32 addr);
     void ICacheInvalidateAll();
 
+    // these return how long the access takes. elapsed is how far into the
+    // instruction's data accesses it happens
+    s32 DCacheRead(u32 addr, s32 elapsed);
+    s32 DCacheWrite(u32 addr, s32 buscycles, s32 elapsed);
+    s32 DCacheFindLine(u32 addr);
+    void DCacheClean(u32 line);
+    void DCacheInvalidateLine(u32 line);
+    void DCacheInvalidateAll();
+    s32 WriteBufferPush(s32 buscycles, s32 elapsed);
+    void WriteBufferDrain();
+
     void CP15Write(u32 id, u32 val);
     u32 CP15Read(u32 id);
 
@@ -245,6 +319,20 @@ public:
     u32 ICacheTags[64*4];
     u8 ICacheCount[64];
 
+    // only the tags are kept, the data itself always comes from memory
+    u32 DCacheTags[32*4];
+    u8 DCacheDirty[32*4];
+    u8 DCacheCount[32];
+    u32 DCacheLastLine;
+
+    // when each of the 16 write buffer entries is done being written
+    u64 WriteBufferTime[16];
+    u32 WriteBufferPos;
+
+    // bumped whenever lines are filled or invalidated in either cache, ie.
+    // whenever the same code might not take the same time anymore
+    u32 CacheVersion;
+
     u32 PU_CodeCacheable;
     u32 PU_DataCacheable;
     u32 PU_DataCacheWrite;
@@ -261,14 +349,25 @@ public:
     // games operate under system mode, generally
     #define PU_Map PU_PrivMap
 
-    // code/16N/32N/32S
-    u8 MemTimings[0x100000][4];
+    // what each 4KB block looks like to the ARM9, so that accesses only need
+    // one lookup. rebuilt whenever the PU or TCM settings change
+    struct MemBlock
+    {
+        u8 Timings[4];  // code/16N/32N/32S
+        u8 PU;          // same bits as PU_Map
+        u8 TCMEnd;      // the block is TCM up to there, in 512-byte units
+        u8 ITCMEnd;     // and ITCM up to there, it wins over DTCM
+        u8 MemWrite;    // Mem takes writes too (main RAM)
+        u8* Mem;        // the memory past the TCM for reads, from
+                        // NDS::ARM9ReadMap. NULL if it's not plain memory
+    };
+    MemBlock MemBlocks[0x100000];
 
     s32 RegionCodeCycles;
     u8* CurICacheLine;
 };
 
-class ARMv4 : public ARM
+class ARMv4 final : public ARM
 {
 public:
     ARMv4();
@@ -353,6 +452,10 @@ public:
         DataCycles += NDS::ARM7MemTimings[DataRegion][3];
     }
 
+    void DataRead32Multiple(u32 addr, u32* vals, u32 num);
+    void DataWrite32Multiple(u32 addr, u32* vals, u32 num);
+    u8* GetMultiplePtr(u32 addr, u32 num, bool write);
+
 
     void AddCycles_C()
     {
@@ -417,12 +520,4 @@ public:
     }
 };
 
-namespace ARMInterpreter
-{
-
-void A_UNK(ARM* cpu);
-void T_UNK(ARM* cpu);
-
-}
-
 #endif // ARM_H
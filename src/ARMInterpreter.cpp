@@ -19,20 +19,19 @@
 #include <stdio.h>
 #include "NDS.h"
 #include "ARMInterpreter.h"
-#include "ARMInterpreter_ALU.h"
-#include "ARMInterpreter_Branch.h"
-#include "ARMInterpreter_LoadStore.h"
 
 
 namespace ARMInterpreter
 {
 
 
-void A_UNK(ARM* cpu)
+template <typename CPU>
+void A_UNK(CPU* cpu)
 {
     printf("undefined ARM%d instruction %08X @ %08X\n", cpu->Num?7:9, cpu->CurInstr, cpu->R[15]-8);
     //for (int i = 0; i < 16; i++) printf("R%d: %08X\n", i, cpu->R[i]);
     //NDS::Halt();
+    cpu->UpdateNZ();
     u32 oldcpsr = cpu->CPSR;
     cpu->CPSR &= ~0xBF;
     cpu->CPSR |= 0x9B;
@@ -43,10 +42,12 @@ void A_UNK(ARM* cpu)
     cpu->JumpTo(cpu->ExceptionBase + 0x04);
 }
 
-void T_UNK(ARM* cpu)
+template <typename CPU>
+void T_UNK(CPU* cpu)
 {
     printf("undefined THUMB%d instruction %04X @ %08X\n", cpu->Num?7:9, cpu->CurInstr, cpu->R[15]-4);
     //NDS::Halt();
+    cpu->UpdateNZ();
     u32 oldcpsr = cpu->CPSR;
     cpu->CPSR &= ~0xBF;
     cpu->CPSR |= 0x9B;
@@ -59,8 +60,11 @@ void T_UNK(ARM* cpu)
 
 
 
-void A_MSR_IMM(ARM* cpu)
+template <typename CPU>
+void A_MSR_IMM(CPU* cpu)
 {
+    cpu->UpdateNZ();
+
     u32* psr;
     if (cpu->CurInstr & (1<<22))
     {
@@ -101,8 +105,11 @@ void A_MSR_IMM(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void A_MSR_REG(ARM* cpu)
+template <typename CPU>
+void A_MSR_REG(CPU* cpu)
 {
+    cpu->UpdateNZ();
+
     u32* psr;
     if (cpu->CurInstr & (1<<22))
     {
@@ -143,8 +150,11 @@ void A_MSR_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void A_MRS(ARM* cpu)
+template <typename CPU>
+void A_MRS(CPU* cpu)
 {
+    cpu->UpdateNZ();
+
     u32 psr;
     if (cpu->CurInstr & (1<<22))
     {
@@ -166,7 +176,8 @@ void A_MRS(ARM* cpu)
 }
 
 
-void A_MCR(ARM* cpu)
+template <typename CPU>
+void A_MCR(CPU* cpu)
 {
     u32 cp = (cpu->CurInstr >> 8) & 0xF;
     //u32 op = (cpu->CurInstr >> 21) & 0x7;
@@ -176,7 +187,7 @@ void A_MCR(ARM* cpu)
 
     if (cpu->Num==0 && cp==15)
     {
-        ((ARMv5*)cpu)->CP15Write((cn<<8)|(cm<<4)|cpinfo, cpu->R[(cpu->CurInstr>>12)&0xF]);
+        ((ARMv5*)(ARM*)cpu)->CP15Write((cn<<8)|(cm<<4)|cpinfo, cpu->R[(cpu->CurInstr>>12)&0xF]);
     }
     else if (cpu->Num==1 && cp==14)
     {
@@ -191,7 +202,8 @@ void A_MCR(ARM* cpu)
     cpu->AddCycles_CI(1 + 1); // TODO: checkme
 }
 
-void A_MRC(ARM* cpu)
+template <typename CPU>
+void A_MRC(CPU* cpu)
 {
     u32 cp = (cpu->CurInstr >> 8) & 0xF;
     //u32 op = (cpu->CurInstr >> 21) & 0x7;
@@ -201,7 +213,7 @@ void A_MRC(ARM* cpu)
 
     if (cpu->Num==0 && cp==15)
     {
-        cpu->R[(cpu->CurInstr>>12)&0xF] = ((ARMv5*)cpu)->CP15Read((cn<<8)|(cm<<4)|cpinfo);
+        cpu->R[(cpu->CurInstr>>12)&0xF] = ((ARMv5*)(ARM*)cpu)->CP15Read((cn<<8)|(cm<<4)|cpinfo);
     }
     else if (cpu->Num==1 && cp==14)
     {
@@ -218,8 +230,10 @@ void A_MRC(ARM* cpu)
 
 
 
-void A_SVC(ARM* cpu)
+template <typename CPU>
+void A_SVC(CPU* cpu)
 {
+    cpu->UpdateNZ();
     u32 oldcpsr = cpu->CPSR;
     cpu->CPSR &= ~0xBF;
     cpu->CPSR |= 0x93;
@@ -230,8 +244,10 @@ void A_SVC(ARM* cpu)
     cpu->JumpTo(cpu->ExceptionBase + 0x08);
 }
 
-void T_SVC(ARM* cpu)
+template <typename CPU>
+void T_SVC(CPU* cpu)
 {
+    cpu->UpdateNZ();
     u32 oldcpsr = cpu->CPSR;
     cpu->CPSR &= ~0xBF;
     cpu->CPSR |= 0x93;
@@ -244,8 +260,18 @@ void T_SVC(ARM* cpu)
 
 
 
-#define INSTRFUNC_PROTO(x)  void (*x)(ARM* cpu)
+template void A_UNK<ARMv5>(ARMv5* cpu);
+template void A_UNK<ARMv4>(ARMv4* cpu);
+template void T_UNK<ARMv5>(ARMv5* cpu);
+template void T_UNK<ARMv4>(ARMv4* cpu);
+
+
+
+#define INSTRFUNC_PROTO(x)  template <typename CPU> void (*InstrTables<CPU>::x)(CPU* cpu)
 #include "ARM_InstrTable.h"
 #undef INSTRFUNC_PROTO
 
+template struct InstrTables<ARMv5>;
+template struct InstrTables<ARMv4>;
+
 }
@@ -25,10 +25,38 @@
 namespace ARMInterpreter
 {
 
-extern void (*ARMInstrTable[4096])(ARM* cpu);
-extern void (*THUMBInstrTable[1024])(ARM* cpu);
+// the handlers are instantiated separately for the ARM9 and the ARM7, so
+// that memory accesses and cycle counting go straight to the right CPU's
+// functions instead of through virtual calls
 
-void A_BLX_IMM(ARM* cpu); // I'm a special one look at me
+#define INSTRFUNC(x)  template <typename CPU> void x(CPU* cpu);
+
+#include "ARMInterpreter_ALU.h"
+#include "ARMInterpreter_LoadStore.h"
+#include "ARMInterpreter_Branch.h"
+
+INSTRFUNC(A_UNK)
+INSTRFUNC(T_UNK)
+
+INSTRFUNC(A_MSR_IMM)
+INSTRFUNC(A_MSR_REG)
+INSTRFUNC(A_MRS)
+INSTRFUNC(A_MCR)
+INSTRFUNC(A_MRC)
+
+INSTRFUNC(A_SVC)
+INSTRFUNC(T_SVC)
+
+INSTRFUNC(A_BLX_IMM) // I'm a special one look at me
+
+#undef INSTRFUNC
+
+template <typename CPU>
+struct InstrTables
+{
+    static void (*ARMInstrTable[4096])(CPU* cpu);
+    static void (*THUMBInstrTable[1024])(CPU* cpu);
+};
 
 }
 
@@ -17,7 +17,7 @@
 */
 
 #include <stdio.h>
-#include "ARM.h"
+#include "ARMInterpreter.h"
 
 
 #define CARRY_ADD(a, b)  ((0xFFFFFFFF-a) < b)
@@ -139,92 +139,92 @@ namespace ARMInterpreter
 
 #define A_IMPLEMENT_ALU_OP(x,s) \
 \
-void A_##x##_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_IMM(CPU* cpu) \
 { \
     A_CALC_OP2_IMM \
     A_##x(0) \
 } \
-void A_##x##_REG_LSL_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSL_IMM(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(LSL_IMM) \
     A_##x(0) \
 } \
-void A_##x##_REG_LSR_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSR_IMM(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(LSR_IMM) \
     A_##x(0) \
 } \
-void A_##x##_REG_ASR_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ASR_IMM(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(ASR_IMM) \
     A_##x(0) \
 } \
-void A_##x##_REG_ROR_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ROR_IMM(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(ROR_IMM) \
     A_##x(0) \
 } \
-void A_##x##_REG_LSL_REG(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSL_REG(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(LSL_REG) \
     A_##x(1) \
 } \
-void A_##x##_REG_LSR_REG(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSR_REG(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(LSR_REG) \
     A_##x(1) \
 } \
-void A_##x##_REG_ASR_REG(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ASR_REG(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(ASR_REG) \
     A_##x(1) \
 } \
-void A_##x##_REG_ROR_REG(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ROR_REG(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(ROR_REG) \
     A_##x(1) \
 } \
-void A_##x##_IMM_S(ARM* cpu) \
+template <typename CPU> void A_##x##_IMM_S(CPU* cpu) \
 { \
     A_CALC_OP2_IMM \
     A_##x##_S(0) \
 } \
-void A_##x##_REG_LSL_IMM_S(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSL_IMM_S(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(LSL_IMM##s) \
     A_##x##_S(0) \
 } \
-void A_##x##_REG_LSR_IMM_S(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSR_IMM_S(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(LSR_IMM##s) \
     A_##x##_S(0) \
 } \
-void A_##x##_REG_ASR_IMM_S(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ASR_IMM_S(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(ASR_IMM##s) \
     A_##x##_S(0) \
 } \
-void A_##x##_REG_ROR_IMM_S(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ROR_IMM_S(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(ROR_IMM##s) \
     A_##x##_S(0) \
 } \
-void A_##x##_REG_LSL_REG_S(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSL_REG_S(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(LSL_REG##s) \
     A_##x##_S(1) \
 } \
-void A_##x##_REG_LSR_REG_S(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSR_REG_S(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(LSR_REG##s) \
     A_##x##_S(1) \
 } \
-void A_##x##_REG_ASR_REG_S(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ASR_REG_S(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(ASR_REG##s) \
     A_##x##_S(1) \
 } \
-void A_##x##_REG_ROR_REG_S(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ROR_REG_S(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(ROR_REG##s) \
     A_##x##_S(1) \
@@ -232,47 +232,47 @@ void A_##x##_REG_ROR_REG_S(ARM* cpu) \
 
 #define A_IMPLEMENT_ALU_TEST(x,s) \
 \
-void A_##x##_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_IMM(CPU* cpu) \
 { \
     A_CALC_OP2_IMM \
     A_##x(0) \
 } \
-void A_##x##_REG_LSL_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSL_IMM(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(LSL_IMM##s) \
     A_##x(0) \
 } \
-void A_##x##_REG_LSR_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSR_IMM(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(LSR_IMM##s) \
     A_##x(0) \
 } \
-void A_##x##_REG_ASR_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ASR_IMM(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(ASR_IMM##s) \
     A_##x(0) \
 } \
-void A_##x##_REG_ROR_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ROR_IMM(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_IMM(ROR_IMM##s) \
     A_##x(0) \
 } \
-void A_##x##_REG_LSL_REG(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSL_REG(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(LSL_REG##s) \
     A_##x(1) \
 } \
-void A_##x##_REG_LSR_REG(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSR_REG(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(LSR_REG##s) \
     A_##x(1) \
 } \
-void A_##x##_REG_ASR_REG(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ASR_REG(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(ASR_REG##s) \
     A_##x(1) \
 } \
-void A_##x##_REG_ROR_REG(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ROR_REG(CPU* cpu) \
 { \
     A_CALC_OP2_REG_SHIFT_REG(ROR_REG##s) \
     A_##x(1) \
@@ -295,8 +295,7 @@ void A_##x##_REG_ROR_REG(ARM* cpu) \
 #define A_AND_S(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = a & b; \
-    cpu->SetNZ(res & 0x80000000, \
-               !res); \
+    cpu->SetNZ(res); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
     if (((cpu->CurInstr>>12) & 0xF) == 15) \
     { \
@@ -326,8 +325,7 @@ A_IMPLEMENT_ALU_OP(AND,_S)
 #define A_EOR_S(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = a ^ b; \
-    cpu->SetNZ(res & 0x80000000, \
-               !res); \
+    cpu->SetNZ(res); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
     if (((cpu->CurInstr>>12) & 0xF) == 15) \
     { \
@@ -357,8 +355,7 @@ A_IMPLEMENT_ALU_OP(EOR,_S)
 #define A_SUB_S(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = a - b; \
-    cpu->SetNZCV(res & 0x80000000, \
-                 !res, \
+    cpu->SetNZCV(res, \
                  CARRY_SUB(a, b), \
                  OVERFLOW_SUB(a, b, res)); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
@@ -390,8 +387,7 @@ A_IMPLEMENT_ALU_OP(SUB,)
 #define A_RSB_S(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = b - a; \
-    cpu->SetNZCV(res & 0x80000000, \
-                 !res, \
+    cpu->SetNZCV(res, \
                  CARRY_SUB(b, a), \
                  OVERFLOW_SUB(b, a, res)); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
@@ -423,8 +419,7 @@ A_IMPLEMENT_ALU_OP(RSB,)
 #define A_ADD_S(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = a + b; \
-    cpu->SetNZCV(res & 0x80000000, \
-                 !res, \
+    cpu->SetNZCV(res, \
                  CARRY_ADD(a, b), \
                  OVERFLOW_ADD(a, b, res)); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
@@ -458,8 +453,7 @@ A_IMPLEMENT_ALU_OP(ADD,)
     u32 res_tmp = a + b; \
     u32 carry = (cpu->CPSR&0x20000000 ? 1:0); \
     u32 res = res_tmp + carry; \
-    cpu->SetNZCV(res & 0x80000000, \
-                 !res, \
+    cpu->SetNZCV(res, \
                  CARRY_ADD(a, b) | CARRY_ADD(res_tmp, carry), \
                  OVERFLOW_ADD(a, b, res_tmp) | OVERFLOW_ADD(res_tmp, carry, res)); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
@@ -493,8 +487,7 @@ A_IMPLEMENT_ALU_OP(ADC,)
     u32 res_tmp = a - b; \
     u32 carry = (cpu->CPSR&0x20000000 ? 0:1); \
     u32 res = res_tmp - carry; \
-    cpu->SetNZCV(res & 0x80000000, \
-                 !res, \
+    cpu->SetNZCV(res, \
                  CARRY_SUB(a, b) & CARRY_SUB(res_tmp, carry), \
                  OVERFLOW_SUB(a, b, res_tmp) | OVERFLOW_SUB(res_tmp, carry, res)); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
@@ -528,8 +521,7 @@ A_IMPLEMENT_ALU_OP(SBC,)
     u32 res_tmp = b - a; \
     u32 carry = (cpu->CPSR&0x20000000 ? 0:1); \
     u32 res = res_tmp - carry; \
-    cpu->SetNZCV(res & 0x80000000, \
-                 !res, \
+    cpu->SetNZCV(res, \
                  CARRY_SUB(b, a) & CARRY_SUB(res_tmp, carry), \
                  OVERFLOW_SUB(b, a, res_tmp) | OVERFLOW_SUB(res_tmp, carry, res)); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
@@ -548,8 +540,7 @@ A_IMPLEMENT_ALU_OP(RSC,)
 #define A_TST(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = a & b; \
-    cpu->SetNZ(res & 0x80000000, \
-               !res); \
+    cpu->SetNZ(res); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C();
 
 A_IMPLEMENT_ALU_TEST(TST,_S)
@@ -558,8 +549,7 @@ A_IMPLEMENT_ALU_TEST(TST,_S)
 #define A_TEQ(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = a ^ b; \
-    cpu->SetNZ(res & 0x80000000, \
-               !res); \
+    cpu->SetNZ(res); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C();
 
 A_IMPLEMENT_ALU_TEST(TEQ,_S)
@@ -568,8 +558,7 @@ A_IMPLEMENT_ALU_TEST(TEQ,_S)
 #define A_CMP(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = a - b; \
-    cpu->SetNZCV(res & 0x80000000, \
-                 !res, \
+    cpu->SetNZCV(res, \
                  CARRY_SUB(a, b), \
                  OVERFLOW_SUB(a, b, res)); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C();
@@ -580,8 +569,7 @@ A_IMPLEMENT_ALU_TEST(CMP,)
 #define A_CMN(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = a + b; \
-    cpu->SetNZCV(res & 0x80000000, \
-                 !res, \
+    cpu->SetNZCV(res, \
                  CARRY_ADD(a, b), \
                  OVERFLOW_ADD(a, b, res)); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C();
@@ -605,8 +593,7 @@ A_IMPLEMENT_ALU_TEST(CMN,)
 #define A_ORR_S(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = a | b; \
-    cpu->SetNZ(res & 0x80000000, \
-               !res); \
+    cpu->SetNZ(res); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
     if (((cpu->CurInstr>>12) & 0xF) == 15) \
     { \
@@ -632,8 +619,7 @@ A_IMPLEMENT_ALU_OP(ORR,_S)
     }
 
 #define A_MOV_S(c) \
-    cpu->SetNZ(b & 0x80000000, \
-               !b); \
+    cpu->SetNZ(b); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
     if (((cpu->CurInstr>>12) & 0xF) == 15) \
     { \
@@ -647,7 +633,8 @@ A_IMPLEMENT_ALU_OP(ORR,_S)
 A_IMPLEMENT_ALU_OP(MOV,_S)
 
 // debug hook
-void A_MOV_REG_LSL_IMM_DBG(ARM* cpu)
+template <typename CPU>
+void A_MOV_REG_LSL_IMM_DBG(CPU* cpu)
 {
     A_MOV_REG_LSL_IMM(cpu);
 
@@ -678,8 +665,7 @@ void A_MOV_REG_LSL_IMM_DBG(ARM* cpu)
 #define A_BIC_S(c) \
     u32 a = cpu->R[(cpu->CurInstr>>16) & 0xF]; \
     u32 res = a & ~b; \
-    cpu->SetNZ(res & 0x80000000, \
-               !res); \
+    cpu->SetNZ(res); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
     if (((cpu->CurInstr>>12) & 0xF) == 15) \
     { \
@@ -707,8 +693,7 @@ A_IMPLEMENT_ALU_OP(BIC,_S)
 
 #define A_MVN_S(c) \
     b = ~b; \
-    cpu->SetNZ(b & 0x80000000, \
-               !b); \
+    cpu->SetNZ(b); \
     if (c) cpu->AddCycles_CI(c); else cpu->AddCycles_C(); \
     if (((cpu->CurInstr>>12) & 0xF) == 15) \
     { \
@@ -723,7 +708,8 @@ A_IMPLEMENT_ALU_OP(MVN,_S)
 
 
 
-void A_MUL(ARM* cpu)
+template <typename CPU>
+void A_MUL(CPU* cpu)
 {
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
@@ -733,8 +719,7 @@ void A_MUL(ARM* cpu)
     cpu->R[(cpu->CurInstr >> 16) & 0xF] = res;
     if (cpu->CurInstr & (1<<20))
     {
-        cpu->SetNZ(res & 0x80000000,
-                   !res);
+        cpu->SetNZ(res);
         if (cpu->Num==1) cpu->SetC(0);
     }
 
@@ -752,7 +737,8 @@ void A_MUL(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_MLA(ARM* cpu)
+template <typename CPU>
+void A_MLA(CPU* cpu)
 {
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
@@ -763,8 +749,7 @@ void A_MLA(ARM* cpu)
     cpu->R[(cpu->CurInstr >> 16) & 0xF] = res;
     if (cpu->CurInstr & (1<<20))
     {
-        cpu->SetNZ(res & 0x80000000,
-                   !res);
+        cpu->SetNZ(res);
         if (cpu->Num==1) cpu->SetC(0);
     }
 
@@ -782,7 +767,8 @@ void A_MLA(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_UMULL(ARM* cpu)
+template <typename CPU>
+void A_UMULL(CPU* cpu)
 {
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
@@ -793,8 +779,7 @@ void A_UMULL(ARM* cpu)
     cpu->R[(cpu->CurInstr >> 16) & 0xF] = (u32)(res >> 32ULL);
     if (cpu->CurInstr & (1<<20))
     {
-        cpu->SetNZ((u32)(res >> 63ULL),
-                   !res);
+        cpu->SetNZ64(res);
         if (cpu->Num==1) cpu->SetC(0);
     }
 
@@ -812,7 +797,8 @@ void A_UMULL(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_UMLAL(ARM* cpu)
+template <typename CPU>
+void A_UMLAL(CPU* cpu)
 {
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
@@ -826,8 +812,7 @@ void A_UMLAL(ARM* cpu)
     cpu->R[(cpu->CurInstr >> 16) & 0xF] = (u32)(res >> 32ULL);
     if (cpu->CurInstr & (1<<20))
     {
-        cpu->SetNZ((u32)(res >> 63ULL),
-                   !res);
+        cpu->SetNZ64(res);
         if (cpu->Num==1) cpu->SetC(0);
     }
 
@@ -845,7 +830,8 @@ void A_UMLAL(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_SMULL(ARM* cpu)
+template <typename CPU>
+void A_SMULL(CPU* cpu)
 {
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
@@ -856,8 +842,7 @@ void A_SMULL(ARM* cpu)
     cpu->R[(cpu->CurInstr >> 16) & 0xF] = (u32)(res >> 32ULL);
     if (cpu->CurInstr & (1<<20))
     {
-        cpu->SetNZ((u32)(res >> 63ULL),
-                   !res);
+        cpu->SetNZ64(res);
         if (cpu->Num==1) cpu->SetC(0);
     }
 
@@ -875,7 +860,8 @@ void A_SMULL(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_SMLAL(ARM* cpu)
+template <typename CPU>
+void A_SMLAL(CPU* cpu)
 {
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
@@ -889,8 +875,7 @@ void A_SMLAL(ARM* cpu)
     cpu->R[(cpu->CurInstr >> 16) & 0xF] = (u32)(res >> 32ULL);
     if (cpu->CurInstr & (1<<20))
     {
-        cpu->SetNZ((u32)(res >> 63ULL),
-                   !res);
+        cpu->SetNZ64(res);
         if (cpu->Num==1) cpu->SetC(0);
     }
 
@@ -908,7 +893,8 @@ void A_SMLAL(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_SMLAxy(ARM* cpu)
+template <typename CPU>
+void A_SMLAxy(CPU* cpu)
 {
     if (cpu->Num != 0) return;
 
@@ -931,7 +917,8 @@ void A_SMLAxy(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_SMLAWy(ARM* cpu)
+template <typename CPU>
+void A_SMLAWy(CPU* cpu)
 {
     if (cpu->Num != 0) return;
 
@@ -952,7 +939,8 @@ void A_SMLAWy(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_SMULxy(ARM* cpu)
+template <typename CPU>
+void A_SMULxy(CPU* cpu)
 {
     if (cpu->Num != 0) return;
 
@@ -970,7 +958,8 @@ void A_SMULxy(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_SMULWy(ARM* cpu)
+template <typename CPU>
+void A_SMULWy(CPU* cpu)
 {
     if (cpu->Num != 0) return;
 
@@ -986,7 +975,8 @@ void A_SMULWy(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_SMLALxy(ARM* cpu)
+template <typename CPU>
+void A_SMLALxy(CPU* cpu)
 {
     if (cpu->Num != 0) return;
 
@@ -1011,7 +1001,8 @@ void A_SMLALxy(ARM* cpu)
 
 
 
-void A_CLZ(ARM* cpu)
+template <typename CPU>
+void A_CLZ(CPU* cpu)
 {
     if (cpu->Num != 0) return A_UNK(cpu);
 
@@ -1035,7 +1026,8 @@ void A_CLZ(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void A_QADD(ARM* cpu)
+template <typename CPU>
+void A_QADD(CPU* cpu)
 {
     if (cpu->Num != 0) return A_UNK(cpu);
 
@@ -1053,7 +1045,8 @@ void A_QADD(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_QSUB(ARM* cpu)
+template <typename CPU>
+void A_QSUB(CPU* cpu)
 {
     if (cpu->Num != 0) return A_UNK(cpu);
 
@@ -1071,7 +1064,8 @@ void A_QSUB(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_QDADD(ARM* cpu)
+template <typename CPU>
+void A_QDADD(CPU* cpu)
 {
     if (cpu->Num != 0) return A_UNK(cpu);
 
@@ -1097,7 +1091,8 @@ void A_QDADD(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_QDSUB(ARM* cpu)
+template <typename CPU>
+void A_QDSUB(CPU* cpu)
 {
     if (cpu->Num != 0) return A_UNK(cpu);
 
@@ -1129,195 +1124,196 @@ void A_QDSUB(ARM* cpu)
 
 
 
-void T_LSL_IMM(ARM* cpu)
+template <typename CPU>
+void T_LSL_IMM(CPU* cpu)
 {
     u32 op = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 s = (cpu->CurInstr >> 6) & 0x1F;
     LSL_IMM_S(op, s);
     cpu->R[cpu->CurInstr & 0x7] = op;
-    cpu->SetNZ(op & 0x80000000,
-               !op);
+    cpu->SetNZ(op);
     cpu->AddCycles_C();
 }
 
-void T_LSR_IMM(ARM* cpu)
+template <typename CPU>
+void T_LSR_IMM(CPU* cpu)
 {
     u32 op = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 s = (cpu->CurInstr >> 6) & 0x1F;
     LSR_IMM_S(op, s);
     cpu->R[cpu->CurInstr & 0x7] = op;
-    cpu->SetNZ(op & 0x80000000,
-               !op);
+    cpu->SetNZ(op);
     cpu->AddCycles_C();
 }
 
-void T_ASR_IMM(ARM* cpu)
+template <typename CPU>
+void T_ASR_IMM(CPU* cpu)
 {
     u32 op = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 s = (cpu->CurInstr >> 6) & 0x1F;
     ASR_IMM_S(op, s);
     cpu->R[cpu->CurInstr & 0x7] = op;
-    cpu->SetNZ(op & 0x80000000,
-               !op);
+    cpu->SetNZ(op);
     cpu->AddCycles_C();
 }
 
-void T_ADD_REG_(ARM* cpu)
+template <typename CPU>
+void T_ADD_REG_(CPU* cpu)
 {
     u32 a = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 6) & 0x7];
     u32 res = a + b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_ADD(a, b),
                  OVERFLOW_ADD(a, b, res));
     cpu->AddCycles_C();
 }
 
-void T_SUB_REG_(ARM* cpu)
+template <typename CPU>
+void T_SUB_REG_(CPU* cpu)
 {
     u32 a = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 6) & 0x7];
     u32 res = a - b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_SUB(a, b),
                  OVERFLOW_SUB(a, b, res));
     cpu->AddCycles_C();
 }
 
-void T_ADD_IMM_(ARM* cpu)
+template <typename CPU>
+void T_ADD_IMM_(CPU* cpu)
 {
     u32 a = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 b = (cpu->CurInstr >> 6) & 0x7;
     u32 res = a + b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_ADD(a, b),
                  OVERFLOW_ADD(a, b, res));
     cpu->AddCycles_C();
 }
 
-void T_SUB_IMM_(ARM* cpu)
+template <typename CPU>
+void T_SUB_IMM_(CPU* cpu)
 {
     u32 a = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 b = (cpu->CurInstr >> 6) & 0x7;
     u32 res = a - b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_SUB(a, b),
                  OVERFLOW_SUB(a, b, res));
     cpu->AddCycles_C();
 }
 
-void T_MOV_IMM(ARM* cpu)
+template <typename CPU>
+void T_MOV_IMM(CPU* cpu)
 {
     u32 b = cpu->CurInstr & 0xFF;
     cpu->R[(cpu->CurInstr >> 8) & 0x7] = b;
-    cpu->SetNZ(0,
-               !b);
+    cpu->SetNZ(b);
     cpu->AddCycles_C();
 }
 
-void T_CMP_IMM(ARM* cpu)
+template <typename CPU>
+void T_CMP_IMM(CPU* cpu)
 {
     u32 a = cpu->R[(cpu->CurInstr >> 8) & 0x7];
     u32 b = cpu->CurInstr & 0xFF;
     u32 res = a - b;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_SUB(a, b),
                  OVERFLOW_SUB(a, b, res));
     cpu->AddCycles_C();
 }
 
-void T_ADD_IMM(ARM* cpu)
+template <typename CPU>
+void T_ADD_IMM(CPU* cpu)
 {
     u32 a = cpu->R[(cpu->CurInstr >> 8) & 0x7];
     u32 b = cpu->CurInstr & 0xFF;
     u32 res = a + b;
     cpu->R[(cpu->CurInstr >> 8) & 0x7] = res;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_ADD(a, b),
                  OVERFLOW_ADD(a, b, res));
     cpu->AddCycles_C();
 }
 
-void T_SUB_IMM(ARM* cpu)
+template <typename CPU>
+void T_SUB_IMM(CPU* cpu)
 {
     u32 a = cpu->R[(cpu->CurInstr >> 8) & 0x7];
     u32 b = cpu->CurInstr & 0xFF;
     u32 res = a - b;
     cpu->R[(cpu->CurInstr >> 8) & 0x7] = res;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_SUB(a, b),
                  OVERFLOW_SUB(a, b, res));
     cpu->AddCycles_C();
 }
 
 
-void T_AND_REG(ARM* cpu)
+template <typename CPU>
+void T_AND_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a & b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZ(res & 0x80000000,
-               !res);
+    cpu->SetNZ(res);
     cpu->AddCycles_C();
 }
 
-void T_EOR_REG(ARM* cpu)
+template <typename CPU>
+void T_EOR_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a ^ b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZ(res & 0x80000000,
-               !res);
+    cpu->SetNZ(res);
     cpu->AddCycles_C();
 }
 
-void T_LSL_REG(ARM* cpu)
+template <typename CPU>
+void T_LSL_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7] & 0xFF;
     LSL_REG_S(a, b);
     cpu->R[cpu->CurInstr & 0x7] = a;
-    cpu->SetNZ(a & 0x80000000,
-               !a);
+    cpu->SetNZ(a);
     cpu->AddCycles_CI(1);
 }
 
-void T_LSR_REG(ARM* cpu)
+template <typename CPU>
+void T_LSR_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7] & 0xFF;
     LSR_REG_S(a, b);
     cpu->R[cpu->CurInstr & 0x7] = a;
-    cpu->SetNZ(a & 0x80000000,
-               !a);
+    cpu->SetNZ(a);
     cpu->AddCycles_CI(1);
 }
 
-void T_ASR_REG(ARM* cpu)
+template <typename CPU>
+void T_ASR_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7] & 0xFF;
     ASR_REG_S(a, b);
     cpu->R[cpu->CurInstr & 0x7] = a;
-    cpu->SetNZ(a & 0x80000000,
-               !a);
+    cpu->SetNZ(a);
     cpu->AddCycles_CI(1);
 }
 
-void T_ADC_REG(ARM* cpu)
+template <typename CPU>
+void T_ADC_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
@@ -1325,14 +1321,14 @@ void T_ADC_REG(ARM* cpu)
     u32 carry = (cpu->CPSR&0x20000000 ? 1:0);
     u32 res = res_tmp + carry;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_ADD(a, b) | CARRY_ADD(res_tmp, carry),
                  OVERFLOW_ADD(a, b, res_tmp) | OVERFLOW_ADD(res_tmp, carry, res));
     cpu->AddCycles_C();
 }
 
-void T_SBC_REG(ARM* cpu)
+template <typename CPU>
+void T_SBC_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
@@ -1340,89 +1336,88 @@ void T_SBC_REG(ARM* cpu)
     u32 carry = (cpu->CPSR&0x20000000 ? 0:1);
     u32 res = res_tmp - carry;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_SUB(a, b) & CARRY_SUB(res_tmp, carry),
                  OVERFLOW_SUB(a, b, res_tmp) | OVERFLOW_SUB(res_tmp, carry, res));
     cpu->AddCycles_C();
 }
 
-void T_ROR_REG(ARM* cpu)
+template <typename CPU>
+void T_ROR_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7] & 0xFF;
     ROR_REG_S(a, b);
     cpu->R[cpu->CurInstr & 0x7] = a;
-    cpu->SetNZ(a & 0x80000000,
-               !a);
+    cpu->SetNZ(a);
     cpu->AddCycles_CI(1);
 }
 
-void T_TST_REG(ARM* cpu)
+template <typename CPU>
+void T_TST_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a & b;
-    cpu->SetNZ(res & 0x80000000,
-               !res);
+    cpu->SetNZ(res);
     cpu->AddCycles_C();
 }
 
-void T_NEG_REG(ARM* cpu)
+template <typename CPU>
+void T_NEG_REG(CPU* cpu)
 {
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = -b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_SUB(0, b),
                  OVERFLOW_SUB(0, b, res));
     cpu->AddCycles_C();
 }
 
-void T_CMP_REG(ARM* cpu)
+template <typename CPU>
+void T_CMP_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a - b;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_SUB(a, b),
                  OVERFLOW_SUB(a, b, res));
     cpu->AddCycles_C();
 }
 
-void T_CMN_REG(ARM* cpu)
+template <typename CPU>
+void T_CMN_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a + b;
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_ADD(a, b),
                  OVERFLOW_ADD(a, b, res));
     cpu->AddCycles_C();
 }
 
-void T_ORR_REG(ARM* cpu)
+template <typename CPU>
+void T_ORR_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a | b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZ(res & 0x80000000,
-               !res);
+    cpu->SetNZ(res);
     cpu->AddCycles_C();
 }
 
-void T_MUL_REG(ARM* cpu)
+template <typename CPU>
+void T_MUL_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a * b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZ(res & 0x80000000,
-               !res);
+    cpu->SetNZ(res);
 
     s32 cycles = 0;
     if (cpu->Num == 0)
@@ -1440,24 +1435,24 @@ void T_MUL_REG(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void T_BIC_REG(ARM* cpu)
+template <typename CPU>
+void T_BIC_REG(CPU* cpu)
 {
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a & ~b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZ(res & 0x80000000,
-               !res);
+    cpu->SetNZ(res);
     cpu->AddCycles_C();
 }
 
-void T_MVN_REG(ARM* cpu)
+template <typename CPU>
+void T_MVN_REG(CPU* cpu)
 {
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = ~b;
     cpu->R[cpu->CurInstr & 0x7] = res;
-    cpu->SetNZ(res & 0x80000000,
-               !res);
+    cpu->SetNZ(res);
     cpu->AddCycles_C();
 }
 
@@ -1465,7 +1460,8 @@ void T_MVN_REG(ARM* cpu)
 // TODO: check those when MSBs and MSBd are cleared
 // GBAtek says it's not allowed, but it works atleast on the ARM9
 
-void T_ADD_HIREG(ARM* cpu)
+template <typename CPU>
+void T_ADD_HIREG(CPU* cpu)
 {
     u32 rd = (cpu->CurInstr & 0x7) | ((cpu->CurInstr >> 4) & 0x8);
     u32 rs = (cpu->CurInstr >> 3) & 0xF;
@@ -1485,7 +1481,8 @@ void T_ADD_HIREG(ARM* cpu)
     }
 }
 
-void T_CMP_HIREG(ARM* cpu)
+template <typename CPU>
+void T_CMP_HIREG(CPU* cpu)
 {
     u32 rd = (cpu->CurInstr & 0x7) | ((cpu->CurInstr >> 4) & 0x8);
     u32 rs = (cpu->CurInstr >> 3) & 0xF;
@@ -1494,14 +1491,14 @@ void T_CMP_HIREG(ARM* cpu)
     u32 b = cpu->R[rs];
     u32 res = a - b;
 
-    cpu->SetNZCV(res & 0x80000000,
-                 !res,
+    cpu->SetNZCV(res,
                  CARRY_SUB(a, b),
                  OVERFLOW_SUB(a, b, res));
     cpu->AddCycles_C();
 }
 
-void T_MOV_HIREG(ARM* cpu)
+template <typename CPU>
+void T_MOV_HIREG(CPU* cpu)
 {
     u32 rd = (cpu->CurInstr & 0x7) | ((cpu->CurInstr >> 4) & 0x8);
     u32 rs = (cpu->CurInstr >> 3) & 0xF;
@@ -1528,7 +1525,8 @@ void T_MOV_HIREG(ARM* cpu)
 }
 
 
-void T_ADD_PCREL(ARM* cpu)
+template <typename CPU>
+void T_ADD_PCREL(CPU* cpu)
 {
     u32 val = cpu->R[15] & ~2;
     val += ((cpu->CurInstr & 0xFF) << 2);
@@ -1536,7 +1534,8 @@ void T_ADD_PCREL(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_ADD_SPREL(ARM* cpu)
+template <typename CPU>
+void T_ADD_SPREL(CPU* cpu)
 {
     u32 val = cpu->R[13];
     val += ((cpu->CurInstr & 0xFF) << 2);
@@ -1544,7 +1543,8 @@ void T_ADD_SPREL(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_ADD_SP(ARM* cpu)
+template <typename CPU>
+void T_ADD_SP(CPU* cpu)
 {
     u32 val = cpu->R[13];
     if (cpu->CurInstr & (1<<7))
@@ -1556,4 +1556,8 @@ void T_ADD_SP(ARM* cpu)
 }
 
 
+#define INSTRFUNC(x)  template void x<ARMv5>(ARMv5* cpu); template void x<ARMv4>(ARMv4* cpu);
+#include "ARMInterpreter_ALU.h"
+#undef INSTRFUNC
+
 }
@@ -16,44 +16,41 @@
     with melonDS. If not, see http://www.gnu.org/licenses/.
 */
 
-#ifndef ARMINTERPRETER_ALU_H
-#define ARMINTERPRETER_ALU_H
-
-namespace ARMInterpreter
-{
+// list of the ALU instruction handlers
+// this is included with INSTRFUNC(x) defined, see ARMInterpreter.h
 
 #define A_PROTO_ALU_OP(x) \
 \
-void A_##x##_IMM(ARM* cpu); \
-void A_##x##_REG_LSL_IMM(ARM* cpu); \
-void A_##x##_REG_LSR_IMM(ARM* cpu); \
-void A_##x##_REG_ASR_IMM(ARM* cpu); \
-void A_##x##_REG_ROR_IMM(ARM* cpu); \
-void A_##x##_REG_LSL_REG(ARM* cpu); \
-void A_##x##_REG_LSR_REG(ARM* cpu); \
-void A_##x##_REG_ASR_REG(ARM* cpu); \
-void A_##x##_REG_ROR_REG(ARM* cpu); \
-void A_##x##_IMM_S(ARM* cpu); \
-void A_##x##_REG_LSL_IMM_S(ARM* cpu); \
-void A_##x##_REG_LSR_IMM_S(ARM* cpu); \
-void A_##x##_REG_ASR_IMM_S(ARM* cpu); \
-void A_##x##_REG_ROR_IMM_S(ARM* cpu); \
-void A_##x##_REG_LSL_REG_S(ARM* cpu); \
-void A_##x##_REG_LSR_REG_S(ARM* cpu); \
-void A_##x##_REG_ASR_REG_S(ARM* cpu); \
-void A_##x##_REG_ROR_REG_S(ARM* cpu);
+INSTRFUNC(A_##x##_IMM) \
+INSTRFUNC(A_##x##_REG_LSL_IMM) \
+INSTRFUNC(A_##x##_REG_LSR_IMM) \
+INSTRFUNC(A_##x##_REG_ASR_IMM) \
+INSTRFUNC(A_##x##_REG_ROR_IMM) \
+INSTRFUNC(A_##x##_REG_LSL_REG) \
+INSTRFUNC(A_##x##_REG_LSR_REG) \
+INSTRFUNC(A_##x##_REG_ASR_REG) \
+INSTRFUNC(A_##x##_REG_ROR_REG) \
+INSTRFUNC(A_##x##_IMM_S) \
+INSTRFUNC(A_##x##_REG_LSL_IMM_S) \
+INSTRFUNC(A_##x##_REG_LSR_IMM_S) \
+INSTRFUNC(A_##x##_REG_ASR_IMM_S) \
+INSTRFUNC(A_##x##_REG_ROR_IMM_S) \
+INSTRFUNC(A_##x##_REG_LSL_REG_S) \
+INSTRFUNC(A_##x##_REG_LSR_REG_S) \
+INSTRFUNC(A_##x##_REG_ASR_REG_S) \
+INSTRFUNC(A_##x##_REG_ROR_REG_S)
 
 #define A_PROTO_ALU_TEST(x) \
 \
-void A_##x##_IMM(ARM* cpu); \
-void A_##x##_REG_LSL_IMM(ARM* cpu); \
-void A_##x##_REG_LSR_IMM(ARM* cpu); \
-void A_##x##_REG_ASR_IMM(ARM* cpu); \
-void A_##x##_REG_ROR_IMM(ARM* cpu); \
-void A_##x##_REG_LSL_REG(ARM* cpu); \
-void A_##x##_REG_LSR_REG(ARM* cpu); \
-void A_##x##_REG_ASR_REG(ARM* cpu); \
-void A_##x##_REG_ROR_REG(ARM* cpu);
+INSTRFUNC(A_##x##_IMM) \
+INSTRFUNC(A_##x##_REG_LSL_IMM) \
+INSTRFUNC(A_##x##_REG_LSR_IMM) \
+INSTRFUNC(A_##x##_REG_ASR_IMM) \
+INSTRFUNC(A_##x##_REG_ROR_IMM) \
+INSTRFUNC(A_##x##_REG_LSL_REG) \
+INSTRFUNC(A_##x##_REG_LSR_REG) \
+INSTRFUNC(A_##x##_REG_ASR_REG) \
+INSTRFUNC(A_##x##_REG_ROR_REG)
 
 A_PROTO_ALU_OP(AND)
 A_PROTO_ALU_OP(EOR)
@@ -72,66 +69,65 @@ A_PROTO_ALU_OP(MOV)
 A_PROTO_ALU_OP(BIC)
 A_PROTO_ALU_OP(MVN)
 
-void A_MOV_REG_LSL_IMM_DBG(ARM* cpu);
-
-void A_MUL(ARM* cpu);
-void A_MLA(ARM* cpu);
-void A_UMULL(ARM* cpu);
-void A_UMLAL(ARM* cpu);
-void A_SMULL(ARM* cpu);
-void A_SMLAL(ARM* cpu);
-void A_SMLAxy(ARM* cpu);
-void A_SMLAWy(ARM* cpu);
-void A_SMULxy(ARM* cpu);
-void A_SMULWy(ARM* cpu);
-void A_SMLALxy(ARM* cpu);
-
-void A_CLZ(ARM* cpu);
-void A_QADD(ARM* cpu);
-void A_QSUB(ARM* cpu);
-void A_QDADD(ARM* cpu);
-void A_QDSUB(ARM* cpu);
-
-
-void T_LSL_IMM(ARM* cpu);
-void T_LSR_IMM(ARM* cpu);
-void T_ASR_IMM(ARM* cpu);
-
-void T_ADD_REG_(ARM* cpu);
-void T_SUB_REG_(ARM* cpu);
-void T_ADD_IMM_(ARM* cpu);
-void T_SUB_IMM_(ARM* cpu);
-
-void T_MOV_IMM(ARM* cpu);
-void T_CMP_IMM(ARM* cpu);
-void T_ADD_IMM(ARM* cpu);
-void T_SUB_IMM(ARM* cpu);
-
-void T_AND_REG(ARM* cpu);
-void T_EOR_REG(ARM* cpu);
-void T_LSL_REG(ARM* cpu);
-void T_LSR_REG(ARM* cpu);
-void T_ASR_REG(ARM* cpu);
-void T_ADC_REG(ARM* cpu);
-void T_SBC_REG(ARM* cpu);
-void T_ROR_REG(ARM* cpu);
-void T_TST_REG(ARM* cpu);
-void T_NEG_REG(ARM* cpu);
-void T_CMP_REG(ARM* cpu);
-void T_CMN_REG(ARM* cpu);
-void T_ORR_REG(ARM* cpu);
-void T_MUL_REG(ARM* cpu);
-void T_BIC_REG(ARM* cpu);
-void T_MVN_REG(ARM* cpu);
-
-void T_ADD_HIREG(ARM* cpu);
-void T_CMP_HIREG(ARM* cpu);
-void T_MOV_HIREG(ARM* cpu);
-
-void T_ADD_PCREL(ARM* cpu);
-void T_ADD_SPREL(ARM* cpu);
-void T_ADD_SP(ARM* cpu);
-
-}
-
-#endif
+INSTRFUNC(A_MOV_REG_LSL_IMM_DBG)
+
+INSTRFUNC(A_MUL)
+INSTRFUNC(A_MLA)
+INSTRFUNC(A_UMULL)
+INSTRFUNC(A_UMLAL)
+INSTRFUNC(A_SMULL)
+INSTRFUNC(A_SMLAL)
+INSTRFUNC(A_SMLAxy)
+INSTRFUNC(A_SMLAWy)
+INSTRFUNC(A_SMULxy)
+INSTRFUNC(A_SMULWy)
+INSTRFUNC(A_SMLALxy)
+
+INSTRFUNC(A_CLZ)
+INSTRFUNC(A_QADD)
+INSTRFUNC(A_QSUB)
+INSTRFUNC(A_QDADD)
+INSTRFUNC(A_QDSUB)
+
+
+INSTRFUNC(T_LSL_IMM)
+INSTRFUNC(T_LSR_IMM)
+INSTRFUNC(T_ASR_IMM)
+
+INSTRFUNC(T_ADD_REG_)
+INSTRFUNC(T_SUB_REG_)
+INSTRFUNC(T_ADD_IMM_)
+INSTRFUNC(T_SUB_IMM_)
+
+INSTRFUNC(T_MOV_IMM)
+INSTRFUNC(T_CMP_IMM)
+INSTRFUNC(T_ADD_IMM)
+INSTRFUNC(T_SUB_IMM)
+
+INSTRFUNC(T_AND_REG)
+INSTRFUNC(T_EOR_REG)
+INSTRFUNC(T_LSL_REG)
+INSTRFUNC(T_LSR_REG)
+INSTRFUNC(T_ASR_REG)
+INSTRFUNC(T_ADC_REG)
+INSTRFUNC(T_SBC_REG)
+INSTRFUNC(T_ROR_REG)
+INSTRFUNC(T_TST_REG)
+INSTRFUNC(T_NEG_REG)
+INSTRFUNC(T_CMP_REG)
+INSTRFUNC(T_CMN_REG)
+INSTRFUNC(T_ORR_REG)
+INSTRFUNC(T_MUL_REG)
+INSTRFUNC(T_BIC_REG)
+INSTRFUNC(T_MVN_REG)
+
+INSTRFUNC(T_ADD_HIREG)
+INSTRFUNC(T_CMP_HIREG)
+INSTRFUNC(T_MOV_HIREG)
+
+INSTRFUNC(T_ADD_PCREL)
+INSTRFUNC(T_ADD_SPREL)
+INSTRFUNC(T_ADD_SP)
+
+#undef A_PROTO_ALU_OP
+#undef A_PROTO_ALU_TEST
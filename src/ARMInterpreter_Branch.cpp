@@ -17,27 +17,30 @@
 */
 
 #include <stdio.h>
-#include "ARM.h"
+#include "ARMInterpreter.h"
 
 
 namespace ARMInterpreter
 {
 
 
-void A_B(ARM* cpu)
+template <typename CPU>
+void A_B(CPU* cpu)
 {
     s32 offset = (s32)(cpu->CurInstr << 8) >> 6;
     cpu->JumpTo(cpu->R[15] + offset);
 }
 
-void A_BL(ARM* cpu)
+template <typename CPU>
+void A_BL(CPU* cpu)
 {
     s32 offset = (s32)(cpu->CurInstr << 8) >> 6;
     cpu->R[14] = cpu->R[15] - 4;
     cpu->JumpTo(cpu->R[15] + offset);
 }
 
-void A_BLX_IMM(ARM* cpu)
+template <typename CPU>
+void A_BLX_IMM(CPU* cpu)
 {
     s32 offset = (s32)(cpu->CurInstr << 8) >> 6;
     if (cpu->CurInstr & 0x01000000) offset += 2;
@@ -45,12 +48,14 @@ void A_BLX_IMM(ARM* cpu)
     cpu->JumpTo(cpu->R[15] + offset + 1);
 }
 
-void A_BX(ARM* cpu)
+template <typename CPU>
+void A_BX(CPU* cpu)
 {
     cpu->JumpTo(cpu->R[cpu->CurInstr & 0xF]);
 }
 
-void A_BLX_REG(ARM* cpu)
+template <typename CPU>
+void A_BLX_REG(CPU* cpu)
 {
     u32 lr = cpu->R[15] - 4;
     cpu->JumpTo(cpu->R[cpu->CurInstr & 0xF]);
@@ -59,7 +64,8 @@ void A_BLX_REG(ARM* cpu)
 
 
 
-void T_BCOND(ARM* cpu)
+template <typename CPU>
+void T_BCOND(CPU* cpu)
 {
     if (cpu->CheckCondition((cpu->CurInstr >> 8) & 0xF))
     {
@@ -70,12 +76,14 @@ void T_BCOND(ARM* cpu)
         cpu->AddCycles_C();
 }
 
-void T_BX(ARM* cpu)
+template <typename CPU>
+void T_BX(CPU* cpu)
 {
     cpu->JumpTo(cpu->R[(cpu->CurInstr >> 3) & 0xF]);
 }
 
-void T_BLX_REG(ARM* cpu)
+template <typename CPU>
+void T_BLX_REG(CPU* cpu)
 {
     if (cpu->Num==1)
     {
@@ -88,20 +96,23 @@ void T_BLX_REG(ARM* cpu)
     cpu->R[14] = lr;
 }
 
-void T_B(ARM* cpu)
+template <typename CPU>
+void T_B(CPU* cpu)
 {
     s32 offset = (s32)((cpu->CurInstr & 0x7FF) << 21) >> 20;
     cpu->JumpTo(cpu->R[15] + offset + 1);
 }
 
-void T_BL_LONG_1(ARM* cpu)
+template <typename CPU>
+void T_BL_LONG_1(CPU* cpu)
 {
     s32 offset = (s32)((cpu->CurInstr & 0x7FF) << 21) >> 9;
     cpu->R[14] = cpu->R[15] + offset;
     cpu->AddCycles_C();
 }
 
-void T_BL_LONG_2(ARM* cpu)
+template <typename CPU>
+void T_BL_LONG_2(CPU* cpu)
 {
     s32 offset = (cpu->CurInstr & 0x7FF) << 1;
     u32 pc = cpu->R[14] + offset;
@@ -114,6 +125,9 @@ void T_BL_LONG_2(ARM* cpu)
 }
 
 
+#define INSTRFUNC(x)  template void x<ARMv5>(ARMv5* cpu); template void x<ARMv4>(ARMv4* cpu);
+#include "ARMInterpreter_Branch.h"
+INSTRFUNC(A_BLX_IMM)
+#undef INSTRFUNC
 
 }
-
@@ -16,24 +16,18 @@
     with melonDS. If not, see http://www.gnu.org/licenses/.
 */
 
-#ifndef ARMINTERPRETER_BRANCH_H
-#define ARMINTERPRETER_BRANCH_H
+// list of the branch instruction handlers
+// this is included with INSTRFUNC(x) defined, see ARMInterpreter.h
 
-namespace ARMInterpreter
-{
+INSTRFUNC(A_B)
+INSTRFUNC(A_BL)
+INSTRFUNC(A_BX)
+INSTRFUNC(A_BLX_REG)
 
-void A_B(ARM* cpu);
-void A_BL(ARM* cpu);
-void A_BX(ARM* cpu);
-void A_BLX_REG(ARM* cpu);
+INSTRFUNC(T_BCOND)
+INSTRFUNC(T_BX)
+INSTRFUNC(T_BLX_REG)
+INSTRFUNC(T_B)
+INSTRFUNC(T_BL_LONG_1)
+INSTRFUNC(T_BL_LONG_2)
 
-void T_BCOND(ARM* cpu);
-void T_BX(ARM* cpu);
-void T_BLX_REG(ARM* cpu);
-void T_B(ARM* cpu);
-void T_BL_LONG_1(ARM* cpu);
-void T_BL_LONG_2(ARM* cpu);
-
-}
-
-#endif
@@ -17,7 +17,7 @@
 */
 
 #include <stdio.h>
-#include "ARM.h"
+#include "ARMInterpreter.h"
 
 
 namespace ARMInterpreter
@@ -140,61 +140,61 @@ namespace ARMInterpreter
 
 #define A_IMPLEMENT_WB_LDRSTR(x) \
 \
-void A_##x##_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_IMM(CPU* cpu) \
 { \
     A_WB_CALC_OFFSET_IMM \
     A_##x \
 } \
 \
-void A_##x##_REG_LSL(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSL(CPU* cpu) \
 { \
     A_WB_CALC_OFFSET_REG(LSL_IMM) \
     A_##x \
 } \
 \
-void A_##x##_REG_LSR(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_LSR(CPU* cpu) \
 { \
     A_WB_CALC_OFFSET_REG(LSR_IMM) \
     A_##x \
 } \
 \
-void A_##x##_REG_ASR(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ASR(CPU* cpu) \
 { \
     A_WB_CALC_OFFSET_REG(ASR_IMM) \
     A_##x \
 } \
 \
-void A_##x##_REG_ROR(ARM* cpu) \
+template <typename CPU> void A_##x##_REG_ROR(CPU* cpu) \
 { \
     A_WB_CALC_OFFSET_REG(ROR_IMM) \
     A_##x \
 } \
 \
-void A_##x##_POST_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_POST_IMM(CPU* cpu) \
 { \
     A_WB_CALC_OFFSET_IMM \
     A_##x##_POST \
 } \
 \
-void A_##x##_POST_REG_LSL(ARM* cpu) \
+template <typename CPU> void A_##x##_POST_REG_LSL(CPU* cpu) \
 { \
     A_WB_CALC_OFFSET_REG(LSL_IMM) \
     A_##x##_POST \
 } \
 \
-void A_##x##_POST_REG_LSR(ARM* cpu) \
+template <typename CPU> void A_##x##_POST_REG_LSR(CPU* cpu) \
 { \
     A_WB_CALC_OFFSET_REG(LSR_IMM) \
     A_##x##_POST \
 } \
 \
-void A_##x##_POST_REG_ASR(ARM* cpu) \
+template <typename CPU> void A_##x##_POST_REG_ASR(CPU* cpu) \
 { \
     A_WB_CALC_OFFSET_REG(ASR_IMM) \
     A_##x##_POST \
 } \
 \
-void A_##x##_POST_REG_ROR(ARM* cpu) \
+template <typename CPU> void A_##x##_POST_REG_ROR(CPU* cpu) \
 { \
     A_WB_CALC_OFFSET_REG(ROR_IMM) \
     A_##x##_POST \
@@ -320,24 +320,24 @@ A_IMPLEMENT_WB_LDRSTR(LDRB)
 
 #define A_IMPLEMENT_HD_LDRSTR(x) \
 \
-void A_##x##_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_IMM(CPU* cpu) \
 { \
     A_HD_CALC_OFFSET_IMM \
     A_##x \
 } \
 \
-void A_##x##_REG(ARM* cpu) \
+template <typename CPU> void A_##x##_REG(CPU* cpu) \
 { \
     A_HD_CALC_OFFSET_REG \
     A_##x \
 } \
-void A_##x##_POST_IMM(ARM* cpu) \
+template <typename CPU> void A_##x##_POST_IMM(CPU* cpu) \
 { \
     A_HD_CALC_OFFSET_IMM \
     A_##x##_POST \
 } \
 \
-void A_##x##_POST_REG(ARM* cpu) \
+template <typename CPU> void A_##x##_POST_REG(CPU* cpu) \
 { \
     A_HD_CALC_OFFSET_REG \
     A_##x##_POST \
@@ -352,7 +352,8 @@ A_IMPLEMENT_HD_LDRSTR(LDRSH)
 
 
 
-void A_SWP(ARM* cpu)
+template <typename CPU>
+void A_SWP(CPU* cpu)
 {
     u32 base = cpu->R[(cpu->CurInstr >> 16) & 0xF];
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
@@ -368,7 +369,8 @@ void A_SWP(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void A_SWPB(ARM* cpu)
+template <typename CPU>
+void A_SWPB(CPU* cpu)
 {
     u32 base = cpu->R[(cpu->CurInstr >> 16) & 0xF];
     u32 rm = cpu->R[cpu->CurInstr & 0xF] & 0xFF;
@@ -384,21 +386,25 @@ void A_SWPB(ARM* cpu)
 
 
 
-void A_LDM(ARM* cpu)
+template <typename CPU>
+void A_LDM(CPU* cpu)
 {
     u32 baseid = (cpu->CurInstr >> 16) & 0xF;
     u32 base = cpu->R[baseid];
     u32 wbbase;
     u32 preinc = (cpu->CurInstr & (1<<24));
-    bool first = true;
+    u32 vals[16];
+    u32 num = 0;
+
+    for (int i = 0; i < 16; i++)
+    {
+        if (cpu->CurInstr & (1<<i))
+            num++;
+    }
 
     if (!(cpu->CurInstr & (1<<23)))
     {
-        for (int i = 0; i < 16; i++)
-        {
-            if (cpu->CurInstr & (1<<i))
-                base -= 4;
-        }
+        base -= (num << 2);
 
         if (cpu->CurInstr & (1<<21))
         {
@@ -412,25 +418,20 @@ void A_LDM(ARM* cpu)
     if ((cpu->CurInstr & (1<<22)) && !(cpu->CurInstr & (1<<15)))
         cpu->UpdateMode(cpu->CPSR, (cpu->CPSR&~0x1F)|0x10);
 
+    if (num)
+        cpu->DataRead32Multiple(preinc ? (base + 4) : base, vals, num);
+    base += (num << 2);
+
+    num = 0;
     for (int i = 0; i < 15; i++)
     {
         if (cpu->CurInstr & (1<<i))
-        {
-            if (preinc) base += 4;
-            if (first) cpu->DataRead32 (base, &cpu->R[i]);
-            else       cpu->DataRead32S(base, &cpu->R[i]);
-            first = false;
-            if (!preinc) base += 4;
-        }
+            cpu->R[i] = vals[num++];
     }
 
     if (cpu->CurInstr & (1<<15))
     {
-        u32 pc;
-        if (preinc) base += 4;
-        if (first) cpu->DataRead32 (base, &pc);
-        else       cpu->DataRead32S(base, &pc);
-        if (!preinc) base += 4;
+        u32 pc = vals[num];
 
         if (cpu->Num == 1)
             pc &= ~0x1;
@@ -463,13 +464,15 @@ void A_LDM(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void A_STM(ARM* cpu)
+template <typename CPU>
+void A_STM(CPU* cpu)
 {
     u32 baseid = (cpu->CurInstr >> 16) & 0xF;
     u32 base = cpu->R[baseid];
     u32 oldbase = base;
     u32 preinc = (cpu->CurInstr & (1<<24));
-    bool first = true;
+    u32 vals[16];
+    u32 num = 0;
 
     if (!(cpu->CurInstr & (1<<23)))
     {
@@ -497,6 +500,8 @@ void A_STM(ARM* cpu)
         cpu->UpdateMode(cpu->CPSR, (cpu->CPSR&~0x1F)|0x10);
     }
 
+    u32 start = preinc ? (base + 4) : base;
+
     for (u32 i = 0; i < 16; i++)
     {
         if (cpu->CurInstr & (1<<i))
@@ -506,19 +511,22 @@ void A_STM(ARM* cpu)
             if (i == baseid && !isbanked)
             {
                 if ((cpu->Num == 0) || (!(cpu->CurInstr & ((1<<i)-1))))
-                    first ? cpu->DataWrite32(base, oldbase) : cpu->DataWrite32S(base, oldbase);
+                    vals[num] = oldbase;
                 else
-                    first ? cpu->DataWrite32(base, base) : cpu->DataWrite32S(base, base); // checkme
+                    vals[num] = base; // checkme
             }
             else
-                first ? cpu->DataWrite32(base, cpu->R[i]) : cpu->DataWrite32S(base, cpu->R[i]);
+                vals[num] = cpu->R[i];
 
-            first = false;
+            num++;
 
             if (!preinc) base += 4;
         }
     }
 
+    if (num)
+        cpu->DataWrite32Multiple(start, vals, num);
+
     if (cpu->CurInstr & (1<<22))
         cpu->UpdateMode((cpu->CPSR&~0x1F)|0x10, cpu->CPSR);
 
@@ -530,12 +538,12 @@ void A_STM(ARM* cpu)
 
 
 
-
 // ---- THUMB -----------------------
 
 
 
-void T_LDR_PCREL(ARM* cpu)
+template <typename CPU>
+void T_LDR_PCREL(CPU* cpu)
 {
     u32 addr = (cpu->R[15] & ~0x2) + ((cpu->CurInstr & 0xFF) << 2);
     cpu->DataRead32(addr, &cpu->R[(cpu->CurInstr >> 8) & 0x7]);
@@ -544,7 +552,8 @@ void T_LDR_PCREL(ARM* cpu)
 }
 
 
-void T_STR_REG(ARM* cpu)
+template <typename CPU>
+void T_STR_REG(CPU* cpu)
 {
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataWrite32(addr, cpu->R[cpu->CurInstr & 0x7]);
@@ -552,7 +561,8 @@ void T_STR_REG(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_STRB_REG(ARM* cpu)
+template <typename CPU>
+void T_STRB_REG(CPU* cpu)
 {
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataWrite8(addr, cpu->R[cpu->CurInstr & 0x7]);
@@ -560,7 +570,8 @@ void T_STRB_REG(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDR_REG(ARM* cpu)
+template <typename CPU>
+void T_LDR_REG(CPU* cpu)
 {
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
 
@@ -571,7 +582,8 @@ void T_LDR_REG(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void T_LDRB_REG(ARM* cpu)
+template <typename CPU>
+void T_LDRB_REG(CPU* cpu)
 {
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataRead8(addr, &cpu->R[cpu->CurInstr & 0x7]);
@@ -580,7 +592,8 @@ void T_LDRB_REG(ARM* cpu)
 }
 
 
-void T_STRH_REG(ARM* cpu)
+template <typename CPU>
+void T_STRH_REG(CPU* cpu)
 {
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataWrite16(addr, cpu->R[cpu->CurInstr & 0x7]);
@@ -588,7 +601,8 @@ void T_STRH_REG(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDRSB_REG(ARM* cpu)
+template <typename CPU>
+void T_LDRSB_REG(CPU* cpu)
 {
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataRead8(addr, &cpu->R[cpu->CurInstr & 0x7]);
@@ -597,7 +611,8 @@ void T_LDRSB_REG(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void T_LDRH_REG(ARM* cpu)
+template <typename CPU>
+void T_LDRH_REG(CPU* cpu)
 {
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataRead16(addr, &cpu->R[cpu->CurInstr & 0x7]);
@@ -605,7 +620,8 @@ void T_LDRH_REG(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void T_LDRSH_REG(ARM* cpu)
+template <typename CPU>
+void T_LDRSH_REG(CPU* cpu)
 {
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataRead16(addr, &cpu->R[cpu->CurInstr & 0x7]);
@@ -615,7 +631,8 @@ void T_LDRSH_REG(ARM* cpu)
 }
 
 
-void T_STR_IMM(ARM* cpu)
+template <typename CPU>
+void T_STR_IMM(CPU* cpu)
 {
     u32 offset = (cpu->CurInstr >> 4) & 0x7C;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
@@ -624,7 +641,8 @@ void T_STR_IMM(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDR_IMM(ARM* cpu)
+template <typename CPU>
+void T_LDR_IMM(CPU* cpu)
 {
     u32 offset = (cpu->CurInstr >> 4) & 0x7C;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
@@ -635,7 +653,8 @@ void T_LDR_IMM(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void T_STRB_IMM(ARM* cpu)
+template <typename CPU>
+void T_STRB_IMM(CPU* cpu)
 {
     u32 offset = (cpu->CurInstr >> 6) & 0x1F;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
@@ -644,7 +663,8 @@ void T_STRB_IMM(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDRB_IMM(ARM* cpu)
+template <typename CPU>
+void T_LDRB_IMM(CPU* cpu)
 {
     u32 offset = (cpu->CurInstr >> 6) & 0x1F;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
@@ -654,7 +674,8 @@ void T_LDRB_IMM(ARM* cpu)
 }
 
 
-void T_STRH_IMM(ARM* cpu)
+template <typename CPU>
+void T_STRH_IMM(CPU* cpu)
 {
     u32 offset = (cpu->CurInstr >> 5) & 0x3E;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
@@ -663,7 +684,8 @@ void T_STRH_IMM(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDRH_IMM(ARM* cpu)
+template <typename CPU>
+void T_LDRH_IMM(CPU* cpu)
 {
     u32 offset = (cpu->CurInstr >> 5) & 0x3E;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
@@ -673,7 +695,8 @@ void T_LDRH_IMM(ARM* cpu)
 }
 
 
-void T_STR_SPREL(ARM* cpu)
+template <typename CPU>
+void T_STR_SPREL(CPU* cpu)
 {
     u32 offset = (cpu->CurInstr << 2) & 0x3FC;
     offset += cpu->R[13];
@@ -682,7 +705,8 @@ void T_STR_SPREL(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDR_SPREL(ARM* cpu)
+template <typename CPU>
+void T_LDR_SPREL(CPU* cpu)
 {
     u32 offset = (cpu->CurInstr << 2) & 0x3FC;
     offset += cpu->R[13];
@@ -692,117 +716,118 @@ void T_LDR_SPREL(ARM* cpu)
 }
 
 
-void T_PUSH(ARM* cpu)
+template <typename CPU>
+void T_PUSH(CPU* cpu)
 {
-    int nregs = 0;
-    bool first = true;
+    u32 vals[9];
+    u32 num = 0;
 
     for (int i = 0; i < 8; i++)
     {
         if (cpu->CurInstr & (1<<i))
-            nregs++;
+            vals[num++] = cpu->R[i];
     }
 
     if (cpu->CurInstr & (1<<8))
-        nregs++;
+        vals[num++] = cpu->R[14];
 
     u32 base = cpu->R[13];
-    base -= (nregs<<2);
+    base -= (num<<2);
     cpu->R[13] = base;
 
-    for (int i = 0; i < 8; i++)
-    {
-        if (cpu->CurInstr & (1<<i))
-        {
-            if (first) cpu->DataWrite32 (base, cpu->R[i]);
-            else       cpu->DataWrite32S(base, cpu->R[i]);
-            first = false;
-            base += 4;
-        }
-    }
-
-    if (cpu->CurInstr & (1<<8))
-    {
-        if (first) cpu->DataWrite32 (base, cpu->R[14]);
-        else       cpu->DataWrite32S(base, cpu->R[14]);
-    }
+    if (num)
+        cpu->DataWrite32Multiple(base, vals, num);
 
     cpu->AddCycles_CD();
 }
 
-void T_POP(ARM* cpu)
+template <typename CPU>
+void T_POP(CPU* cpu)
 {
     u32 base = cpu->R[13];
-    bool first = true;
+    u32 vals[9];
+    u32 num = 0;
+
+    for (int i = 0; i < 9; i++)
+    {
+        if (cpu->CurInstr & (1<<i))
+            num++;
+    }
 
+    if (num)
+        cpu->DataRead32Multiple(base, vals, num);
+
+    num = 0;
     for (int i = 0; i < 8; i++)
     {
         if (cpu->CurInstr & (1<<i))
-        {
-            if (first) cpu->DataRead32 (base, &cpu->R[i]);
-            else       cpu->DataRead32S(base, &cpu->R[i]);
-            first = false;
-            base += 4;
-        }
+            cpu->R[i] = vals[num++];
     }
 
     if (cpu->CurInstr & (1<<8))
     {
-        u32 pc;
-        if (first) cpu->DataRead32 (base, &pc);
-        else       cpu->DataRead32S(base, &pc);
+        u32 pc = vals[num++];
         if (cpu->Num==1) pc |= 0x1;
         cpu->JumpTo(pc);
-        base += 4;
     }
 
-    cpu->R[13] = base;
+    cpu->R[13] = base + (num<<2);
     cpu->AddCycles_CDI();
 }
 
-void T_STMIA(ARM* cpu)
+template <typename CPU>
+void T_STMIA(CPU* cpu)
 {
     u32 base = cpu->R[(cpu->CurInstr >> 8) & 0x7];
-    bool first = true;
+    u32 vals[8];
+    u32 num = 0;
 
     for (int i = 0; i < 8; i++)
     {
         if (cpu->CurInstr & (1<<i))
-        {
-            if (first) cpu->DataWrite32 (base, cpu->R[i]);
-            else       cpu->DataWrite32S(base, cpu->R[i]);
-            first = false;
-            base += 4;
-        }
+            vals[num++] = cpu->R[i];
     }
 
+    if (num)
+        cpu->DataWrite32Multiple(base, vals, num);
+
     // TODO: check "Rb included in Rlist" case
-    cpu->R[(cpu->CurInstr >> 8) & 0x7] = base;
+    cpu->R[(cpu->CurInstr >> 8) & 0x7] = base + (num<<2);
     cpu->AddCycles_CD();
 }
 
-void T_LDMIA(ARM* cpu)
+template <typename CPU>
+void T_LDMIA(CPU* cpu)
 {
     u32 base = cpu->R[(cpu->CurInstr >> 8) & 0x7];
-    bool first = true;
+    u32 vals[8];
+    u32 num = 0;
 
     for (int i = 0; i < 8; i++)
     {
         if (cpu->CurInstr & (1<<i))
-        {
-            if (first) cpu->DataRead32 (base, &cpu->R[i]);
-            else       cpu->DataRead32S(base, &cpu->R[i]);
-            first = false;
-            base += 4;
-        }
+            num++;
+    }
+
+    if (num)
+        cpu->DataRead32Multiple(base, vals, num);
+
+    num = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        if (cpu->CurInstr & (1<<i))
+            cpu->R[i] = vals[num++];
     }
 
     if (!(cpu->CurInstr & (1<<((cpu->CurInstr >> 8) & 0x7))))
-        cpu->R[(cpu->CurInstr >> 8) & 0x7] = base;
+        cpu->R[(cpu->CurInstr >> 8) & 0x7] = base + (num<<2);
 
     cpu->AddCycles_CDI();
 }
 
 
-}
+#define INSTRFUNC(x)  template void x<ARMv5>(ARMv5* cpu); template void x<ARMv4>(ARMv4* cpu);
+#include "ARMInterpreter_LoadStore.h"
+#undef INSTRFUNC
 
+}
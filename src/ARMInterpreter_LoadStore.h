@@ -16,24 +16,21 @@
     with melonDS. If not, see http://www.gnu.org/licenses/.
 */
 
-#ifndef ARMINTERPRETER_LOADSTORE_H
-#define ARMINTERPRETER_LOADSTORE_H
-
-namespace ARMInterpreter
-{
+// list of the load/store instruction handlers
+// this is included with INSTRFUNC(x) defined, see ARMInterpreter.h
 
 #define A_PROTO_WB_LDRSTR(x) \
 \
-void A_##x##_IMM(ARM* cpu); \
-void A_##x##_REG_LSL(ARM* cpu); \
-void A_##x##_REG_LSR(ARM* cpu); \
-void A_##x##_REG_ASR(ARM* cpu); \
-void A_##x##_REG_ROR(ARM* cpu); \
-void A_##x##_POST_IMM(ARM* cpu); \
-void A_##x##_POST_REG_LSL(ARM* cpu); \
-void A_##x##_POST_REG_LSR(ARM* cpu); \
-void A_##x##_POST_REG_ASR(ARM* cpu); \
-void A_##x##_POST_REG_ROR(ARM* cpu);
+INSTRFUNC(A_##x##_IMM) \
+INSTRFUNC(A_##x##_REG_LSL) \
+INSTRFUNC(A_##x##_REG_LSR) \
+INSTRFUNC(A_##x##_REG_ASR) \
+INSTRFUNC(A_##x##_REG_ROR) \
+INSTRFUNC(A_##x##_POST_IMM) \
+INSTRFUNC(A_##x##_POST_REG_LSL) \
+INSTRFUNC(A_##x##_POST_REG_LSR) \
+INSTRFUNC(A_##x##_POST_REG_ASR) \
+INSTRFUNC(A_##x##_POST_REG_ROR)
 
 A_PROTO_WB_LDRSTR(STR)
 A_PROTO_WB_LDRSTR(STRB)
@@ -42,10 +39,10 @@ A_PROTO_WB_LDRSTR(LDRB)
 
 #define A_PROTO_HD_LDRSTR(x) \
 \
-void A_##x##_IMM(ARM* cpu); \
-void A_##x##_REG(ARM* cpu); \
-void A_##x##_POST_IMM(ARM* cpu); \
-void A_##x##_POST_REG(ARM* cpu);
+INSTRFUNC(A_##x##_IMM) \
+INSTRFUNC(A_##x##_REG) \
+INSTRFUNC(A_##x##_POST_IMM) \
+INSTRFUNC(A_##x##_POST_REG)
 
 A_PROTO_HD_LDRSTR(STRH)
 A_PROTO_HD_LDRSTR(LDRD)
@@ -54,42 +51,40 @@ A_PROTO_HD_LDRSTR(LDRH)
 A_PROTO_HD_LDRSTR(LDRSB)
 A_PROTO_HD_LDRSTR(LDRSH)
 
-void A_LDM(ARM* cpu);
-void A_STM(ARM* cpu);
-
-void A_SWP(ARM* cpu);
-void A_SWPB(ARM* cpu);
-
+INSTRFUNC(A_LDM)
+INSTRFUNC(A_STM)
 
-void T_LDR_PCREL(ARM* cpu);
+INSTRFUNC(A_SWP)
+INSTRFUNC(A_SWPB)
 
-void T_STR_REG(ARM* cpu);
-void T_STRB_REG(ARM* cpu);
-void T_LDR_REG(ARM* cpu);
-void T_LDRB_REG(ARM* cpu);
 
-void T_STRH_REG(ARM* cpu);
-void T_LDRSB_REG(ARM* cpu);
-void T_LDRH_REG(ARM* cpu);
-void T_LDRSH_REG(ARM* cpu);
+INSTRFUNC(T_LDR_PCREL)
 
-void T_STR_IMM(ARM* cpu);
-void T_LDR_IMM(ARM* cpu);
-void T_STRB_IMM(ARM* cpu);
-void T_LDRB_IMM(ARM* cpu);
+INSTRFUNC(T_STR_REG)
+INSTRFUNC(T_STRB_REG)
+INSTRFUNC(T_LDR_REG)
+INSTRFUNC(T_LDRB_REG)
 
-void T_STRH_IMM(ARM* cpu);
-void T_LDRH_IMM(ARM* cpu);
+INSTRFUNC(T_STRH_REG)
+INSTRFUNC(T_LDRSB_REG)
+INSTRFUNC(T_LDRH_REG)
+INSTRFUNC(T_LDRSH_REG)
 
-void T_STR_SPREL(ARM* cpu);
-void T_LDR_SPREL(ARM* cpu);
+INSTRFUNC(T_STR_IMM)
+INSTRFUNC(T_LDR_IMM)
+INSTRFUNC(T_STRB_IMM)
+INSTRFUNC(T_LDRB_IMM)
 
-void T_PUSH(ARM* cpu);
-void T_POP(ARM* cpu);
-void T_STMIA(ARM* cpu);
-void T_LDMIA(ARM* cpu);
+INSTRFUNC(T_STRH_IMM)
+INSTRFUNC(T_LDRH_IMM)
 
-}
+INSTRFUNC(T_STR_SPREL)
+INSTRFUNC(T_LDR_SPREL)
 
-#endif
+INSTRFUNC(T_PUSH)
+INSTRFUNC(T_POP)
+INSTRFUNC(T_STMIA)
+INSTRFUNC(T_LDMIA)
 
+#undef A_PROTO_WB_LDRSTR
+#undef A_PROTO_HD_LDRSTR
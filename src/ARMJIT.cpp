@@ -0,0 +1,642 @@
+/*
+    Copyright 2016-2019 StapleButter
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include "Config.h"
+#include "ARM.h"
+#include "ARMJIT.h"
+#include "ARMInterpreter.h"
+
+
+// block JIT frontend
+//
+// blocks are straight runs of instructions starting at a given address. they
+// end at the first unconditional branch (or anything else that will for sure
+// write PC), or when hitting the block size limit.
+//
+// the emitted code calls the interpreter handlers for anything it doesn't
+// know how to do natively, and checks after every instruction whether the
+// interpreter loop would have stopped there (timestamp reached the target,
+// IRQ, halt, PC going somewhere else). when it does, it bails out and leaves
+// the CPU in the exact same state the interpreter would have left it in.
+//
+// the pipeline is simulated at compile time, so that R15, CurInstr,
+// NextInstr and CodeCycles are what the interpreter would have for every
+// instruction. this is why a block is only entered when the CPU's prefetched
+// opcodes match those the block was compiled with.
+//
+// when there's no recompiler for the platform, or JIT_Cached is set, the
+// decoded instructions are kept instead and ran by RunCachedBlock(). that
+// still saves the code fetches and opcode table lookups for every instruction.
+
+
+namespace ARMJIT
+{
+
+const u32 kFastLookupSize = 0x1000;
+
+u16 CodeLines[CodeSpace_Size >> 5];
+bool BlockInvalidated;
+
+bool NativeAvailable;
+bool CachedMode;
+
+std::unordered_map<u32, JitBlock*> BlockMap[2];
+std::vector<JitBlock*> PageBlocks[CodeSpace_Size >> 12];
+JitBlock* FastLookup[2][kFastLookupSize];
+
+
+bool Init()
+{
+    NativeAvailable = BackendInit();
+    if (!NativeAvailable)
+        printf("JIT: no recompiler for this platform, blocks will be interpreted\n");
+    CachedMode = !NativeAvailable;
+
+    memset(CodeLines, 0, sizeof(CodeLines));
+    memset(FastLookup, 0, sizeof(FastLookup));
+    BlockInvalidated = false;
+
+    return true;
+}
+
+void DeInit()
+{
+    InvalidateAll();
+    BackendDeInit();
+}
+
+void Reset()
+{
+    InvalidateAll();
+}
+
+
+void InvalidateAll()
+{
+    for (int num = 0; num < 2; num++)
+    {
+        for (auto it = BlockMap[num].begin(); it != BlockMap[num].end(); it++)
+        {
+            delete[] it->second->Instrs;
+            delete it->second;
+        }
+
+        BlockMap[num].clear();
+    }
+
+    for (u32 i = 0; i < (CodeSpace_Size >> 12); i++)
+        PageBlocks[i].clear();
+
+    memset(CodeLines, 0, sizeof(CodeLines));
+    memset(FastLookup, 0, sizeof(FastLookup));
+
+    // code memory is only ever reclaimed here
+    if (NativeAvailable) BackendReset();
+
+    BlockInvalidated = true;
+}
+
+void RemoveBlock(JitBlock* block)
+{
+    BlockMap[block->Num].erase(block->Addr);
+
+    JitBlock*& fast = FastLookup[block->Num][(block->Addr >> 1) & (kFastLookupSize-1)];
+    if (fast == block) fast = NULL;
+
+    for (u32 page = block->CodeStart >> 12; page <= ((block->CodeEnd-1) >> 12); page++)
+    {
+        std::vector<JitBlock*>& list = PageBlocks[page];
+        list.erase(std::remove(list.begin(), list.end(), block), list.end());
+    }
+
+    for (u32 line = block->CodeStart >> 5; line <= ((block->CodeEnd-1) >> 5); line++)
+        CodeLines[line]--;
+
+    delete[] block->Instrs;
+    delete block;
+}
+
+// the range must not cross a page boundary
+void InvalidateCodeRange(u32 start, u32 end)
+{
+    std::vector<JitBlock*>& list = PageBlocks[start >> 12];
+
+    JitBlock* victims[64];
+    int numvictims;
+
+    // blocks overlapping the written word. there can be more of them than
+    // fit in the buffer, hence the loop
+    do
+    {
+        numvictims = 0;
+        for (auto it = list.begin(); it != list.end() && numvictims < 64; it++)
+        {
+            JitBlock* block = *it;
+            if (block->CodeStart < end && block->CodeEnd > start)
+                victims[numvictims++] = block;
+        }
+
+        for (int i = 0; i < numvictims; i++)
+            RemoveBlock(victims[i]);
+
+        if (numvictims) BlockInvalidated = true;
+    }
+    while (numvictims == 64);
+}
+
+void InvalidateByCodeAddr(u32 codeaddr)
+{
+    codeaddr &= ~3;
+    InvalidateCodeRange(codeaddr, codeaddr + 4);
+}
+
+
+// where code at a given address physically lives, and how far the
+// CPU address can go while still mapping to the same memory linearly
+bool GetCodeRegion(ARM* cpu, u32 addr, u32* codeaddr, u32* regionstart, u32* regionend)
+{
+    if (cpu->Num == 0)
+    {
+        ARMv5* arm9 = (ARMv5*)cpu;
+
+        if (addr < arm9->ITCMSize)
+        {
+            *codeaddr = CodeSpace_ITCM + (addr & 0x7FFF);
+            *regionstart = addr & ~0x7FFF;
+            *regionend = std::min(*regionstart + 0x8000, arm9->ITCMSize);
+            return true;
+        }
+    }
+
+    switch (addr & 0xFF800000)
+    {
+    case 0x02000000:
+    case 0x02800000:
+        if (cpu->Num == 0 && (addr & 0xFF000000) != 0x02000000)
+            return false;
+        *codeaddr = CodeSpace_MainRAM + (addr & (MAIN_RAM_SIZE - 1));
+        *regionstart = addr & ~(MAIN_RAM_SIZE - 1);
+        *regionend = *regionstart + MAIN_RAM_SIZE;
+        return true;
+
+    case 0x03000000:
+        if (cpu->Num == 0)
+            return false;
+        if (NDS::SWRAM_ARM7)
+        {
+            *codeaddr = CodeSpace_SWRAM + (NDS::SWRAM_ARM7 - NDS::SharedWRAM) + (addr & NDS::SWRAM_ARM7Mask);
+            *regionstart = addr & ~NDS::SWRAM_ARM7Mask;
+            *regionend = *regionstart + NDS::SWRAM_ARM7Mask + 1;
+            return true;
+        }
+        // without shared WRAM, ARM7 WRAM is mirrored there
+        // fallthrough
+    case 0x03800000:
+        if (cpu->Num == 0)
+            return false;
+        *codeaddr = CodeSpace_ARM7WRAM + (addr & 0xFFFF);
+        *regionstart = addr & ~0xFFFF;
+        *regionend = *regionstart + 0x10000;
+        return true;
+    }
+
+    return false;
+}
+
+// read code words the exact same way the interpreter would, to get both
+// the opcodes and the cycle counts right. fails if the block can't be
+// compiled past there
+bool FetchCode(ARM* cpu, u32 addr, bool thumb, u32* val, s32* cycles)
+{
+    if (cpu->Num == 0)
+    {
+        ARMv5* arm9 = (ARMv5*)cpu;
+
+        if (addr >= arm9->ITCMSize && arm9->RegionCodeCycles == 0xFF)
+        {
+            // goes through the instruction cache, which can't be touched
+            // here. the rest of a line always hits, the first word has
+            // to be looked up when the block runs
+            *cycles = (addr & 0x1F) ? 1 : -1;
+
+            // the opcodes come from the cache line if there's one, or from
+            // memory which is what a miss would fill it with. if the two
+            // differ, the code was changed without invalidating the cache.
+            // nothing would catch the line being refilled then, so that's
+            // left to the interpreter
+            *val = NDS::ARM9Read32(addr);
+            s32 line = arm9->ICacheFindLine(addr);
+            if (line >= 0 && *(u32*)&arm9->ICache[(line << 5) | (addr & 0x1C)] != *val)
+                return false;
+
+            return true;
+        }
+
+        s32 oldcycles = arm9->CodeCycles;
+        *val = arm9->CodeRead32(addr, false);
+        *cycles = arm9->CodeCycles;
+        arm9->CodeCycles = oldcycles;
+
+        return true;
+    }
+    else
+    {
+        // the ARM7's code timings only change on jumps
+        ARMv4* arm7 = (ARMv4*)cpu;
+        *cycles = arm7->CodeCycles;
+
+        if (thumb) *val = arm7->CodeRead16(addr);
+        else       *val = arm7->CodeRead32(addr);
+
+        return true;
+    }
+}
+
+s32 GetCodeTimings(ARM* cpu)
+{
+    if (cpu->Num == 0) return ((ARMv5*)cpu)->RegionCodeCycles;
+    else               return cpu->CodeCycles;
+}
+
+bool InstrEndsBlock(u32 instr, bool thumb)
+{
+    // anything that will for sure go somewhere else
+    // conditional branches don't end blocks, the emitted code checks PC
+    // after every instruction anyway
+
+    if (thumb)
+    {
+        if ((instr & 0xF800) == 0xE000) return true; // B
+        if ((instr & 0xF000) == 0xF000) return true; // BL/BLX pair
+        if ((instr & 0xE800) == 0xE800) return true; // BLX suffix
+        if ((instr & 0xFF00) == 0x4700) return true; // BX/BLX reg
+        if ((instr & 0xFD87) == 0x4487) return true; // ADD/MOV PC, Rs
+        if ((instr & 0xFF00) == 0xBD00) return true; // POP {...,PC}
+        if ((instr & 0xFF00) == 0xDF00) return true; // SWI
+        return false;
+    }
+
+    u32 cond = instr >> 28;
+    if (cond == 0xF) return (instr & 0x0E000000) == 0x0A000000; // BLX imm
+    if (cond != 0xE) return false;
+
+    if ((instr & 0x0E000000) == 0x0A000000) return true; // B/BL
+    if ((instr & 0x0FFFFFD0) == 0x012FFF10) return true; // BX/BLX reg
+    if ((instr & 0x0F000000) == 0x0F000000) return true; // SWI
+    if ((instr & 0x0E108000) == 0x08108000) return true; // LDM with PC
+    if ((instr & 0x0C10F000) == 0x0410F000) return true; // LDR PC
+
+    if ((instr & 0x0C000000) == 0x00000000 && (instr & 0x0000F000) == 0x0000F000)
+    {
+        // data processing to PC, minus the compare ops and other
+        // stuff living in that encoding space
+        u32 op = (instr >> 21) & 0xF;
+        bool isdp = (instr & 0x02000000) || ((instr & 0x90) != 0x90);
+        if (isdp && (op < 0x8 || op > 0xB))
+            return true;
+    }
+
+    return false;
+}
+
+// the interpreter handlers are instantiated for each CPU type. blocks keep
+// them as a plain InstrFunc, RunCachedBlock() casts them back
+InstrFunc GetHandler(u32 num, void (**arm9table)(ARMv5*), void (**arm7table)(ARMv4*), u32 index)
+{
+    if (num == 0) return (InstrFunc)arm9table[index];
+    else          return (InstrFunc)arm7table[index];
+}
+
+JitBlock* CompileBlock(ARM* cpu, u32 key)
+{
+    bool thumb = key & 1;
+    u32 addr = key & ~1;
+    u32 num = cpu->Num;
+
+    u32 codeaddr, regionstart, regionend;
+    if (!GetCodeRegion(cpu, addr, &codeaddr, &regionstart, &regionend))
+        return NULL;
+
+    if (!BackendHasRoom())
+        InvalidateAll();
+
+    int maxinstrs = Config::JIT_BlockSize;
+    if (maxinstrs < 1) maxinstrs = 1;
+    else if (maxinstrs > 128) maxinstrs = 128;
+
+    FetchedInstr instrs[128];
+    int numinstrs = 0;
+
+    // the ARM9 always fetches 32 bits at once, the ARM7 fetches one
+    // instruction at a time
+    u32 fetchsize = (num == 0) ? 4 : (thumb ? 2 : 4);
+
+    s32 cycles;
+    u32 r15, next0, next1, fetchstart;
+    if (num == 0 && thumb)
+    {
+        if (addr & 0x2)
+        {
+            if (addr - 2 < regionstart) return NULL;
+            fetchstart = addr - 2;
+            if (!FetchCode(cpu, addr-2, true, &next0, &cycles)) return NULL;
+            if (!FetchCode(cpu, addr+2, true, &next1, &cycles)) return NULL;
+            next0 >>= 16;
+        }
+        else
+        {
+            fetchstart = addr;
+            if (!FetchCode(cpu, addr, true, &next0, &cycles)) return NULL;
+            next1 = next0 >> 16;
+        }
+        r15 = addr + 2;
+    }
+    else
+    {
+        u32 step = thumb ? 2 : 4;
+        fetchstart = addr;
+        if (!FetchCode(cpu, addr, thumb, &next0, &cycles)) return NULL;
+        if (!FetchCode(cpu, addr+step, thumb, &next1, &cycles)) return NULL;
+        r15 = addr + step;
+    }
+
+    u32 pipe0 = next0, pipe1 = next1;
+
+    while (numinstrs < maxinstrs)
+    {
+        u32 newr15 = r15 + (thumb ? 2 : 4);
+        if ((newr15 & ~(fetchsize-1)) + fetchsize > regionend)
+            break;
+
+        // what this instruction prefetches
+        u32 fetched;
+        if (num == 0 && thumb && (newr15 & 0x2))
+        {
+            fetched = next1 >> 16;
+            cycles = 0;
+        }
+        else if (!FetchCode(cpu, newr15, thumb, &fetched, &cycles))
+            break;
+
+        r15 = newr15;
+
+        FetchedInstr& instr = instrs[numinstrs++];
+        instr.Instr = next0;
+        next0 = next1;
+        next1 = fetched;
+
+        instr.Addr = r15 - (thumb ? 4 : 8);
+        instr.R15 = r15;
+        instr.NextInstr[0] = next0;
+        instr.NextInstr[1] = next1;
+        instr.CodeCycles = cycles;
+        instr.CacheLookup = (cycles == -1);
+
+        // what AddCycles_C() would add
+        if (num == 0)
+            instr.Cycles = (r15 & 0x2) ? 0 : cycles;
+        else
+            instr.Cycles = NDS::ARM7MemTimings[cycles][thumb ? 1 : 3];
+
+        instr.Cond = thumb ? 0xE : (instr.Instr >> 28);
+        if (thumb)
+        {
+            instr.Handler = GetHandler(num, ARMInterpreter::InstrTables<ARMv5>::THUMBInstrTable,
+                                            ARMInterpreter::InstrTables<ARMv4>::THUMBInstrTable,
+                                            (instr.Instr >> 6) & 0x3FF);
+        }
+        else if (instr.Cond == 0xF)
+        {
+            if (num == 0 && (instr.Instr & 0xFE000000) == 0xFA000000)
+            {
+                instr.Handler = (InstrFunc)ARMInterpreter::A_BLX_IMM<ARMv5>;
+                instr.Cond = 0xE;
+            }
+            else
+                instr.Handler = NULL; // never executed
+        }
+        else
+        {
+            instr.Handler = GetHandler(num, ARMInterpreter::InstrTables<ARMv5>::ARMInstrTable,
+                                            ARMInterpreter::InstrTables<ARMv4>::ARMInstrTable,
+                                            ((instr.Instr >> 4) & 0xF) | ((instr.Instr >> 16) & 0xFF0));
+        }
+
+        if (InstrEndsBlock(instr.Instr, thumb))
+            break;
+    }
+
+    if (!numinstrs)
+        return NULL;
+
+    JitBlockEntry entry = NULL;
+    FetchedInstr* cached = NULL;
+    if (CachedMode)
+    {
+        cached = new FetchedInstr[numinstrs];
+        memcpy(cached, instrs, numinstrs * sizeof(FetchedInstr));
+    }
+    else
+    {
+        entry = CompileBlock(cpu, thumb, instrs, numinstrs);
+        if (!entry)
+            return NULL;
+    }
+
+    JitBlock* block = new JitBlock;
+    block->Num = num;
+    block->Addr = key;
+    block->NumInstrs = numinstrs;
+    block->CodeStart = codeaddr - (addr - fetchstart);
+    block->CodeEnd = codeaddr + ((r15 & ~(fetchsize-1)) + fetchsize - addr);
+    block->Pipe[0] = pipe0;
+    block->Pipe[1] = pipe1;
+    block->CodeTimings = GetCodeTimings(cpu);
+    block->Entry = entry;
+    block->Instrs = cached;
+
+    BlockMap[num][key] = block;
+
+    for (u32 page = block->CodeStart >> 12; page <= ((block->CodeEnd-1) >> 12); page++)
+        PageBlocks[page].push_back(block);
+
+    for (u32 line = block->CodeStart >> 5; line <= ((block->CodeEnd-1) >> 5); line++)
+        CodeLines[line]++;
+
+    return block;
+}
+
+JitBlock* LookUpBlock(ARM* cpu)
+{
+    bool cached = Config::JIT_Cached || !NativeAvailable;
+    if (cached != CachedMode)
+    {
+        InvalidateAll();
+        CachedMode = cached;
+    }
+
+    u32 thumb = (cpu->CPSR >> 5) & 0x1;
+    u32 key = (cpu->R[15] - (thumb ? 2 : 4)) | thumb;
+
+    JitBlock*& fast = FastLookup[cpu->Num][(key >> 1) & (kFastLookupSize-1)];
+    JitBlock* block = fast;
+    if (!block || block->Addr != key)
+    {
+        auto it = BlockMap[cpu->Num].find(key);
+        if (it != BlockMap[cpu->Num].end())
+            block = it->second;
+        else
+        {
+            block = CompileBlock(cpu, key);
+            if (!block) return NULL;
+        }
+
+        fast = block;
+    }
+
+    if (block->Pipe[0] != cpu->NextInstr[0] || block->Pipe[1] != cpu->NextInstr[1])
+        return NULL;
+    if (block->CodeTimings != GetCodeTimings(cpu))
+        return NULL;
+
+    return block;
+}
+
+
+void InvalidateByCPUAddr(ARM* cpu, u32 addr, u32 len)
+{
+    u32 codeaddr, regionstart, regionend;
+    if (!GetCodeRegion(cpu, addr, &codeaddr, &regionstart, &regionend))
+        return;
+
+    if (!len) return;
+
+    // every line the range touches, as long as it maps to the same memory
+    u32 start = addr & ~31;
+    u32 end = (addr + len - 1) | 31;
+    if (end > regionend - 1) end = regionend - 1;
+
+    for (u32 line = start; line < end; line += 32)
+    {
+        u32 lineaddr = codeaddr - addr + line;
+        if (CodeLines[lineaddr >> 5])
+            InvalidateCodeRange(lineaddr, lineaddr + 32);
+    }
+}
+
+void DoSavestateCode(Savestate* file, u32 codeaddr, u8* mem, u32 len)
+{
+    if (file->Saving || !file->SameSession)
+    {
+        file->VarArray(mem, len);
+        return;
+    }
+
+    static std::vector<u8> loaded;
+    loaded.resize(len);
+    file->VarArray(&loaded[0], len);
+
+    for (u32 i = 0; i < len; i += 32)
+    {
+        if (CodeLines[(codeaddr + i) >> 5] && memcmp(&mem[i], &loaded[i], 32))
+            InvalidateCodeRange(codeaddr + i, codeaddr + i + 32);
+    }
+
+    memcpy(mem, &loaded[0], len);
+}
+
+void InvalidateStaleICache(ARMv5* cpu)
+{
+    for (u32 line = 0; line < 64*4; line++)
+    {
+        // invalid lines are tagged 1
+        u32 tag = cpu->ICacheTags[line];
+        if (tag & 1) continue;
+
+        // only plain memory can have compiled code
+        u32 addr = tag | ((line >> 2) << 5);
+        if (addr >= 0x10000000) continue;
+        NDS::MemPage& page = NDS::ARM9ReadMap[addr >> 14];
+        if (!page.Mem) continue;
+
+        if (memcmp(&cpu->ICache[line << 5], &page.Mem[addr & page.Mask], 32))
+            InvalidateByCPUAddr(cpu, addr, 32);
+    }
+}
+
+template <typename CPU>
+void RunCachedBlock(CPU* cpu, JitBlock* block)
+{
+    // this mirrors what the compiled code does
+    u64* timestamp = cpu->Num ? &NDS::ARM7Timestamp : &NDS::ARM9Timestamp;
+    u64* target = cpu->Num ? &NDS::ARM7Target : &NDS::ARM9Target;
+    u32 thumb = block->Addr & 0x1;
+
+    FetchedInstr* instr = block->Instrs;
+    FetchedInstr* end = instr + block->NumInstrs;
+    for (;;)
+    {
+        cpu->R[15] = instr->R15;
+        cpu->CurInstr = instr->Instr;
+        cpu->NextInstr[0] = instr->NextInstr[0];
+        cpu->NextInstr[1] = instr->NextInstr[1];
+        if (instr->CacheLookup)
+            ((ARMv5*)(ARM*)cpu)->ICacheLookup(instr->R15);
+        else if (cpu->Num == 0)
+            cpu->CodeCycles = instr->CodeCycles;
+
+        if (cpu->CheckCondition(instr->Cond))
+            ((void (*)(CPU*))instr->Handler)(cpu);
+        else
+            cpu->Cycles += instr->CacheLookup ? cpu->CodeCycles : instr->Cycles;
+
+        cpu->InstrCount++;
+
+        // the instruction might have written over this block, which is
+        // freed then, so nothing of it can be touched past this
+        if (BlockInvalidated)
+            return;
+
+        if (++instr == end)
+            return;
+
+        // same checks as the interpreter loop, minus the last one which
+        // is left to it
+        if (cpu->R[15] != instr[-1].R15 || ((cpu->CPSR >> 5) & 0x1) != thumb)
+            return;
+        if (cpu->Attention)
+            return;
+        if (GetCodeTimings(cpu) != block->CodeTimings)
+            return;
+
+        *timestamp += cpu->Cycles;
+        cpu->Cycles = 0;
+        if (*timestamp >= *target)
+            return;
+    }
+}
+
+template void RunCachedBlock<ARMv5>(ARMv5* cpu, JitBlock* block);
+template void RunCachedBlock<ARMv4>(ARMv4* cpu, JitBlock* block);
+
+}
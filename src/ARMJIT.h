@@ -0,0 +1,156 @@
+/*
+    Copyright 2016-2019 StapleButter
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef ARMJIT_H
+#define ARMJIT_H
+
+#include "types.h"
+#include "NDS.h"
+
+class ARM;
+class ARMv5;
+
+namespace ARMJIT
+{
+
+// compiled code addresses code by where it physically lives, not by its
+// (mirrored) CPU address. this is the layout of that 'code space'.
+enum
+{
+    CodeSpace_MainRAM  = 0x000000,
+    CodeSpace_ITCM     = 0x400000,
+    CodeSpace_SWRAM    = 0x408000,
+    CodeSpace_ARM7WRAM = 0x410000,
+
+    CodeSpace_Size     = 0x420000
+};
+
+typedef void (*JitBlockEntry)(ARM* cpu);
+
+// an interpreter handler, for either CPU type
+typedef void (*InstrFunc)(ARM* cpu);
+
+// an instruction along with the pipeline state the interpreter would have
+// while executing it
+struct FetchedInstr
+{
+    u32 Instr;      // CurInstr as the interpreter would see it
+    u32 Addr;
+    u32 R15;        // R15 while executing it
+    u32 NextInstr[2];
+    s32 CodeCycles; // ARM9 only
+    s32 Cycles;     // when it's only a code fetch (failed condition, simple ALU op)
+
+    // ARM9 only: the code fetch starts an instruction cache line. whether
+    // it hits is only known when it runs, CodeCycles/Cycles don't apply
+    bool CacheLookup;
+
+    u32 Cond;       // 0xE for anything that isn't conditional
+    InstrFunc Handler;
+};
+
+struct JitBlock
+{
+    u32 Num;
+    u32 Addr;       // CPU address, bit0 set for THUMB blocks
+    u32 NumInstrs;
+
+    // range of code space this block was built from, prefetches included
+    u32 CodeStart, CodeEnd;
+
+    // state the block was compiled for. when the CPU doesn't match it,
+    // that block is ran through the interpreter instead
+    u32 Pipe[2];
+    s32 CodeTimings; // RegionCodeCycles for the ARM9, CodeCycles for the ARM7
+
+    // compiled code, or the instructions to run through the cached
+    // interpreter when there's no recompiler (or it's not wanted)
+    JitBlockEntry Entry;
+    FetchedInstr* Instrs;
+};
+
+// nonzero for every 32-byte line of code space some block was built from
+extern u16 CodeLines[CodeSpace_Size >> 5];
+
+extern bool BlockInvalidated;
+
+bool Init();
+void DeInit();
+void Reset();
+
+void InvalidateAll();
+void InvalidateByCodeAddr(u32 codeaddr);
+void InvalidateByCPUAddr(ARM* cpu, u32 addr, u32 len);
+
+// for memory code can be ran from. when loading a state from this session,
+// only the code that isn't the same anymore is thrown out
+void DoSavestateCode(Savestate* file, u32 codeaddr, u8* mem, u32 len);
+
+// after loading a state from this session: compiled code has to match what
+// the instruction cache has, see FetchCode()
+void InvalidateStaleICache(ARMv5* cpu);
+
+// returns NULL if the block at the CPU's current PC can't be ran
+JitBlock* LookUpBlock(ARM* cpu);
+
+template <typename CPU>
+void RunCachedBlock(CPU* cpu, JitBlock* block);
+
+template <typename CPU>
+inline void RunBlock(CPU* cpu, JitBlock* block)
+{
+    if (block->Entry) block->Entry(cpu);
+    else              RunCachedBlock(cpu, block);
+}
+
+inline void InvalidateMainRAMIfNecessary(u32 addr)
+{
+    u32 codeaddr = CodeSpace_MainRAM + (addr & (MAIN_RAM_SIZE - 1));
+    if (CodeLines[codeaddr >> 5]) InvalidateByCodeAddr(codeaddr);
+}
+
+inline void InvalidateITCMIfNecessary(u32 addr)
+{
+    u32 codeaddr = CodeSpace_ITCM + (addr & 0x7FFF);
+    if (CodeLines[codeaddr >> 5]) InvalidateByCodeAddr(codeaddr);
+}
+
+// takes the offset into NDS::SharedWRAM
+inline void InvalidateSWRAMIfNecessary(u32 offset)
+{
+    u32 codeaddr = CodeSpace_SWRAM + (offset & 0x7FFF);
+    if (CodeLines[codeaddr >> 5]) InvalidateByCodeAddr(codeaddr);
+}
+
+inline void InvalidateARM7WRAMIfNecessary(u32 addr)
+{
+    u32 codeaddr = CodeSpace_ARM7WRAM + (addr & 0xFFFF);
+    if (CodeLines[codeaddr >> 5]) InvalidateByCodeAddr(codeaddr);
+}
+
+// backend interface (ARMJIT_x64.cpp)
+
+bool BackendInit();
+void BackendDeInit();
+void BackendReset();
+bool BackendHasRoom();
+JitBlockEntry CompileBlock(ARM* cpu, bool thumb, FetchedInstr* instrs, int num);
+
+}
+
+#endif // ARMJIT_H
@@ -0,0 +1,1476 @@
+/*
+    Copyright 2016-2019 StapleButter
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <unordered_map>
+#include "Config.h"
+#include "ARM.h"
+#include "ARMJIT.h"
+#include "ARMInterpreter.h"
+#include "FastMem.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_X64
+#endif
+
+#ifdef JIT_X64
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+
+// x86-64 backend
+//
+// the CPU struct pointer lives in rbx for the whole block. nothing is kept
+// in host registers across ARM instructions, so calling the interpreter
+// handlers needs no special care.
+//
+// simple ALU ops are emitted natively, everything else goes through the
+// interpreter handlers with the pipeline state set up as the interpreter
+// would have it.
+//
+// with fastmem, simple loads read straight from the host mirror of the
+// address space (see FastMem.h). when that faults, the load is patched to
+// always take its slow path, which is the interpreter's own memory access.
+
+
+namespace ARMJIT
+{
+
+#ifdef JIT_X64
+
+const u32 kCodeBufferSize = 32 * 1024 * 1024;
+const u32 kMaxBlockCodeSize = 64 * 1024;
+
+// the code buffer is a static array so that it lands close enough to the
+// emulator's globals to reach them with RIP-relative addressing
+u8 CodeBufferMem[kCodeBufferSize + 0x1000];
+u8* CodeBuffer;
+u8* CodePtr;
+
+enum
+{
+    RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum
+{
+    CC_O = 0, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+    CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G
+};
+
+#ifdef _WIN32
+const int ArgReg = RCX;
+const int ArgReg2 = RDX;
+#else
+const int ArgReg = RDI;
+const int ArgReg2 = RSI;
+#endif
+
+// memory operands are either relative to the CPU (rbx), or RIP-relative
+struct MemArg
+{
+    const void* Ptr;
+    s32 Disp;
+};
+
+MemArg CPUVar(s32 offset)
+{
+    MemArg ret = {NULL, offset};
+    return ret;
+}
+
+MemArg GlobalVar(const void* ptr)
+{
+    MemArg ret = {ptr, 0};
+    return ret;
+}
+
+
+void Write8(u8 val)
+{
+    *CodePtr++ = val;
+}
+
+void Write32(u32 val)
+{
+    memcpy(CodePtr, &val, 4);
+    CodePtr += 4;
+}
+
+void Write64(u64 val)
+{
+    memcpy(CodePtr, &val, 8);
+    CodePtr += 8;
+}
+
+void WriteREX(bool w, int reg, int rm)
+{
+    u8 rex = 0x40 | (w ? 0x08 : 0) | ((reg & 0x8) ? 0x04 : 0) | ((rm & 0x8) ? 0x01 : 0);
+    if (rex != 0x40) Write8(rex);
+}
+
+void WriteModRM(int reg, MemArg mem, int immsize)
+{
+    if (mem.Ptr)
+    {
+        Write8(0x05 | ((reg & 0x7) << 3));
+        s64 rel = (u8*)mem.Ptr - (CodePtr + 4 + immsize);
+        Write32((u32)(s32)rel);
+    }
+    else
+    {
+        Write8(0x80 | ((reg & 0x7) << 3) | RBX);
+        Write32((u32)mem.Disp);
+    }
+}
+
+void WriteModRMReg(int reg, int rm)
+{
+    Write8(0xC0 | ((reg & 0x7) << 3) | (rm & 0x7));
+}
+
+// op reg, [mem] or op [mem], reg depending on the opcode
+void OpRM(u8 op, int reg, MemArg mem, bool w = false)
+{
+    WriteREX(w, reg, 0);
+    Write8(op);
+    WriteModRM(reg, mem, 0);
+}
+
+// op dst, src, with the 'r/m, reg' encoding
+void OpRR(u8 op, int dst, int src)
+{
+    WriteREX(false, src, dst);
+    Write8(op);
+    WriteModRMReg(src, dst);
+}
+
+enum
+{
+    OP_ADD  = 0x01,
+    OP_OR   = 0x09,
+    OP_AND  = 0x21,
+    OP_SUB  = 0x29,
+    OP_XOR  = 0x31,
+    OP_CMP  = 0x39,
+    OP_TEST = 0x85,
+    OP_MOVRM = 0x89,
+    OP_MOVMR = 0x8B,
+    OP_MOVSXD = 0x63,
+    OP_ADDMR = 0x03,
+    OP_ANDMR = 0x23,
+    OP_CMPMR = 0x3B,
+};
+
+enum
+{
+    ALU_ADD = 0, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR, ALU_CMP
+};
+
+void ALUImm(int ext, int reg, u32 imm)
+{
+    WriteREX(false, 0, reg);
+    Write8(0x81);
+    WriteModRMReg(ext, reg);
+    Write32(imm);
+}
+
+void ALUImmM(int ext, MemArg mem, u32 imm, bool w = false)
+{
+    WriteREX(w, 0, 0);
+    Write8(0x81);
+    WriteModRM(ext, mem, 4);
+    Write32(imm);
+}
+
+void MovImm(int reg, u32 imm)
+{
+    WriteREX(false, 0, reg);
+    Write8(0xB8 + (reg & 0x7));
+    Write32(imm);
+}
+
+void MovImm64(int reg, u64 imm)
+{
+    WriteREX(true, 0, reg);
+    Write8(0xB8 + (reg & 0x7));
+    Write64(imm);
+}
+
+void MovImmM(MemArg mem, u32 imm)
+{
+    Write8(0xC7);
+    WriteModRM(0, mem, 4);
+    Write32(imm);
+}
+
+enum
+{
+    SH_ROL = 0, SH_ROR, SH_RCL, SH_RCR, SH_SHL, SH_SHR, SH_SAL, SH_SAR
+};
+
+void ShiftImm(int ext, int reg, u8 imm)
+{
+    WriteREX(false, 0, reg);
+    if (imm == 1)
+    {
+        Write8(0xD1);
+        WriteModRMReg(ext, reg);
+    }
+    else
+    {
+        Write8(0xC1);
+        WriteModRMReg(ext, reg);
+        Write8(imm);
+    }
+}
+
+void Not(int reg)
+{
+    WriteREX(false, 0, reg);
+    Write8(0xF7);
+    WriteModRMReg(2, reg);
+}
+
+void Xor(int reg)
+{
+    OpRR(OP_XOR, reg, reg);
+}
+
+// only for al/cl/dl/bl and r8b-r15b
+void SetCC(int cc, int reg)
+{
+    WriteREX(false, 0, reg);
+    Write8(0x0F);
+    Write8(0x90 | cc);
+    WriteModRMReg(0, reg);
+}
+
+void BTImm(int reg, u8 bit)
+{
+    WriteREX(false, 0, reg);
+    Write8(0x0F);
+    Write8(0xBA);
+    WriteModRMReg(4, reg);
+    Write8(bit);
+}
+
+void BTImmM(MemArg mem, u8 bit)
+{
+    Write8(0x0F);
+    Write8(0xBA);
+    WriteModRM(4, mem, 1);
+    Write8(bit);
+}
+
+void BT(int reg, int bitreg)
+{
+    WriteREX(false, bitreg, reg);
+    Write8(0x0F);
+    Write8(0xA3);
+    WriteModRMReg(bitreg, reg);
+}
+
+void TestImm8M(MemArg mem, u8 imm)
+{
+    Write8(0xF6);
+    WriteModRM(0, mem, 1);
+    Write8(imm);
+}
+
+void CmpImm8M(MemArg mem, u8 imm)
+{
+    Write8(0x80);
+    WriteModRM(7, mem, 1);
+    Write8(imm);
+}
+
+u8* JccForward(int cc)
+{
+    Write8(0x0F);
+    Write8(0x80 | cc);
+    u8* ret = CodePtr;
+    Write32(0);
+    return ret;
+}
+
+u8* JmpForward()
+{
+    Write8(0xE9);
+    u8* ret = CodePtr;
+    Write32(0);
+    return ret;
+}
+
+void SetJumpTarget(u8* rel, u8* target)
+{
+    s32 disp = (s32)(target - (rel + 4));
+    memcpy(rel, &disp, 4);
+}
+
+// movzx reg, byte [base + index*(1<<shift) + disp]
+void MovzxByteIdx(int reg, int base, int index, int shift, s32 disp)
+{
+    u8 rex = 0x40 | ((reg & 0x8) ? 0x04 : 0) | ((index & 0x8) ? 0x02 : 0) | ((base & 0x8) ? 0x01 : 0);
+    if (rex != 0x40) Write8(rex);
+    Write8(0x0F);
+    Write8(0xB6);
+    Write8(0x84 | ((reg & 0x7) << 3));
+    Write8((shift << 6) | ((index & 0x7) << 3) | (base & 0x7));
+    Write32((u32)disp);
+}
+
+// eax = [rax + rcx], zero-extended
+void LoadHostMem(int size)
+{
+    if (size == 32)
+        Write8(0x8B);
+    else
+    {
+        Write8(0x0F);
+        Write8(size == 16 ? 0xB7 : 0xB6);
+    }
+    Write8(0x04);
+    Write8(0x08);
+}
+
+void CMov(int cc, int dst, int src)
+{
+    WriteREX(false, dst, src);
+    Write8(0x0F);
+    Write8(0x40 | cc);
+    WriteModRMReg(dst, src);
+}
+
+void RorCL(int reg)
+{
+    WriteREX(false, 0, reg);
+    Write8(0xD3);
+    WriteModRMReg(SH_ROR, reg);
+}
+
+void CallPtr(const void* func)
+{
+    MovImm64(RAX, (u64)func);
+    Write8(0xFF);
+    WriteModRMReg(2, RAX);
+}
+
+
+struct NativeOp
+{
+    u32 Op;         // ARM data processing opcode
+    bool S;
+    bool ShiftSetsC;
+    int Rd, Rn;     // -1 if not used
+
+    bool Op2Imm;
+    u32 Imm;
+    int Rm;
+    u32 ShiftType, ShiftAmount;
+
+    u32 R15;
+};
+
+bool IsLogicalOp(u32 op)
+{
+    return !(op >= 0x2 && op <= 0x7) && op != 0xA && op != 0xB;
+}
+
+bool DecodeARMNative(FetchedInstr& instr, NativeOp* op)
+{
+    u32 i = instr.Instr;
+
+    if ((i & 0x0C000000) != 0) return false;
+    if (!(i & 0x02000000) && (i & 0x10)) return false; // shift by register, multiply, etc
+    if ((i & 0x0FFFFFFF) == 0x01A0C00C) return false; // debug hook
+
+    op->Op = (i >> 21) & 0xF;
+    op->S = (i >> 20) & 0x1;
+    if (op->Op >= 0x5 && op->Op <= 0x7) return false; // ADC/SBC/RSC
+
+    bool test = (op->Op >= 0x8 && op->Op <= 0xB);
+    if (test && !op->S) return false; // MRS/MSR and friends
+
+    op->Rd = test ? -1 : ((i >> 12) & 0xF);
+    if (op->Rd == 15) return false;
+    op->Rn = (op->Op == 0xD || op->Op == 0xF) ? -1 : ((i >> 16) & 0xF);
+
+    if (i & 0x02000000)
+    {
+        op->Op2Imm = true;
+        op->Imm = ROR(i & 0xFF, (i >> 7) & 0x1E);
+    }
+    else
+    {
+        op->Op2Imm = false;
+        op->Rm = i & 0xF;
+        op->ShiftType = (i >> 5) & 0x3;
+        op->ShiftAmount = (i >> 7) & 0x1F;
+    }
+
+    // the interpreter only uses the flag-setting shifts for logical ops
+    op->ShiftSetsC = op->S && IsLogicalOp(op->Op);
+    op->R15 = instr.R15;
+    return true;
+}
+
+// the handler the instruction would have on the ARM9. the handlers are
+// instantiated per CPU, but the decoders only care about which instruction
+// it is, so they only compare against one set of them
+typedef void (*DecodeHandler)(ARMv5* cpu);
+
+DecodeHandler GetDecodeHandler(FetchedInstr& instr, bool thumb)
+{
+    using namespace ARMInterpreter;
+
+    if (!instr.Handler)
+        return NULL;
+    if (thumb)
+        return InstrTables<ARMv5>::THUMBInstrTable[(instr.Instr >> 6) & 0x3FF];
+    if ((instr.Instr >> 28) == 0xF)
+        return A_BLX_IMM;
+    return InstrTables<ARMv5>::ARMInstrTable[((instr.Instr >> 4) & 0xF) | ((instr.Instr >> 16) & 0xFF0)];
+}
+
+bool DecodeTHUMBNative(FetchedInstr& instr, NativeOp* op)
+{
+    using namespace ARMInterpreter;
+
+    u32 i = instr.Instr & 0xFFFF;
+    DecodeHandler h = GetDecodeHandler(instr, true);
+
+    op->R15 = instr.R15;
+    op->Op2Imm = false;
+    op->ShiftType = 0;
+    op->ShiftAmount = 0;
+    op->S = true;
+    op->ShiftSetsC = false;
+
+    if (h == T_LSL_IMM<ARMv5> || h == T_LSR_IMM<ARMv5> || h == T_ASR_IMM<ARMv5>)
+    {
+        op->Op = 0xD;
+        op->ShiftSetsC = true;
+        op->Rd = i & 0x7;
+        op->Rn = -1;
+        op->Rm = (i >> 3) & 0x7;
+        op->ShiftType = (h == T_LSL_IMM<ARMv5>) ? 0 : ((h == T_LSR_IMM<ARMv5>) ? 1 : 2);
+        op->ShiftAmount = (i >> 6) & 0x1F;
+        return true;
+    }
+
+    if (h == T_ADD_REG_<ARMv5> || h == T_SUB_REG_<ARMv5> || h == T_ADD_IMM_<ARMv5> || h == T_SUB_IMM_<ARMv5>)
+    {
+        op->Op = (h == T_ADD_REG_<ARMv5> || h == T_ADD_IMM_<ARMv5>) ? 0x4 : 0x2;
+        op->Rd = i & 0x7;
+        op->Rn = (i >> 3) & 0x7;
+        if (h == T_ADD_IMM_<ARMv5> || h == T_SUB_IMM_<ARMv5>)
+        {
+            op->Op2Imm = true;
+            op->Imm = (i >> 6) & 0x7;
+        }
+        else
+            op->Rm = (i >> 6) & 0x7;
+        return true;
+    }
+
+    if (h == T_MOV_IMM<ARMv5> || h == T_CMP_IMM<ARMv5> || h == T_ADD_IMM<ARMv5> || h == T_SUB_IMM<ARMv5>)
+    {
+        static const u32 ops[4] = {0xD, 0xA, 0x4, 0x2};
+        op->Op = ops[(i >> 11) & 0x3];
+        op->Rd = (op->Op == 0xA) ? -1 : ((i >> 8) & 0x7);
+        op->Rn = (op->Op == 0xD) ? -1 : ((i >> 8) & 0x7);
+        op->Op2Imm = true;
+        op->Imm = i & 0xFF;
+        return true;
+    }
+
+    if (h == T_AND_REG<ARMv5> || h == T_EOR_REG<ARMv5> || h == T_TST_REG<ARMv5> || h == T_NEG_REG<ARMv5> ||
+        h == T_CMP_REG<ARMv5> || h == T_CMN_REG<ARMv5> || h == T_ORR_REG<ARMv5> || h == T_BIC_REG<ARMv5> ||
+        h == T_MVN_REG<ARMv5>)
+    {
+        u32 rd = i & 0x7;
+        u32 rs = (i >> 3) & 0x7;
+
+        op->Rd = rd;
+        op->Rn = rd;
+        op->Rm = rs;
+
+        if      (h == T_AND_REG<ARMv5>) op->Op = 0x0;
+        else if (h == T_EOR_REG<ARMv5>) op->Op = 0x1;
+        else if (h == T_TST_REG<ARMv5>) { op->Op = 0x8; op->Rd = -1; }
+        else if (h == T_CMP_REG<ARMv5>) { op->Op = 0xA; op->Rd = -1; }
+        else if (h == T_CMN_REG<ARMv5>) { op->Op = 0xB; op->Rd = -1; }
+        else if (h == T_ORR_REG<ARMv5>) op->Op = 0xC;
+        else if (h == T_BIC_REG<ARMv5>) op->Op = 0xE;
+        else if (h == T_MVN_REG<ARMv5>) { op->Op = 0xF; op->Rn = -1; }
+        else
+        {
+            // NEG is RSB Rd, Rs, #0
+            op->Op = 0x3;
+            op->Rn = rs;
+            op->Op2Imm = true;
+            op->Imm = 0;
+        }
+        return true;
+    }
+
+    if (h == T_ADD_HIREG<ARMv5> || h == T_CMP_HIREG<ARMv5> || h == T_MOV_HIREG<ARMv5>)
+    {
+        u32 rd = (i & 0x7) | ((i >> 4) & 0x8);
+        u32 rs = (i >> 3) & 0xF;
+
+        if (h != T_CMP_HIREG<ARMv5> && rd == 15) return false;
+        if (i == 0x46E4) return false; // debug hook
+
+        op->Rm = rs;
+        if (h == T_ADD_HIREG<ARMv5>)      { op->Op = 0x4; op->Rd = rd; op->Rn = rd; op->S = false; }
+        else if (h == T_CMP_HIREG<ARMv5>) { op->Op = 0xA; op->Rd = -1; op->Rn = rd; }
+        else                       { op->Op = 0xD; op->Rd = rd; op->Rn = -1; op->S = false; }
+        return true;
+    }
+
+    if (h == T_ADD_PCREL<ARMv5>)
+    {
+        op->Op = 0xD;
+        op->S = false;
+        op->Rd = (i >> 8) & 0x7;
+        op->Rn = -1;
+        op->Op2Imm = true;
+        op->Imm = (instr.R15 & ~2) + ((i & 0xFF) << 2);
+        return true;
+    }
+
+    if (h == T_ADD_SPREL<ARMv5> || h == T_ADD_SP<ARMv5>)
+    {
+        op->S = false;
+        op->Rn = 13;
+        op->Op2Imm = true;
+        if (h == T_ADD_SPREL<ARMv5>)
+        {
+            op->Op = 0x4;
+            op->Rd = (i >> 8) & 0x7;
+            op->Imm = (i & 0xFF) << 2;
+        }
+        else
+        {
+            op->Op = (i & (1<<7)) ? 0x2 : 0x4;
+            op->Rd = 13;
+            op->Imm = (i & 0x7F) << 2;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+
+struct LoadOp
+{
+    int Size;       // 8, 16 or 32
+    bool Rotate;    // misaligned word loads are rotated
+    int Rd;
+    int Rn;         // -1 for PC-relative loads, Offset is the address then
+    u32 Offset;
+    bool Post;
+    bool Writeback;
+};
+
+bool DecodeLoad(FetchedInstr& instr, bool thumb, LoadOp* op)
+{
+    using namespace ARMInterpreter;
+
+    u32 i = instr.Instr;
+    DecodeHandler h = GetDecodeHandler(instr, thumb);
+
+    op->Rotate = false;
+    op->Post = false;
+    op->Writeback = false;
+
+    if (thumb)
+    {
+        i &= 0xFFFF;
+
+        if (h == T_LDR_IMM<ARMv5> || h == T_LDRB_IMM<ARMv5> || h == T_LDRH_IMM<ARMv5>)
+        {
+            op->Rd = i & 0x7;
+            op->Rn = (i >> 3) & 0x7;
+            if (h == T_LDR_IMM<ARMv5>)
+            {
+                op->Size = 32;
+                op->Rotate = true;
+                op->Offset = (i >> 4) & 0x7C;
+            }
+            else if (h == T_LDRB_IMM<ARMv5>)
+            {
+                op->Size = 8;
+                op->Offset = (i >> 6) & 0x1F;
+            }
+            else
+            {
+                op->Size = 16;
+                op->Offset = (i >> 5) & 0x3E;
+            }
+            return true;
+        }
+
+        if (h == T_LDR_PCREL<ARMv5>)
+        {
+            op->Size = 32;
+            op->Rd = (i >> 8) & 0x7;
+            op->Rn = -1;
+            op->Offset = (instr.R15 & ~0x2) + ((i & 0xFF) << 2);
+            return true;
+        }
+
+        if (h == T_LDR_SPREL<ARMv5>)
+        {
+            op->Size = 32;
+            op->Rd = (i >> 8) & 0x7;
+            op->Rn = 13;
+            op->Offset = (i << 2) & 0x3FC;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (h == A_LDR_IMM<ARMv5> || h == A_LDRB_IMM<ARMv5> || h == A_LDR_POST_IMM<ARMv5> || h == A_LDRB_POST_IMM<ARMv5>)
+    {
+        bool word = (h == A_LDR_IMM<ARMv5> || h == A_LDR_POST_IMM<ARMv5>);
+
+        op->Size = word ? 32 : 8;
+        op->Rotate = word;
+        op->Rd = (i >> 12) & 0xF;
+        op->Rn = (i >> 16) & 0xF;
+        op->Offset = i & 0xFFF;
+        if (!(i & (1<<23))) op->Offset = -op->Offset;
+        op->Post = (h == A_LDR_POST_IMM<ARMv5> || h == A_LDRB_POST_IMM<ARMv5>);
+        op->Writeback = op->Post || (i & (1<<21));
+
+        if (op->Rd == 15) return false;
+        if (op->Rn == 15)
+        {
+            if (op->Writeback) return false;
+            op->Offset += instr.R15;
+            op->Rn = -1;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+// the slow path, for anything that isn't plain memory
+template<int size, bool rotate>
+u32 SlowLoad(ARM* cpu, u32 addr)
+{
+    u32 val;
+    if (size == 32)      cpu->DataRead32(addr, &val);
+    else if (size == 16) cpu->DataRead16(addr, &val);
+    else                 cpu->DataRead8(addr, &val);
+
+    if (rotate) val = ROR(val, ((addr & 0x3) << 3));
+
+    cpu->AddCycles_CDI();
+    return val;
+}
+
+struct FaultSite
+{
+    u8* Patch;      // start of the fast path, becomes a jump to the slow path
+    u8* SlowPath;
+};
+
+// by address of the host instruction that can fault
+std::unordered_map<u8*, FaultSite> FaultSites;
+
+u8* HandleFault(u8* pc)
+{
+    auto it = FaultSites.find(pc);
+    if (it == FaultSites.end())
+        return NULL;
+
+    // whatever it reads is unlikely to turn into RAM anytime soon
+    u8* oldptr = CodePtr;
+    CodePtr = it->second.Patch;
+    SetJumpTarget(JmpForward(), it->second.SlowPath);
+    CodePtr = oldptr;
+
+    return it->second.SlowPath;
+}
+
+
+void UpdateNZ(ARM* cpu)
+{
+    cpu->UpdateNZ();
+}
+
+void ICacheLookup(ARMv5* cpu, u32 addr)
+{
+    cpu->ICacheLookup(addr);
+}
+
+struct Compiler
+{
+    s32 OffsR, OffsCPSR, OffsNZPending, OffsCycles, OffsAttention;
+    s32 OffsCurInstr, OffsNextInstr, OffsCodeCycles;
+    s32 OffsCodeTimings;
+    s32 CodeTimings;
+    s32 OffsDataCycles, OffsDataRegion;
+    s32 OffsMemBlocks;
+    s32 OffsInstrCount;
+
+    u32 Num;
+    bool Thumb;
+    bool UseFastMem;
+
+    // whether N/Z in CPSR may be stale at this point (see ARM::UpdateNZ()).
+    // only the interpreter handlers leave them that way
+    bool NZMaybePending;
+
+    // by instruction, as the ones that ran are counted on the way out
+    int CurIdx;
+    std::vector<u8*> EpilogueJumps[128];
+
+    struct SlowLoadPath
+    {
+        int Instr;
+        LoadOp Op;
+        std::vector<u8*> Jumps;
+        u8* Patch;
+        u8* Site;
+        u8* Resume;
+    };
+    std::vector<SlowLoadPath> SlowLoads;
+
+    MemArg Reg(int r) { return CPUVar(OffsR + r*4); }
+    MemArg CPSR() { return CPUVar(OffsCPSR); }
+
+    MemArg Timestamp() { return GlobalVar(Num ? &NDS::ARM7Timestamp : &NDS::ARM9Timestamp); }
+    MemArg Target() { return GlobalVar(Num ? &NDS::ARM7Target : &NDS::ARM9Target); }
+
+    void LoadReg(int hostreg, int r, u32 r15)
+    {
+        if (r == 15) MovImm(hostreg, r15);
+        else         OpRM(OP_MOVMR, hostreg, Reg(r));
+    }
+
+    void StoreState(FetchedInstr& instr)
+    {
+        MovImmM(Reg(15), instr.R15);
+        MovImmM(CPUVar(OffsCurInstr), instr.Instr);
+        MovImmM(CPUVar(OffsNextInstr), instr.NextInstr[0]);
+        MovImmM(CPUVar(OffsNextInstr+4), instr.NextInstr[1]);
+        if (Num == 0 && !instr.CacheLookup)
+            MovImmM(CPUVar(OffsCodeCycles), (u32)instr.CodeCycles);
+    }
+
+    void ExitIf(int cc)
+    {
+        EpilogueJumps[CurIdx].push_back(JccForward(cc));
+    }
+
+    void Exit()
+    {
+        EpilogueJumps[CurIdx].push_back(JmpForward());
+    }
+
+    // for ARM::InstrCount
+    void CountInstrs(int num)
+    {
+        ALUImmM(ALU_ADD, CPUVar(OffsInstrCount), num, true);
+    }
+
+    // timestamp += cycles, for instructions that don't touch the CPU's cycle counter
+    // returns a jump to take when the interpreter would have stopped there
+    u8* AddCyclesConst(s32 cycles)
+    {
+        OpRM(OP_MOVMR, RAX, Timestamp(), true);
+        if (cycles)
+        {
+            WriteREX(true, 0, RAX);
+            Write8(0x05); // add rax, imm32
+            Write32((u32)cycles);
+            OpRM(OP_MOVRM, RAX, Timestamp(), true);
+        }
+        OpRM(OP_CMPMR, RAX, Target(), true);
+        return JccForward(CC_AE);
+    }
+
+    // same, with what the instruction cache came up with
+    u8* AddCodeCycles()
+    {
+        OpRM(OP_MOVSXD, RAX, CPUVar(OffsCodeCycles), true);
+        return AddCyclesRAX();
+    }
+
+    u8* AddCyclesRAX()
+    {
+        OpRM(OP_ADDMR, RAX, Timestamp(), true);
+        OpRM(OP_MOVRM, RAX, Timestamp(), true);
+        OpRM(OP_CMPMR, RAX, Target(), true);
+        return JccForward(CC_AE);
+    }
+
+    void EmitHandlerCall(FetchedInstr& instr, bool last)
+    {
+        StoreState(instr);
+
+        WriteREX(true, RBX, ArgReg);
+        Write8(OP_MOVRM);
+        WriteModRMReg(RBX, ArgReg);
+        CallPtr((const void*)instr.Handler);
+
+        EmitPostCallChecks(instr, last);
+    }
+
+    // the interpreter's checks after an instruction, with the pipeline
+    // state already stored
+    void EmitPostCallChecks(FetchedInstr& instr, bool last)
+    {
+        if (last)
+        {
+            // the dispatcher does the rest
+            Exit();
+            return;
+        }
+
+        // did it go somewhere else?
+        MovImm(RAX, instr.R15);
+        OpRM(OP_CMPMR, RAX, Reg(15));
+        ExitIf(CC_NE);
+        TestImm8M(CPSR(), 0x20);
+        ExitIf(Thumb ? CC_E : CC_NE);
+
+        // a jump to the next instruction goes through all of the above
+        // unnoticed, but may still change the code timings
+        MovImm(RAX, (u32)CodeTimings);
+        OpRM(OP_CMPMR, RAX, CPUVar(OffsCodeTimings));
+        ExitIf(CC_NE);
+
+        // halted, or an IRQ that may fire. the dispatcher sorts it out
+        CmpImm8M(CPUVar(OffsAttention), 0);
+        ExitIf(CC_NE);
+
+        // the handler may have overwritten code we were compiled from
+        CmpImm8M(GlobalVar(&BlockInvalidated), 0);
+        ExitIf(CC_NE);
+
+        // timestamp += Cycles; Cycles = 0
+        OpRM(OP_MOVSXD, RAX, CPUVar(OffsCycles), true);
+        OpRM(OP_ADDMR, RAX, Timestamp(), true);
+        OpRM(OP_MOVRM, RAX, Timestamp(), true);
+        MovImmM(CPUVar(OffsCycles), 0);
+        OpRM(OP_CMPMR, RAX, Target(), true);
+        ExitIf(CC_AE);
+    }
+
+    // eax = max(numD + a, max(b, numD + d)), numD in r9d
+    void EmitMaxCycles(s32 a, s32 b, s32 d)
+    {
+        OpRR(OP_MOVRM, RAX, R9);
+        if (d) ALUImm(ALU_ADD, RAX, d);
+        MovImm(RCX, b);
+        OpRR(OP_CMP, RAX, RCX);
+        CMov(CC_L, RAX, RCX);
+        OpRR(OP_MOVRM, RDX, R9);
+        ALUImm(ALU_ADD, RDX, a);
+        OpRR(OP_CMP, RAX, RDX);
+        CMov(CC_L, RAX, RDX);
+    }
+
+    // returns the jump to take when the timestamp reached the target
+    u8* EmitLoad(FetchedInstr& instr, LoadOp& op, int idx)
+    {
+        SlowLoadPath slow;
+        slow.Instr = idx;
+        slow.Op = op;
+
+        // address -> ecx
+        if (op.Rn < 0)
+            MovImm(RCX, op.Offset);
+        else
+        {
+            OpRM(OP_MOVMR, RCX, Reg(op.Rn));
+            if (op.Post)
+            {
+                OpRR(OP_MOVRM, RAX, RCX);
+                ALUImm(ALU_ADD, RAX, op.Offset);
+                OpRM(OP_MOVRM, RAX, Reg(op.Rn));
+            }
+            else
+            {
+                if (op.Offset) ALUImm(ALU_ADD, RCX, op.Offset);
+                if (op.Writeback) OpRM(OP_MOVRM, RCX, Reg(op.Rn));
+            }
+        }
+
+        // the slow path wants the address as-is in r8d
+        OpRR(OP_MOVRM, R8, RCX);
+        if (op.Size == 32)      ALUImm(ALU_AND, RCX, ~3);
+        else if (op.Size == 16) ALUImm(ALU_AND, RCX, ~1);
+
+        // DataCycles -> r9d
+        if (Num == 0)
+        {
+            // TCM isn't in the mirror. the blocks are 16 bytes each, which
+            // is more than an index can be scaled by
+            static_assert(sizeof(ARMv5::MemBlock) == 16, "MemBlock isn't 16 bytes");
+            OpRR(OP_MOVRM, RDX, RCX);
+            ShiftImm(SH_SHR, RDX, 12);
+            ShiftImm(SH_SHL, RDX, 1);
+            OpRR(OP_MOVRM, RAX, RCX);
+            ShiftImm(SH_SHR, RAX, 9);
+            ALUImm(ALU_AND, RAX, 0x7);
+            MovzxByteIdx(R9, RBX, RDX, 3, OffsMemBlocks + offsetof(ARMv5::MemBlock, TCMEnd));
+            OpRR(OP_CMP, RAX, R9);
+            slow.Jumps.push_back(JccForward(CC_B));
+
+            MovzxByteIdx(R9, RBX, RDX, 3, OffsMemBlocks + (op.Size == 32 ? 2 : 1));
+
+            // no timings there, it's up to the data cache
+            ALUImm(ALU_CMP, R9, 0);
+            slow.Jumps.push_back(JccForward(CC_E));
+        }
+        else
+        {
+            // DataRegion -> r10d
+            OpRR(OP_MOVRM, R10, RCX);
+            ShiftImm(SH_SHR, R10, 24);
+            OpRM(OP_MOVRM, R10, CPUVar(OffsDataRegion));
+            MovImm64(RAX, (u64)&NDS::ARM7MemTimings[0][op.Size == 32 ? 2 : 0]);
+            MovzxByteIdx(R9, RAX, R10, 2, 0);
+        }
+        OpRM(OP_MOVRM, R9, CPUVar(OffsDataCycles));
+
+        slow.Patch = CodePtr;
+        MovImm64(RAX, (u64)FastMem::Base[Num]);
+        slow.Site = CodePtr;
+        LoadHostMem(op.Size);
+
+        if (op.Rotate)
+        {
+            OpRR(OP_MOVRM, RCX, R8);
+            ALUImm(ALU_AND, RCX, 0x3);
+            ShiftImm(SH_SHL, RCX, 3);
+            RorCL(RAX);
+        }
+        OpRM(OP_MOVRM, RAX, Reg(op.Rd));
+
+        // cycles, as AddCycles_CDI() would count them
+        if (Num == 0)
+        {
+            s32 numC = (instr.R15 & 0x2) ? 0 : instr.CodeCycles;
+            EmitMaxCycles(numC - 6, numC, 0);
+        }
+        else
+        {
+            s32 numC = NDS::ARM7MemTimings[CodeTimings][Thumb ? 0 : 2];
+            bool codemainram = ((CodeTimings >> 9) == 0x02);
+
+            ALUImm(ALU_CMP, R10, 0x02);
+            u8* notmainram = JccForward(CC_NE);
+            if (codemainram)
+            {
+                OpRR(OP_MOVRM, RAX, R9);
+                ALUImm(ALU_ADD, RAX, numC);
+            }
+            else
+                EmitMaxCycles(numC - 2, numC + 1, 0);
+            u8* done = JmpForward();
+            SetJumpTarget(notmainram, CodePtr);
+            if (codemainram)
+                EmitMaxCycles(numC - 2, numC, 1);
+            else
+            {
+                OpRR(OP_MOVRM, RAX, R9);
+                ALUImm(ALU_ADD, RAX, numC + 1);
+            }
+            SetJumpTarget(done, CodePtr);
+        }
+
+        SlowLoads.push_back(slow);
+        return AddCyclesRAX();
+    }
+
+    void EmitSlowLoad(FetchedInstr* instrs, int num, SlowLoadPath& slow)
+    {
+        FetchedInstr& instr = instrs[slow.Instr];
+        LoadOp& op = slow.Op;
+        CurIdx = slow.Instr;
+
+        for (size_t j = 0; j < slow.Jumps.size(); j++)
+            SetJumpTarget(slow.Jumps[j], CodePtr);
+
+        FaultSite site = {slow.Patch, CodePtr};
+        FaultSites[slow.Site] = site;
+
+        StoreState(instr);
+
+        u32 (*func)(ARM*, u32);
+        if (op.Size == 32) func = op.Rotate ? SlowLoad<32, true> : SlowLoad<32, false>;
+        else if (op.Size == 16) func = SlowLoad<16, false>;
+        else func = SlowLoad<8, false>;
+
+        OpRR(OP_MOVRM, ArgReg2, R8);
+        WriteREX(true, RBX, ArgReg);
+        Write8(OP_MOVRM);
+        WriteModRMReg(RBX, ArgReg);
+        CallPtr((const void*)func);
+        OpRM(OP_MOVRM, RAX, Reg(op.Rd));
+
+        // I/O reads have side effects
+        bool last = (slow.Instr == num-1);
+        EmitPostCallChecks(instr, last);
+        if (!last)
+            SetJumpTarget(JmpForward(), slow.Resume);
+    }
+
+    void EmitNative(NativeOp& op)
+    {
+        bool logical = IsLogicalOp(op.Op);
+        bool shiftc = false;
+
+        // operand 2 -> ecx, shifter carry -> r8b
+        if (op.Op2Imm)
+            MovImm(RCX, op.Imm);
+        else
+        {
+            LoadReg(RCX, op.Rm, op.R15);
+
+            bool setc = op.ShiftSetsC;
+            u32 amount = op.ShiftAmount;
+            switch (op.ShiftType)
+            {
+            case 0: // LSL
+                if (amount)
+                {
+                    if (setc)
+                    {
+                        Xor(R8);
+                        BTImm(RCX, 32 - amount);
+                        SetCC(CC_B, R8);
+                        shiftc = true;
+                    }
+                    ShiftImm(SH_SHL, RCX, amount);
+                }
+                break;
+
+            case 1: // LSR
+                if (setc)
+                {
+                    Xor(R8);
+                    BTImm(RCX, amount ? (amount-1) : 31);
+                    SetCC(CC_B, R8);
+                    shiftc = true;
+                }
+                if (amount) ShiftImm(SH_SHR, RCX, amount);
+                else        Xor(RCX);
+                break;
+
+            case 2: // ASR
+                if (setc)
+                {
+                    Xor(R8);
+                    BTImm(RCX, amount ? (amount-1) : 31);
+                    SetCC(CC_B, R8);
+                    shiftc = true;
+                }
+                ShiftImm(SH_SAR, RCX, amount ? amount : 31);
+                break;
+
+            case 3: // ROR
+                if (amount)
+                {
+                    if (setc)
+                    {
+                        Xor(R8);
+                        BTImm(RCX, amount-1);
+                        SetCC(CC_B, R8);
+                        shiftc = true;
+                    }
+                    ShiftImm(SH_ROR, RCX, amount);
+                }
+                else
+                {
+                    // RRX
+                    if (setc) Xor(R8);
+                    BTImmM(CPSR(), 29);
+                    ShiftImm(SH_RCR, RCX, 1);
+                    if (setc)
+                    {
+                        SetCC(CC_B, R8);
+                        shiftc = true;
+                    }
+                }
+                break;
+            }
+        }
+
+        if (op.Rn >= 0)
+            LoadReg(RAX, op.Rn, op.R15);
+
+        if (op.S)
+        {
+            Xor(RDX);
+            Xor(R9);
+            if (!logical)
+            {
+                Xor(R10);
+                Xor(R11);
+            }
+        }
+
+        int res = RAX;
+        switch (op.Op)
+        {
+        case 0x0: case 0x8: OpRR(OP_AND, RAX, RCX); break;
+        case 0x1: case 0x9: OpRR(OP_XOR, RAX, RCX); break;
+        case 0x2: case 0xA: OpRR(OP_SUB, RAX, RCX); break;
+        case 0x3: OpRR(OP_SUB, RCX, RAX); res = RCX; break;
+        case 0x4: case 0xB: OpRR(OP_ADD, RAX, RCX); break;
+        case 0xC: OpRR(OP_OR, RAX, RCX); break;
+        case 0xD: res = RCX; break;
+        case 0xE: Not(RCX); OpRR(OP_AND, RAX, RCX); break;
+        case 0xF: Not(RCX); res = RCX; break;
+        }
+
+        if (op.S)
+        {
+            u32 mask;
+            if (logical)
+            {
+                OpRR(OP_TEST, res, res);
+                SetCC(CC_S, RDX);
+                SetCC(CC_E, R9);
+            }
+            else
+            {
+                bool sub = (op.Op == 0x2 || op.Op == 0x3 || op.Op == 0xA);
+                SetCC(CC_S, RDX);
+                SetCC(CC_E, R9);
+                SetCC(sub ? CC_AE : CC_B, R10);
+                SetCC(CC_O, R11);
+            }
+
+            ShiftImm(SH_SHL, RDX, 31);
+            ShiftImm(SH_SHL, R9, 30);
+            OpRR(OP_OR, RDX, R9);
+            if (!logical)
+            {
+                ShiftImm(SH_SHL, R10, 29);
+                ShiftImm(SH_SHL, R11, 28);
+                OpRR(OP_OR, RDX, R10);
+                OpRR(OP_OR, RDX, R11);
+                mask = 0x0FFFFFFF;
+            }
+            else if (shiftc)
+            {
+                ShiftImm(SH_SHL, R8, 29);
+                OpRR(OP_OR, RDX, R8);
+                mask = 0x1FFFFFFF;
+            }
+            else
+                mask = 0x3FFFFFFF;
+
+            ALUImmM(ALU_AND, CPSR(), mask);
+            OpRM(OP_OR, RDX, CPSR());
+            if (NZMaybePending)
+            {
+                MovImmM(CPUVar(OffsNZPending), 0);
+                NZMaybePending = false;
+            }
+        }
+
+        if (op.Rd >= 0)
+            OpRM(OP_MOVRM, res, Reg(op.Rd));
+    }
+
+    u8* Compile(ARM* cpu, bool thumb, FetchedInstr* instrs, int num)
+    {
+        OffsR = (u8*)&cpu->R[0] - (u8*)cpu;
+        OffsCPSR = (u8*)&cpu->CPSR - (u8*)cpu;
+        OffsNZPending = (u8*)&cpu->NZPending - (u8*)cpu;
+        OffsCycles = (u8*)&cpu->Cycles - (u8*)cpu;
+        OffsAttention = (u8*)&cpu->Attention - (u8*)cpu;
+        OffsCurInstr = (u8*)&cpu->CurInstr - (u8*)cpu;
+        OffsNextInstr = (u8*)&cpu->NextInstr[0] - (u8*)cpu;
+        OffsCodeCycles = (u8*)&cpu->CodeCycles - (u8*)cpu;
+        OffsDataCycles = (u8*)&cpu->DataCycles - (u8*)cpu;
+        OffsDataRegion = (u8*)&cpu->DataRegion - (u8*)cpu;
+        OffsInstrCount = (u8*)&cpu->InstrCount - (u8*)cpu;
+        if (cpu->Num == 0)
+        {
+            ARMv5* cpu9 = (ARMv5*)cpu;
+            OffsCodeTimings = (u8*)&cpu9->RegionCodeCycles - (u8*)cpu;
+            CodeTimings = cpu9->RegionCodeCycles;
+            OffsMemBlocks = (u8*)&cpu9->MemBlocks[0] - (u8*)cpu;
+        }
+        else
+        {
+            OffsCodeTimings = OffsCodeCycles;
+            CodeTimings = cpu->CodeCycles;
+        }
+
+        Num = cpu->Num;
+        Thumb = thumb;
+        UseFastMem = Config::JIT_FastMem && FastMem::Base[Num];
+        NZMaybePending = true;
+        for (int i = 0; i < num; i++)
+            EpilogueJumps[i].clear();
+        SlowLoads.clear();
+
+        u8* start = CodePtr;
+
+        // prologue
+        Write8(0x53); // push rbx
+#ifdef _WIN32
+        Write8(0x48); Write8(0x83); Write8(0xEC); Write8(0x20); // sub rsp, 32
+#endif
+        WriteREX(true, ArgReg, RBX);
+        Write8(OP_MOVRM);
+        WriteModRMReg(ArgReg, RBX);
+
+        // exits that need the pipeline state written back
+        std::vector<u8*> stubjumps[128];
+
+        for (int i = 0; i < num; i++)
+        {
+            FetchedInstr& instr = instrs[i];
+            bool last = (i == num-1);
+            CurIdx = i;
+
+            s32 cycles = instr.Cycles;
+
+            NativeOp op;
+            bool native;
+            if (thumb) native = DecodeTHUMBNative(instr, &op);
+            else       native = DecodeARMNative(instr, &op);
+
+            LoadOp load;
+            bool fastload = !native && UseFastMem && DecodeLoad(instr, thumb, &load);
+
+            if (instr.CacheLookup)
+            {
+                // the code timings are only known once the cache is
+                // looked up. fast loads have them baked in
+                fastload = false;
+
+                MovImm(ArgReg2, instr.R15);
+                WriteREX(true, RBX, ArgReg);
+                Write8(OP_MOVRM);
+                WriteModRMReg(RBX, ArgReg);
+                CallPtr((const void*)ICacheLookup);
+            }
+
+            u32 cond = thumb ? 0xE : (instr.Instr >> 28);
+            u8* condfail = NULL;
+            bool never = false;
+
+            if (cond == 0xF)
+            {
+                // only the ARM9's BLX gets here
+                if (!instr.Handler) never = true;
+            }
+            else if (cond != 0xE)
+            {
+                if (NZMaybePending)
+                {
+                    WriteREX(true, RBX, ArgReg);
+                    Write8(OP_MOVRM);
+                    WriteModRMReg(RBX, ArgReg);
+                    CallPtr((const void*)UpdateNZ);
+                    NZMaybePending = false;
+                }
+
+                OpRM(OP_MOVMR, RAX, CPSR());
+                ShiftImm(SH_SHR, RAX, 28);
+                MovImm(RCX, ARM::ConditionTable[cond]);
+                BT(RCX, RAX);
+                condfail = JccForward(CC_AE);
+            }
+
+            if (never)
+            {
+                // same as a failed condition
+            }
+            else if (fastload)
+            {
+                stubjumps[i].push_back(EmitLoad(instr, load, i));
+                if (last) stubjumps[i].push_back(JmpForward());
+
+                if (condfail)
+                {
+                    u8* skip = last ? NULL : JmpForward();
+                    SetJumpTarget(condfail, CodePtr);
+                    stubjumps[i].push_back(AddCyclesConst(cycles));
+                    if (last) stubjumps[i].push_back(JmpForward());
+                    else      SetJumpTarget(skip, CodePtr);
+                }
+
+                SlowLoads.back().Resume = CodePtr;
+                continue;
+            }
+            else if (native)
+            {
+                EmitNative(op);
+                if (condfail)
+                {
+                    SetJumpTarget(condfail, CodePtr);
+                    condfail = NULL;
+                }
+            }
+            else
+            {
+                EmitHandlerCall(instr, last);
+                NZMaybePending = true;
+                if (!condfail) continue;
+
+                u8* skip = last ? NULL : JmpForward();
+                SetJumpTarget(condfail, CodePtr);
+                condfail = NULL;
+
+                stubjumps[i].push_back(instr.CacheLookup ? AddCodeCycles() : AddCyclesConst(cycles));
+                if (last) stubjumps[i].push_back(JmpForward());
+                else      SetJumpTarget(skip, CodePtr);
+                continue;
+            }
+
+            stubjumps[i].push_back(instr.CacheLookup ? AddCodeCycles() : AddCyclesConst(cycles));
+            if (last) stubjumps[i].push_back(JmpForward());
+        }
+
+        // epilogue
+        u8* epilogue = CodePtr;
+#ifdef _WIN32
+        Write8(0x48); Write8(0x83); Write8(0xC4); Write8(0x20); // add rsp, 32
+#endif
+        Write8(0x5B); // pop rbx
+        Write8(0xC3); // ret
+
+        for (size_t j = 0; j < SlowLoads.size(); j++)
+            EmitSlowLoad(instrs, num, SlowLoads[j]);
+
+        for (int i = 0; i < num; i++)
+        {
+            if (EpilogueJumps[i].empty()) continue;
+
+            for (size_t j = 0; j < EpilogueJumps[i].size(); j++)
+                SetJumpTarget(EpilogueJumps[i][j], CodePtr);
+
+            CountInstrs(i + 1);
+            SetJumpTarget(JmpForward(), epilogue);
+        }
+
+        for (int i = 0; i < num; i++)
+        {
+            if (stubjumps[i].empty()) continue;
+
+            for (size_t j = 0; j < stubjumps[i].size(); j++)
+                SetJumpTarget(stubjumps[i][j], CodePtr);
+
+            StoreState(instrs[i]);
+            CountInstrs(i + 1);
+            SetJumpTarget(JmpForward(), epilogue);
+        }
+
+        return start;
+    }
+};
+
+Compiler* JitCompiler;
+
+
+bool BackendInit()
+{
+    CodeBuffer = (u8*)(((u64)&CodeBufferMem[0] + 0xFFF) & ~(u64)0xFFF);
+
+#ifdef _WIN32
+    DWORD oldprot;
+    if (!VirtualProtect(CodeBuffer, kCodeBufferSize, PAGE_EXECUTE_READWRITE, &oldprot))
+        return false;
+#else
+    if (mprotect(CodeBuffer, kCodeBufferSize, PROT_READ | PROT_WRITE | PROT_EXEC))
+        return false;
+#endif
+
+    // everything the emitted code touches needs to be within reach
+    const void* globals[] = {&NDS::ARM9Timestamp, &NDS::ARM9Target, &NDS::ARM7Timestamp, &NDS::ARM7Target,
+                             &NDS::IF[0], &BlockInvalidated};
+    for (int i = 0; i < 6; i++)
+    {
+        s64 dist = (u8*)globals[i] - CodeBuffer;
+        if (dist < -0x70000000LL || dist > 0x70000000LL)
+            return false;
+    }
+
+    CodePtr = CodeBuffer;
+    JitCompiler = new Compiler;
+    FastMem::SetFaultHandler(HandleFault);
+    return true;
+}
+
+void BackendDeInit()
+{
+    FastMem::SetFaultHandler(NULL);
+    FaultSites.clear();
+    delete JitCompiler;
+    JitCompiler = NULL;
+}
+
+void BackendReset()
+{
+    CodePtr = CodeBuffer;
+    FaultSites.clear();
+}
+
+bool BackendHasRoom()
+{
+    return (CodePtr + kMaxBlockCodeSize) <= (CodeBuffer + kCodeBufferSize);
+}
+
+JitBlockEntry CompileBlock(ARM* cpu, bool thumb, FetchedInstr* instrs, int num)
+{
+    if (!JitCompiler || !BackendHasRoom())
+        return NULL;
+
+    return (JitBlockEntry)JitCompiler->Compile(cpu, thumb, instrs, num);
+}
+
+#else
+
+// no backend for this platform
+
+bool BackendInit() { return false; }
+void BackendDeInit() {}
+void BackendReset() {}
+bool BackendHasRoom() { return false; }
+JitBlockEntry CompileBlock(ARM* cpu, bool thumb, FetchedInstr* instrs, int num) { return NULL; }
+
+#endif
+
+}
@@ -18,17 +18,19 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include "NDS.h"
 #include "ARM.h"
+#include "ARMJIT.h"
+#include "Config.h"
 
 
-// access timing for cached regions
+// access timing for data in cached regions
 // this would be an average between cache hits and cache misses
 // this was measured to be close to hardware average
 // a value of 1 would represent a perfect cache, but that causes
 // games to run too fast, causing a number of issues
 const int kDataCacheTiming = 2;
-const int kCodeCacheTiming = 5;
 
 
 void ARMv5::CP15Reset()
@@ -46,11 +48,26 @@ void ARMv5::CP15Reset()
     ITCMSize = 0;
     DTCMBase = 0xFFFFFFFF;
     DTCMSize = 0;
+    UpdateTCMBlocks(0x00000000, 0xFFFFFFFF);
+
+    // the NDS fills in what's below 0x10000000 when it remaps its pages
+    for (u32 i = 0; i < 0x100000; i++)
+    {
+        MemBlocks[i].Mem = NULL;
+        MemBlocks[i].MemWrite = 0;
+    }
 
     memset(ICache, 0, 0x2000);
     ICacheInvalidateAll();
     memset(ICacheCount, 0, 64);
 
+    DCacheInvalidateAll();
+    memset(DCacheCount, 0, 32);
+    memset(WriteBufferTime, 0, 16*sizeof(u64));
+    WriteBufferPos = 0;
+
+    CacheVersion = 0;
+
     PU_CodeCacheable = 0;
     PU_DataCacheable = 0;
     PU_DataCacheWrite = 0;
@@ -73,7 +90,7 @@ void ARMv5::CP15DoSavestate(Savestate* file)
     file->Var32(&DTCMSetting);
     file->Var32(&ITCMSetting);
 
-    file->VarArray(ITCM, 0x8000);
+    ARMJIT::DoSavestateCode(file, ARMJIT::CodeSpace_ITCM, ITCM, 0x8000);
     file->VarArray(DTCM, 0x4000);
 
     file->Var32(&PU_CodeCacheable);
@@ -85,8 +102,47 @@ void ARMv5::CP15DoSavestate(Savestate* file)
 
     file->VarArray(PU_Region, 8*sizeof(u32));
 
+    if (file->IsAtleastVersion(4, 1))
+    {
+        file->Var32(&RNGSeed);
+
+        file->VarArray(ICache, 0x2000);
+        file->VarArray(ICacheTags, 64*4*sizeof(u32));
+        file->VarArray(ICacheCount, 64);
+
+        u32 curline = CurICacheLine ? ((CurICacheLine - ICache) >> 5) : 0xFFFFFFFF;
+        file->Var32(&curline);
+        if (!file->Saving)
+            CurICacheLine = (curline < 64*4) ? &ICache[curline << 5] : NULL;
+    }
+    else if (!file->Saving)
+    {
+        ICacheInvalidateAll();
+        CurICacheLine = NULL;
+    }
+
+    if (file->IsAtleastVersion(4, 2))
+    {
+        file->VarArray(DCacheTags, 32*4*sizeof(u32));
+        file->VarArray(DCacheDirty, 32*4);
+        file->VarArray(DCacheCount, 32);
+
+        file->VarArray(WriteBufferTime, 16*sizeof(u64));
+        file->Var32(&WriteBufferPos);
+    }
+    else if (!file->Saving)
+    {
+        DCacheInvalidateAll();
+        memset(WriteBufferTime, 0, 16*sizeof(u64));
+        WriteBufferPos = 0;
+    }
+
+    DCacheLastLine = 1;
+
     if (!file->Saving)
     {
+        CacheVersion++;
+
         UpdateDTCMSetting();
         UpdateITCMSetting();
         UpdatePURegions();
@@ -96,6 +152,9 @@ void ARMv5::CP15DoSavestate(Savestate* file)
 
 void ARMv5::UpdateDTCMSetting()
 {
+    u32 oldbase = DTCMBase;
+    u32 oldsize = DTCMSize;
+
     if (CP15Control & (1<<16))
     {
         DTCMBase = DTCMSetting & 0xFFFFF000;
@@ -108,10 +167,18 @@ void ARMv5::UpdateDTCMSetting()
         DTCMSize = 0;
         //printf("DTCM disabled\n");
     }
+
+    if (DTCMBase != oldbase || DTCMSize != oldsize)
+    {
+        UpdateTCMBlocks(oldbase, oldbase + oldsize);
+        UpdateTCMBlocks(DTCMBase, DTCMBase + DTCMSize);
+    }
 }
 
 void ARMv5::UpdateITCMSetting()
 {
+    u32 oldsize = ITCMSize;
+
     if (CP15Control & (1<<18))
     {
         ITCMSize = 0x200 << ((ITCMSetting >> 1) & 0x1F);
@@ -122,6 +189,62 @@ void ARMv5::UpdateITCMSetting()
         ITCMSize = 0;
         //printf("ITCM disabled\n");
     }
+
+    // what code lives where just changed
+    if (ITCMSize != oldsize)
+    {
+        UpdateTCMBlocks(0, std::max(ITCMSize, oldsize));
+        ARMJIT::InvalidateAll();
+    }
+}
+
+// the TCM checks done for every access, brought down to the 4KB blocks.
+// TCM sizes are multiples of 512 bytes and the DTCM base is 4KB aligned, so
+// a block is always TCM from its start up to some point, ITCM first
+void ARMv5::UpdateTCMBlocks(u32 addrstart, u32 addrend)
+{
+    // same as the checks themselves: nothing is in there if it wraps around
+    if (addrend <= addrstart) return;
+
+    u32 start = addrstart >> 12;
+    u32 end = (addrend >> 12) + ((addrend & 0xFFF) ? 1 : 0);
+    u32 dtcmend = DTCMBase + DTCMSize;
+
+    for (u32 i = start; i < end; i++)
+    {
+        u32 addr = i << 12;
+        u32 itcm = 0, dtcm = 0;
+
+        if (addr < ITCMSize)
+            itcm = std::min(ITCMSize - addr, (u32)0x1000) >> 9;
+        if (addr >= DTCMBase && addr < dtcmend)
+            dtcm = std::min(dtcmend - addr, (u32)0x1000) >> 9;
+
+        MemBlocks[i].ITCMEnd = itcm;
+        MemBlocks[i].TCMEnd = std::max(itcm, dtcm);
+    }
+}
+
+// follows NDS::ARM9ReadMap, called after it's updated. its pages are 16KB,
+// only those that are plain memory all the way through can be used here
+void ARMv5::UpdateMemBlocks(u32 addrstart, u32 addrend)
+{
+    for (u32 addr = addrstart; addr < addrend; addr += 0x1000)
+    {
+        NDS::MemPage& page = NDS::ARM9ReadMap[addr >> 14];
+        MemBlock& block = MemBlocks[addr >> 12];
+
+        if (page.Mem && page.Mask == 0x3FFF)
+        {
+            block.Mem = &page.Mem[addr & 0x3000];
+            block.MemWrite = (addr & 0xFF000000) == 0x02000000;
+        }
+        else
+        {
+            block.Mem = NULL;
+            block.MemWrite = 0;
+        }
+    }
 }
 
 
@@ -137,6 +260,8 @@ void ARMv5::UpdatePURegions()
 
         memset(PU_UserMap, mask, 0x100000);
         memset(PU_PrivMap, mask, 0x100000);
+        for (u32 i = 0; i < 0x100000; i++)
+            MemBlocks[i].PU = mask;
 
         return;
     }
@@ -258,27 +383,37 @@ void ARMv5::UpdateRegionTimings(u32 addrstart, u32 addrend)
     {
         u8 pu = PU_Map[i];
         u8* bustimings = NDS::ARM9MemTimings[i >> 2];
+        u8* timings = MemBlocks[i].Timings;
+
+        MemBlocks[i].PU = pu;
 
         if (pu & 0x40)
         {
-            MemTimings[i][0] = 0xFF;//kCodeCacheTiming;
+            timings[0] = 0xFF; // goes through the instruction cache
         }
         else
         {
-            MemTimings[i][0] = bustimings[2] << NDS::ARM9ClockShift;
+            timings[0] = bustimings[2] << NDS::ARM9ClockShift;
         }
 
-        if (pu & 0x10)
+        if ((pu & 0x10) && Config::DataCacheModel)
+        {
+            // goes through DCacheRead()/DCacheWrite()
+            timings[1] = 0;
+            timings[2] = 0;
+            timings[3] = 0;
+        }
+        else if (pu & 0x10)
         {
-            MemTimings[i][1] = kDataCacheTiming;
-            MemTimings[i][2] = kDataCacheTiming;
-            MemTimings[i][3] = 1;
+            timings[1] = kDataCacheTiming;
+            timings[2] = kDataCacheTiming;
+            timings[3] = 1;
         }
         else
         {
-            MemTimings[i][1] = bustimings[0] << NDS::ARM9ClockShift;
-            MemTimings[i][2] = bustimings[2] << NDS::ARM9ClockShift;
-            MemTimings[i][3] = bustimings[3] << NDS::ARM9ClockShift;
+            timings[1] = bustimings[0] << NDS::ARM9ClockShift;
+            timings[2] = bustimings[2] << NDS::ARM9ClockShift;
+            timings[3] = bustimings[3] << NDS::ARM9ClockShift;
         }
     }
 }
@@ -294,7 +429,6 @@ u32 ARMv5::RandomLineIndex()
     return (RNGSeed >> 17) & 0x3;
 }
 
-int zog=1;
 void ARMv5::ICacheLookup(u32 addr)
 {
     u32 tag = addr & 0xFFFFF800;
@@ -303,25 +437,25 @@ void ARMv5::ICacheLookup(u32 addr)
     id <<= 2;
     if (ICacheTags[id+0] == tag)
     {
-        CodeCycles = 1;zog=1;
+        CodeCycles = 1;
         CurICacheLine = &ICache[(id+0) << 5];
         return;
     }
     if (ICacheTags[id+1] == tag)
     {
-        CodeCycles = 1;zog=2;
+        CodeCycles = 1;
         CurICacheLine = &ICache[(id+1) << 5];
         return;
     }
     if (ICacheTags[id+2] == tag)
     {
-        CodeCycles = 1;zog=3;
+        CodeCycles = 1;
         CurICacheLine = &ICache[(id+2) << 5];
         return;
     }
     if (ICacheTags[id+3] == tag)
     {
-        CodeCycles = 1;zog=4;
+        CodeCycles = 1;
         CurICacheLine = &ICache[(id+3) << 5];
         return;
     }
@@ -355,6 +489,7 @@ void ARMv5::ICacheLookup(u32 addr)
     }
 
     ICacheTags[line] = tag;
+    CacheVersion++;
 
     // ouch :/
     //printf("cache miss %08X: %d/%d\n", addr, NDS::ARM9MemTimings[addr >> 14][2], NDS::ARM9MemTimings[addr >> 14][3]);
@@ -362,8 +497,28 @@ void ARMv5::ICacheLookup(u32 addr)
     CurICacheLine = ptr;
 }
 
+// like ICacheLookup(), minus filling the line on a miss
+s32 ARMv5::ICacheFindLine(u32 addr)
+{
+    u32 tag = addr & 0xFFFFF800;
+    u32 id = ((addr >> 5) & 0x3F) << 2;
+
+    if (ICacheTags[id+0] == tag) return id+0;
+    if (ICacheTags[id+1] == tag) return id+1;
+    if (ICacheTags[id+2] == tag) return id+2;
+    if (ICacheTags[id+3] == tag) return id+3;
+
+    return -1;
+}
+
 void ARMv5::ICacheInvalidateByAddr(u32 addr)
 {
+    // games do this after writing code. writes are already caught, but this
+    // also covers code that was changed behind the CPU's back
+    ARMJIT::InvalidateByCPUAddr(this, addr & ~0x1F, 32);
+
+    CacheVersion++;
+
     u32 tag = addr & 0xFFFFF800;
     u32 id = (addr >> 5) & 0x3F;
 
@@ -392,11 +547,154 @@ void ARMv5::ICacheInvalidateByAddr(u32 addr)
 
 void ARMv5::ICacheInvalidateAll()
 {
+    CacheVersion++;
+
     for (int i = 0; i < 64*4; i++)
         ICacheTags[i] = 1;
 }
 
 
+// the data cache: 4KB, 4-way, 32 byte lines. only the timings are emulated,
+// data always comes from memory. the write buffer takes 16 writes and puts
+// them on the bus one after another while the CPU keeps going
+
+s32 ARMv5::DCacheRead(u32 addr, s32 elapsed)
+{
+    // most accesses are to the same line as the last one
+    if ((addr & ~0x1F) == DCacheLastLine)
+        return 1;
+
+    if (DCacheFindLine(addr) >= 0)
+    {
+        DCacheLastLine = addr & ~0x1F;
+        return 1;
+    }
+
+    // cache miss
+
+    u32 id = ((addr >> 5) & 0x1F) << 2;
+    u32 line;
+    if (CP15Control & (1<<14))
+    {
+        line = DCacheCount[id>>2];
+        DCacheCount[id>>2] = (line+1) & 0x3;
+    }
+    else
+    {
+        line = RandomLineIndex();
+    }
+
+    line += id;
+
+    // what was there goes out through the write buffer first
+    s32 cycles = 0;
+    if (DCacheDirty[line])
+    {
+        u32 oldaddr = DCacheTags[line] | (addr & 0x3E0);
+        s32 wbcycles = (NDS::ARM9MemTimings[oldaddr >> 14][2] + (NDS::ARM9MemTimings[oldaddr >> 14][3] * 7)) << NDS::ARM9ClockShift;
+        cycles = WriteBufferPush(wbcycles, elapsed);
+    }
+
+    DCacheTags[line] = addr & 0xFFFFFC00;
+    DCacheDirty[line] = 0;
+    DCacheLastLine = addr & ~0x1F;
+    CacheVersion++;
+
+    cycles += (NDS::ARM9MemTimings[addr >> 14][2] + (NDS::ARM9MemTimings[addr >> 14][3] * 7)) << NDS::ARM9ClockShift;
+    return cycles;
+}
+
+s32 ARMv5::DCacheWrite(u32 addr, s32 buscycles, s32 elapsed)
+{
+    // lines aren't allocated on writes. write-back regions keep it in the
+    // cache if it's there, everything else goes through the write buffer
+    if (MemBlocks[addr >> 12].PU & 0x20)
+    {
+        s32 line = DCacheFindLine(addr);
+        if (line >= 0)
+        {
+            DCacheDirty[line] = 1;
+            return 1;
+        }
+    }
+
+    return 1 + WriteBufferPush(buscycles, elapsed);
+}
+
+s32 ARMv5::DCacheFindLine(u32 addr)
+{
+    u32 tag = addr & 0xFFFFFC00;
+    u32 id = ((addr >> 5) & 0x1F) << 2;
+
+    if (DCacheTags[id+0] == tag) return id+0;
+    if (DCacheTags[id+1] == tag) return id+1;
+    if (DCacheTags[id+2] == tag) return id+2;
+    if (DCacheTags[id+3] == tag) return id+3;
+
+    return -1;
+}
+
+void ARMv5::DCacheClean(u32 line)
+{
+    if (!DCacheDirty[line]) return;
+
+    u32 addr = DCacheTags[line] | ((line >> 2) << 5);
+    s32 cycles = (NDS::ARM9MemTimings[addr >> 14][2] + (NDS::ARM9MemTimings[addr >> 14][3] * 7)) << NDS::ARM9ClockShift;
+    Cycles += WriteBufferPush(cycles, 0);
+
+    DCacheDirty[line] = 0;
+}
+
+void ARMv5::DCacheInvalidateLine(u32 line)
+{
+    // dirty data is lost, as on hardware
+    DCacheTags[line] = 1;
+    DCacheDirty[line] = 0;
+    DCacheLastLine = 1;
+    CacheVersion++;
+}
+
+void ARMv5::DCacheInvalidateAll()
+{
+    for (int i = 0; i < 32*4; i++)
+    {
+        DCacheTags[i] = 1;
+        DCacheDirty[i] = 0;
+    }
+
+    DCacheLastLine = 1;
+    CacheVersion++;
+}
+
+s32 ARMv5::WriteBufferPush(s32 buscycles, s32 elapsed)
+{
+    u64 now = NDS::ARM9Timestamp + Cycles + elapsed;
+    s32 stall = 0;
+
+    // the oldest entry has to be out to make room
+    u64 oldest = WriteBufferTime[WriteBufferPos];
+    if (oldest > now)
+    {
+        stall = (s32)(oldest - now);
+        now = oldest;
+    }
+
+    u64 last = WriteBufferTime[(WriteBufferPos - 1) & 0xF];
+    WriteBufferTime[WriteBufferPos] = std::max(now, last) + buscycles;
+    WriteBufferPos = (WriteBufferPos + 1) & 0xF;
+
+    return stall;
+}
+
+void ARMv5::WriteBufferDrain()
+{
+    u64 now = NDS::ARM9Timestamp + Cycles;
+    u64 last = WriteBufferTime[(WriteBufferPos - 1) & 0xF];
+    if (last > now)
+        Cycles += (s32)(last - now);
+}
+
+
 void ARMv5::CP15Write(u32 id, u32 val)
 {
     //printf("CP15 write op %03X %08X %08X\n", id, val, NDS::ARM9->R[15]);
@@ -523,18 +821,45 @@ void ARMv5::CP15Write(u32 id, u32 val)
         return;
 
 
+    case 0x760:
+        DCacheInvalidateAll();
+        return;
     case 0x761:
-        //printf("inval data cache %08X\n", val);
+        {
+            s32 line = DCacheFindLine(val);
+            if (line >= 0) DCacheInvalidateLine(line);
+        }
         return;
     case 0x762:
-        //printf("inval data cache SI\n");
+        DCacheInvalidateLine((((val >> 5) & 0x1F) << 2) | (val >> 30));
         return;
 
     case 0x7A1:
-        //printf("flush data cache %08X\n", val);
+        {
+            s32 line = DCacheFindLine(val);
+            if (line >= 0) DCacheClean(line);
+        }
         return;
     case 0x7A2:
-        //printf("flush data cache SI\n");
+        DCacheClean((((val >> 5) & 0x1F) << 2) | (val >> 30));
+        return;
+    case 0x7A4:
+        WriteBufferDrain();
+        return;
+
+    case 0x7E1:
+        {
+            s32 line = DCacheFindLine(val);
+            if (line >= 0)
+            {
+                DCacheClean(line);
+                DCacheInvalidateLine(line);
+            }
+        }
+        return;
+    case 0x7E2:
+        DCacheClean((((val >> 5) & 0x1F) << 2) | (val >> 30));
+        DCacheInvalidateLine((((val >> 5) & 0x1F) << 2) | (val >> 30));
         return;
 
 
@@ -648,8 +973,8 @@ u32 ARMv5::CP15Read(u32 id)
 }
 
 
-// TCM are handled here.
-// TODO: later on, handle PU, and maybe caches
+// TCM are handled here, the data cache too if it's enabled.
+// TODO: later on, handle PU permissions
 
 u32 ARMv5::CodeRead32(u32 addr, bool branch)
 {
@@ -660,14 +985,16 @@ u32 ARMv5::CodeRead32(u32 addr, bool branch)
     }
 
     CodeCycles = RegionCodeCycles;
-    if (CodeCycles == 0xFF) // cached memory. hax
+    if (CodeCycles == 0xFF) // cached memory
     {
-        if (branch || !(addr & 0x1F))
-            CodeCycles = kCodeCacheTiming;//ICacheLookup(addr);
+        // sequential fetches within a line come from the line that was
+        // last looked up. the ARMJIT does the same
+        if (branch || !(addr & 0x1F) || !CurICacheLine)
+            ICacheLookup(addr);
         else
             CodeCycles = 1;
 
-        //return *(u32*)&CurICacheLine[addr & 0x1C];
+        return *(u32*)&CurICacheLine[addr & 0x1C];
     }
 
     if (CodeMem.Mem) return *(u32*)&CodeMem.Mem[addr & CodeMem.Mask];
@@ -678,166 +1005,314 @@ u32 ARMv5::CodeRead32(u32 addr, bool branch)
 
 void ARMv5::DataRead8(u32 addr, u32* val)
 {
-    if (addr < ITCMSize)
-    {
-        DataCycles = 1;
-        *val = *(u8*)&ITCM[addr & 0x7FFF];
-        return;
-    }
-    if (addr >= DTCMBase && addr < (DTCMBase + DTCMSize))
+    MemBlock& block = MemBlocks[addr >> 12];
+    u32 unit = (addr >> 9) & 0x7;
+
+    if (unit < block.TCMEnd)
     {
         DataCycles = 1;
-        *val = *(u8*)&DTCM[(addr - DTCMBase) & 0x3FFF];
+        if (unit < block.ITCMEnd)
+            *val = *(u8*)&ITCM[addr & 0x7FFF];
+        else
+            *val = *(u8*)&DTCM[(addr - DTCMBase) & 0x3FFF];
         return;
     }
 
-    *val = NDS::ARM9Read8(addr);
-    DataCycles = MemTimings[addr >> 12][1];
+    if (block.Mem) *val = *(u8*)&block.Mem[addr & 0xFFF];
+    else           *val = NDS::ARM9Read8(addr);
+    DataCycles = block.Timings[1];
+    if (!DataCycles) DataCycles = DCacheRead(addr, 0);
 }
 
 void ARMv5::DataRead16(u32 addr, u32* val)
 {
     addr &= ~1;
 
-    if (addr < ITCMSize)
-    {
-        DataCycles = 1;
-        *val = *(u16*)&ITCM[addr & 0x7FFF];
-        return;
-    }
-    if (addr >= DTCMBase && addr < (DTCMBase + DTCMSize))
+    MemBlock& block = MemBlocks[addr >> 12];
+    u32 unit = (addr >> 9) & 0x7;
+
+    if (unit < block.TCMEnd)
     {
         DataCycles = 1;
-        *val = *(u16*)&DTCM[(addr - DTCMBase) & 0x3FFF];
+        if (unit < block.ITCMEnd)
+            *val = *(u16*)&ITCM[addr & 0x7FFF];
+        else
+            *val = *(u16*)&DTCM[(addr - DTCMBase) & 0x3FFF];
         return;
     }
 
-    *val = NDS::ARM9Read16(addr);
-    DataCycles = MemTimings[addr >> 12][1];
+    if (block.Mem) *val = *(u16*)&block.Mem[addr & 0xFFF];
+    else           *val = NDS::ARM9Read16(addr);
+    DataCycles = block.Timings[1];
+    if (!DataCycles) DataCycles = DCacheRead(addr, 0);
 }
 
 void ARMv5::DataRead32(u32 addr, u32* val)
 {
     addr &= ~3;
 
-    if (addr < ITCMSize)
-    {
-        DataCycles = 1;
-        *val = *(u32*)&ITCM[addr & 0x7FFF];
-        return;
-    }
-    if (addr >= DTCMBase && addr < (DTCMBase + DTCMSize))
+    MemBlock& block = MemBlocks[addr >> 12];
+    u32 unit = (addr >> 9) & 0x7;
+
+    if (unit < block.TCMEnd)
     {
         DataCycles = 1;
-        *val = *(u32*)&DTCM[(addr - DTCMBase) & 0x3FFF];
+        if (unit < block.ITCMEnd)
+            *val = *(u32*)&ITCM[addr & 0x7FFF];
+        else
+            *val = *(u32*)&DTCM[(addr - DTCMBase) & 0x3FFF];
         return;
     }
 
-    *val = NDS::ARM9Read32(addr);
-    DataCycles = MemTimings[addr >> 12][2];
+    if (block.Mem) *val = *(u32*)&block.Mem[addr & 0xFFF];
+    else           *val = NDS::ARM9Read32(addr);
+    DataCycles = block.Timings[2];
+    if (!DataCycles) DataCycles = DCacheRead(addr, 0);
 }
 
 void ARMv5::DataRead32S(u32 addr, u32* val)
 {
     addr &= ~3;
 
-    if (addr < ITCMSize)
-    {
-        DataCycles += 1;
-        *val = *(u32*)&ITCM[addr & 0x7FFF];
-        return;
-    }
-    if (addr >= DTCMBase && addr < (DTCMBase + DTCMSize))
+    MemBlock& block = MemBlocks[addr >> 12];
+    u32 unit = (addr >> 9) & 0x7;
+
+    if (unit < block.TCMEnd)
     {
         DataCycles += 1;
-        *val = *(u32*)&DTCM[(addr - DTCMBase) & 0x3FFF];
+        if (unit < block.ITCMEnd)
+            *val = *(u32*)&ITCM[addr & 0x7FFF];
+        else
+            *val = *(u32*)&DTCM[(addr - DTCMBase) & 0x3FFF];
         return;
     }
 
-    *val = NDS::ARM9Read32(addr);
-    DataCycles += MemTimings[addr >> 12][3];
+    if (block.Mem) *val = *(u32*)&block.Mem[addr & 0xFFF];
+    else           *val = NDS::ARM9Read32(addr);
+    s32 cycles = block.Timings[3];
+    if (!cycles) cycles = DCacheRead(addr, DataCycles);
+    DataCycles += cycles;
 }
 
 void ARMv5::DataWrite8(u32 addr, u8 val)
 {
-    if (addr < ITCMSize)
+    MemBlock& block = MemBlocks[addr >> 12];
+    u32 unit = (addr >> 9) & 0x7;
+
+    if (unit < block.TCMEnd)
     {
         DataCycles = 1;
-        *(u8*)&ITCM[addr & 0x7FFF] = val;
+        if (unit < block.ITCMEnd)
+        {
+            *(u8*)&ITCM[addr & 0x7FFF] = val;
+            ARMJIT::InvalidateITCMIfNecessary(addr);
+        }
+        else
+            *(u8*)&DTCM[(addr - DTCMBase) & 0x3FFF] = val;
         return;
     }
-    if (addr >= DTCMBase && addr < (DTCMBase + DTCMSize))
+
+    if (block.MemWrite)
     {
-        DataCycles = 1;
-        *(u8*)&DTCM[(addr - DTCMBase) & 0x3FFF] = val;
-        return;
+        *(u8*)&block.Mem[addr & 0xFFF] = val;
+        ARMJIT::InvalidateMainRAMIfNecessary(addr);
     }
-
-    NDS::ARM9Write8(addr, val);
-    DataCycles = MemTimings[addr >> 12][1];
+    else
+        NDS::ARM9Write8(addr, val);
+    DataCycles = block.Timings[1];
+    if (!DataCycles) DataCycles = DCacheWrite(addr, NDS::ARM9MemTimings[addr >> 14][0] << NDS::ARM9ClockShift, 0);
 }
 
 void ARMv5::DataWrite16(u32 addr, u16 val)
 {
     addr &= ~1;
 
-    if (addr < ITCMSize)
+    MemBlock& block = MemBlocks[addr >> 12];
+    u32 unit = (addr >> 9) & 0x7;
+
+    if (unit < block.TCMEnd)
     {
         DataCycles = 1;
-        *(u16*)&ITCM[addr & 0x7FFF] = val;
+        if (unit < block.ITCMEnd)
+        {
+            *(u16*)&ITCM[addr & 0x7FFF] = val;
+            ARMJIT::InvalidateITCMIfNecessary(addr);
+        }
+        else
+            *(u16*)&DTCM[(addr - DTCMBase) & 0x3FFF] = val;
         return;
     }
-    if (addr >= DTCMBase && addr < (DTCMBase + DTCMSize))
+
+    if (block.MemWrite)
     {
-        DataCycles = 1;
-        *(u16*)&DTCM[(addr - DTCMBase) & 0x3FFF] = val;
-        return;
+        *(u16*)&block.Mem[addr & 0xFFF] = val;
+        ARMJIT::InvalidateMainRAMIfNecessary(addr);
     }
-
-    NDS::ARM9Write16(addr, val);
-    DataCycles = MemTimings[addr >> 12][1];
+    else
+        NDS::ARM9Write16(addr, val);
+    DataCycles = block.Timings[1];
+    if (!DataCycles) DataCycles = DCacheWrite(addr, NDS::ARM9MemTimings[addr >> 14][0] << NDS::ARM9ClockShift, 0);
 }
 
 void ARMv5::DataWrite32(u32 addr, u32 val)
 {
     addr &= ~3;
 
-    if (addr < ITCMSize)
+    MemBlock& block = MemBlocks[addr >> 12];
+    u32 unit = (addr >> 9) & 0x7;
+
+    if (unit < block.TCMEnd)
     {
         DataCycles = 1;
-        *(u32*)&ITCM[addr & 0x7FFF] = val;
+        if (unit < block.ITCMEnd)
+        {
+            *(u32*)&ITCM[addr & 0x7FFF] = val;
+            ARMJIT::InvalidateITCMIfNecessary(addr);
+        }
+        else
+            *(u32*)&DTCM[(addr - DTCMBase) & 0x3FFF] = val;
         return;
     }
-    if (addr >= DTCMBase && addr < (DTCMBase + DTCMSize))
+
+    if (block.MemWrite)
     {
-        DataCycles = 1;
-        *(u32*)&DTCM[(addr - DTCMBase) & 0x3FFF] = val;
-        return;
+        *(u32*)&block.Mem[addr & 0xFFF] = val;
+        ARMJIT::InvalidateMainRAMIfNecessary(addr);
     }
-
-    NDS::ARM9Write32(addr, val);
-    DataCycles = MemTimings[addr >> 12][2];
+    else
+        NDS::ARM9Write32(addr, val);
+    DataCycles = block.Timings[2];
+    if (!DataCycles) DataCycles = DCacheWrite(addr, NDS::ARM9MemTimings[addr >> 14][2] << NDS::ARM9ClockShift, 0);
 }
 
 void ARMv5::DataWrite32S(u32 addr, u32 val)
 {
     addr &= ~3;
 
-    if (addr < ITCMSize)
+    MemBlock& block = MemBlocks[addr >> 12];
+    u32 unit = (addr >> 9) & 0x7;
+
+    if (unit < block.TCMEnd)
     {
         DataCycles += 1;
-        *(u32*)&ITCM[addr & 0x7FFF] = val;
+        if (unit < block.ITCMEnd)
+        {
+            *(u32*)&ITCM[addr & 0x7FFF] = val;
+            ARMJIT::InvalidateITCMIfNecessary(addr);
+        }
+        else
+            *(u32*)&DTCM[(addr - DTCMBase) & 0x3FFF] = val;
         return;
     }
-    if (addr >= DTCMBase && addr < (DTCMBase + DTCMSize))
+
+    if (block.MemWrite)
     {
-        DataCycles += 1;
-        *(u32*)&DTCM[(addr - DTCMBase) & 0x3FFF] = val;
+        *(u32*)&block.Mem[addr & 0xFFF] = val;
+        ARMJIT::InvalidateMainRAMIfNecessary(addr);
+    }
+    else
+        NDS::ARM9Write32(addr, val);
+    s32 cycles = block.Timings[3];
+    if (!cycles) cycles = DCacheWrite(addr, NDS::ARM9MemTimings[addr >> 14][3] << NDS::ARM9ClockShift, DataCycles);
+    DataCycles += cycles;
+}
+
+// multiple word transfers that stay within one 4KB block of plain memory
+// all have the same timings, and can be done in one go. this gives the
+// exact same result as going through DataRead32()/DataRead32S()
+u8* ARMv5::GetMultiplePtr(u32 addr, u32 num, bool write)
+{
+    u32 len = num << 2;
+    u32 end = addr + len - 1;
+    if ((addr >> 12) != (end >> 12))
+        return NULL;
+
+    // TCM goes from the start of the block, so if the first word isn't in
+    // there, none of them are
+    MemBlock& block = MemBlocks[addr >> 12];
+    u32 unit = (addr >> 9) & 0x7;
+    u32 endunit = (end >> 9) & 0x7;
+
+    if (unit < block.ITCMEnd)
+    {
+        if (endunit >= block.ITCMEnd) return NULL;
+        DataCycles = num;
+        return &ITCM[addr & 0x7FFF];
+    }
+    if (unit < block.TCMEnd)
+    {
+        if (endunit >= block.TCMEnd) return NULL;
+        DataCycles = num;
+        return &DTCM[(addr - DTCMBase) & 0x3FFF];
+    }
+
+    // writes only go straight to main RAM and shared WRAM, everything else
+    // may need more than just storing the value
+    if (addr >= 0x10000000) return NULL;
+    if (write && (addr & 0xFE000000) != 0x02000000) return NULL;
+
+    // the data cache takes it one word at a time
+    if (!block.Timings[2])
+        return NULL;
+
+    NDS::MemPage& page = NDS::ARM9ReadMap[addr >> 14];
+    if (!page.Mem || ((addr & page.Mask) + len - 1) > page.Mask)
+        return NULL;
+
+    DataCycles = block.Timings[2] + (num - 1) * block.Timings[3];
+    return &page.Mem[addr & page.Mask];
+}
+
+void ARMv5::DataRead32Multiple(u32 addr, u32* vals, u32 num)
+{
+    addr &= ~3;
+
+    u8* mem = GetMultiplePtr(addr, num, false);
+    if (mem)
+    {
+        memcpy(vals, mem, num << 2);
+        return;
+    }
+
+    DataRead32(addr, &vals[0]);
+    for (u32 i = 1; i < num; i++)
+        DataRead32S(addr + (i << 2), &vals[i]);
+}
+
+void ARMv5::DataWrite32Multiple(u32 addr, u32* vals, u32 num)
+{
+    addr &= ~3;
+
+    u8* mem = GetMultiplePtr(addr, num, true);
+    if (mem)
+    {
+        memcpy(mem, vals, num << 2);
+
+        if (mem >= ITCM && mem < &ITCM[0x8000])
+        {
+            for (u32 i = 0; i < num; i++)
+                ARMJIT::InvalidateITCMIfNecessary(addr + (i << 2));
+        }
+        else if (mem >= DTCM && mem < &DTCM[0x4000])
+        {
+            // nothing to invalidate there
+        }
+        else if ((addr & 0xFF000000) == 0x02000000)
+        {
+            for (u32 i = 0; i < num; i++)
+                ARMJIT::InvalidateMainRAMIfNecessary(addr + (i << 2));
+        }
+        else
+        {
+            for (u32 i = 0; i < num; i++)
+                ARMJIT::InvalidateSWRAMIfNecessary((mem - NDS::SharedWRAM) + (i << 2));
+        }
         return;
     }
 
-    NDS::ARM9Write32(addr, val);
-    DataCycles += MemTimings[addr >> 12][3];
+    DataWrite32(addr, vals[0]);
+    for (u32 i = 1; i < num; i++)
+        DataWrite32S(addr + (i << 2), vals[i]);
 }
 
 void ARMv5::GetCodeMemRegion(u32 addr, NDS::MemRegion* region)
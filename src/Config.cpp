@@ -52,6 +52,27 @@ int LimitFPS;
 int DirectBoot;
 
 int Threaded3D;
+int Threaded2D;
+int Deferred2D;
+
+int JIT_Enable;
+int JIT_EnableARM7;
+int JIT_BlockSize;
+int JIT_Cached;
+int JIT_FastMem;
+
+int IdleLoopSkip;
+char IdleLoopTitles[256];
+
+int DataCacheModel;
+
+int ThreadedARM7;
+int ARM7SkewCycles;
+
+int FrameProfiling;
+char FrameProfilingCSV[512];
+
+int RunAhead;
 
 int SocketBindAnyAddr;
 
@@ -126,6 +147,27 @@ ConfigEntry ConfigFile[] =
     {"DirectBoot", 0, &DirectBoot, 1, NULL, 0},
 
     {"Threaded3D", 0, &Threaded3D, 1, NULL, 0},
+    {"Threaded2D", 0, &Threaded2D, 0, NULL, 0},
+    {"Deferred2D", 0, &Deferred2D, 0, NULL, 0},
+
+    {"JIT_Enable", 0, &JIT_Enable, 0, NULL, 0},
+    {"JIT_EnableARM7", 0, &JIT_EnableARM7, 0, NULL, 0},
+    {"JIT_BlockSize", 0, &JIT_BlockSize, 32, NULL, 0},
+    {"JIT_Cached", 0, &JIT_Cached, 0, NULL, 0},
+    {"JIT_FastMem", 0, &JIT_FastMem, 1, NULL, 0},
+
+    {"IdleLoopSkip", 0, &IdleLoopSkip, 1, NULL, 0},
+    {"IdleLoopTitles", 1, IdleLoopTitles, 0, "", 255},
+
+    {"DataCacheModel", 0, &DataCacheModel, 0, NULL, 0},
+
+    {"ThreadedARM7", 0, &ThreadedARM7, 0, NULL, 0},
+    {"ARM7SkewCycles", 0, &ARM7SkewCycles, 256, NULL, 0},
+
+    {"FrameProfiling", 0, &FrameProfiling, 0, NULL, 0},
+    {"FrameProfCSV", 1, FrameProfilingCSV, 0, "", 511},
+
+    {"RunAhead", 0, &RunAhead, 0, NULL, 0},
 
     {"SockBindAnyAddr", 0, &SocketBindAnyAddr, 0, NULL, 0},
 
@@ -58,6 +58,38 @@ extern int LimitFPS;
 extern int DirectBoot;
 
 extern int Threaded3D;
+extern int Threaded2D; // draw 2D engine B on its own thread
+extern int Deferred2D; // draw 2D scanlines on another thread, whenever it gets to them
+
+extern int JIT_Enable;
+extern int JIT_EnableARM7;
+extern int JIT_BlockSize;
+extern int JIT_Cached;
+extern int JIT_FastMem;
+
+// 0=never, 1=only for games listed in IdleLoopTitles, 2=always
+extern int IdleLoopSkip;
+extern char IdleLoopTitles[256];
+
+// ARM9 data cache and write buffer timings instead of a fixed average.
+// applies on reset
+extern int DataCacheModel;
+
+// run the ARM7 on its own thread, up to ARM7SkewCycles ahead of or behind
+// the ARM9. 0=off, 1=on, 2=on and check each frame against a single-threaded
+// run of it. only used with the JIT off
+extern int ThreadedARM7;
+extern int ARM7SkewCycles;
+
+// measure host time spent in each part of NDS::RunFrame() (see NDS::FrameStats)
+extern int FrameProfiling;
+// if set, the frontend writes the stats for every frame there
+extern char FrameProfilingCSV[512];
+
+// frontend: after each frame, emulate this many more with the same input,
+// show the last one and go back. hides input lag at the cost of running
+// that many frames more
+extern int RunAhead;
 
 extern int SocketBindAnyAddr;
 
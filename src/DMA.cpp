@@ -17,16 +17,19 @@
 */
 
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
 #include "NDS.h"
 #include "DMA.h"
+#include "ARMJIT.h"
 #include "NDSCart.h"
 #include "GPU.h"
 
 
 // NOTES ON DMA SHIT
 //
-// * could use optimized code paths for common types of DMA transfers. for example, VRAM
-//   have to profile it to see if it's actually worth doing
+// * transfers between plain memory (RAM, WRAM, VRAM, palette, OAM) that go up on both sides
+//   are done in bulk, see BulkCopy()
 
 
 // DMA TIMINGS
@@ -195,6 +198,96 @@ void DMA::Run()
     else          return Run7();
 }
 
+// transfers between plain memory that go up on both sides can be done with
+// one memmove, as long as both sides stay within one page of the read maps
+// and we don't go past the target. unitcycles is the same for every unit,
+// so the timings come out the same as going one unit at a time
+bool DMA::BulkCopy(u32 unitshift, s32 unitcycles)
+{
+    if (SrcAddrInc != 1 || DstAddrInc != 1)
+        return false;
+    if (CurSrcAddr >= 0x10000000 || CurDstAddr >= 0x10000000)
+        return false;
+
+    // the read maps only have memory that can also be written to directly
+    NDS::MemPage* map = CPU ? NDS::ARM7ReadMap : NDS::ARM9ReadMap;
+    NDS::MemPage& srcpage = map[CurSrcAddr >> 14];
+    NDS::MemPage& dstpage = map[CurDstAddr >> 14];
+    if (!srcpage.Mem || !dstpage.Mem)
+        return false;
+
+    u32 srcoffset = CurSrcAddr & srcpage.Mask;
+    u32 dstoffset = CurDstAddr & dstpage.Mask;
+
+    u32 num = IterCount;
+    num = std::min(num, (srcpage.Mask + 1 - srcoffset) >> unitshift);
+    num = std::min(num, (dstpage.Mask + 1 - dstoffset) >> unitshift);
+
+    // the unit that reaches the target is still done
+    u64 timestamp = CPU ? NDS::ARM7Timestamp : NDS::ARM9Timestamp;
+    u64 target = CPU ? NDS::ARM7Target : NDS::ARM9Target;
+    u64 step = CPU ? unitcycles : (unitcycles << NDS::ARM9ClockShift);
+    u64 fit = (target - timestamp + step - 1) / step;
+    if (fit < num) num = fit;
+
+    if (num < 2)
+        return false;
+
+    u32 len = num << unitshift;
+    u8* src = &srcpage.Mem[srcoffset];
+    u8* dst = &dstpage.Mem[dstoffset];
+
+    // one unit at a time, a destination right above the source would keep
+    // reading back what was just written
+    if (dst > src && dst < (src + len))
+        return false;
+
+    // palette, VRAM, OAM
+    if (!CPU && (CurDstAddr >> 24) >= 0x05 && (CurDstAddr >> 24) <= 0x07)
+        GPU::Sync2D();
+    // shared WRAM, see NDS::SyncARM7()
+    if (!CPU && (CurDstAddr >> 24) == 0x03)
+        NDS::SyncARM7();
+
+    memmove(dst, src, len);
+
+    if (dst >= NDS::MainRAM && dst < &NDS::MainRAM[MAIN_RAM_SIZE])
+    {
+        for (u32 i = 0; i < len; i += (1<<unitshift))
+            ARMJIT::InvalidateMainRAMIfNecessary((dst - NDS::MainRAM) + i);
+    }
+    else if (dst >= NDS::SharedWRAM && dst < &NDS::SharedWRAM[0x8000])
+    {
+        for (u32 i = 0; i < len; i += (1<<unitshift))
+            ARMJIT::InvalidateSWRAMIfNecessary((dst - NDS::SharedWRAM) + i);
+    }
+    else if (dst >= NDS::ARM7WRAM && dst < &NDS::ARM7WRAM[0x10000])
+    {
+        for (u32 i = 0; i < len; i += (1<<unitshift))
+            ARMJIT::InvalidateARM7WRAMIfNecessary((dst - NDS::ARM7WRAM) + i);
+    }
+    else if (!CPU && (CurDstAddr >> 24) == 0x06)
+    {
+        // never goes past one page
+        GPU::SetVRAMDirty(CurDstAddr);
+    }
+    else if (!CPU && (CurDstAddr >> 24) == 0x07)
+    {
+        GPU::OAMDirty[0] = true;
+        GPU::OAMDirty[1] = true;
+    }
+
+    if (CPU) NDS::ARM7Timestamp += step * num;
+    else     NDS::ARM9Timestamp += step * num;
+
+    CurSrcAddr += len;
+    CurDstAddr += len;
+    IterCount -= num;
+    RemCount -= num;
+
+    return true;
+}
+
 void DMA::Run9()
 {
     if (NDS::ARM9Timestamp >= NDS::ARM9Target) return;
@@ -230,6 +323,12 @@ void DMA::Run9()
 
         while (IterCount > 0 && !Stall)
         {
+            if (BulkCopy(1, unitcycles))
+            {
+                if (NDS::ARM9Timestamp >= NDS::ARM9Target) break;
+                continue;
+            }
+
             NDS::ARM9Timestamp += (unitcycles << NDS::ARM9ClockShift);
 
             NDS::ARM9Write16(CurDstAddr, NDS::ARM9Read16(CurSrcAddr));
@@ -266,6 +365,12 @@ void DMA::Run9()
 
         while (IterCount > 0 && !Stall)
         {
+            if (BulkCopy(2, unitcycles))
+            {
+                if (NDS::ARM9Timestamp >= NDS::ARM9Target) break;
+                continue;
+            }
+
             NDS::ARM9Timestamp += (unitcycles << NDS::ARM9ClockShift);
 
             NDS::ARM9Write32(CurDstAddr, NDS::ARM9Read32(CurSrcAddr));
@@ -342,6 +447,12 @@ void DMA::Run7()
 
         while (IterCount > 0 && !Stall)
         {
+            if (BulkCopy(1, unitcycles))
+            {
+                if (NDS::ARM7Timestamp >= NDS::ARM7Target) break;
+                continue;
+            }
+
             NDS::ARM7Timestamp += unitcycles;
 
             NDS::ARM7Write16(CurDstAddr, NDS::ARM7Read16(CurSrcAddr));
@@ -378,6 +489,12 @@ void DMA::Run7()
 
         while (IterCount > 0 && !Stall)
         {
+            if (BulkCopy(2, unitcycles))
+            {
+                if (NDS::ARM7Timestamp >= NDS::ARM7Target) break;
+                continue;
+            }
+
             NDS::ARM7Timestamp += unitcycles;
 
             NDS::ARM7Write32(CurDstAddr, NDS::ARM7Read32(CurSrcAddr));
@@ -0,0 +1,335 @@
+/*
+    Copyright 2016-2019 StapleButter
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NDS.h"
+#include "GPU.h"
+#include "FastMem.h"
+
+#ifdef __linux__
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#endif
+
+
+namespace FastMem
+{
+
+u8* Base[2];
+
+u8* (*FaultHandler)(u8* pc);
+
+void SetFaultHandler(u8* (*handler)(u8* pc))
+{
+    FaultHandler = handler;
+}
+
+#ifdef __linux__
+
+const u64 kViewSize = 0x100000000ULL;
+
+// the emulator's memory, moved into a shared memory file so that it can be
+// mapped several times
+struct Backing
+{
+    u8* Mem;
+    u32 Size;
+    u32 Offset;
+};
+
+Backing Backings[12];
+int NumBackings;
+int MemFD = -1;
+
+// what each 16KB page of 0x00000000-0x0FFFFFFF is mapped to in each view,
+// as an offset into the file. -1 if nothing
+s32 Mapped[2][0x4000];
+
+struct sigaction OldSegv;
+
+
+void SignalHandler(int sig, siginfo_t* info, void* rawctx)
+{
+    u8* addr = (u8*)info->si_addr;
+    bool ours = false;
+    for (int i = 0; i < 2; i++)
+    {
+        if (Base[i] && addr >= Base[i] && addr < Base[i] + kViewSize)
+            ours = true;
+    }
+
+#if defined(__x86_64__)
+    if (ours && FaultHandler)
+    {
+        ucontext_t* ctx = (ucontext_t*)rawctx;
+        u8* resume = FaultHandler((u8*)ctx->uc_mcontext.gregs[REG_RIP]);
+        if (resume)
+        {
+            ctx->uc_mcontext.gregs[REG_RIP] = (greg_t)resume;
+            return;
+        }
+    }
+#endif
+
+    // not something we can do anything about, let whoever was there before
+    // have it. if that's nobody, go back to the default and let the access
+    // fault again so it crashes like it would have
+    if (OldSegv.sa_flags & SA_SIGINFO)
+    {
+        OldSegv.sa_sigaction(sig, info, rawctx);
+    }
+    else if (OldSegv.sa_handler != SIG_DFL && OldSegv.sa_handler != SIG_IGN)
+    {
+        OldSegv.sa_handler(sig);
+    }
+    else
+    {
+        signal(SIGSEGV, SIG_DFL);
+    }
+}
+
+
+void AddBacking(u8* mem, u32 size)
+{
+    Backing& b = Backings[NumBackings++];
+    b.Mem = mem;
+    b.Size = size;
+    b.Offset = NumBackings > 1 ? (Backings[NumBackings-2].Offset + Backings[NumBackings-2].Size) : 0;
+}
+
+// puts a copy of what's at mem in place of it, from the file or from fresh
+// anonymous memory if fd is -1. if it fails, mem is left as it was
+bool Rebind(u8* mem, u32 size, int fd, u32 offset)
+{
+    void* copy;
+    if (fd >= 0)
+        copy = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+    else
+        copy = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (copy == MAP_FAILED)
+        return false;
+
+    memcpy(copy, mem, size);
+    if (mremap(copy, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, mem) == MAP_FAILED)
+    {
+        munmap(copy, size);
+        return false;
+    }
+
+    return true;
+}
+
+// moves the first num backings back out of the file
+void Unbind(int num)
+{
+    for (int i = 0; i < num; i++)
+    {
+        // if this fails, the memory just stays mapped from the file
+        if (!Rebind(Backings[i].Mem, Backings[i].Size, -1, 0))
+            printf("FastMem: couldn't move memory out of the shared file\n");
+    }
+}
+
+bool Init()
+{
+    if (Base[0]) return true;
+
+    NumBackings = 0;
+    AddBacking(NDS::MainRAM, MAIN_RAM_SIZE);
+    AddBacking(NDS::SharedWRAM, 0x8000);
+    AddBacking(NDS::ARM7WRAM, 0x10000);
+    AddBacking(GPU::VRAM_A, 128*1024);
+    AddBacking(GPU::VRAM_B, 128*1024);
+    AddBacking(GPU::VRAM_C, 128*1024);
+    AddBacking(GPU::VRAM_D, 128*1024);
+    AddBacking(GPU::VRAM_E,  64*1024);
+    AddBacking(GPU::VRAM_F,  16*1024);
+    AddBacking(GPU::VRAM_G,  16*1024);
+    AddBacking(GPU::VRAM_H,  32*1024);
+    AddBacking(GPU::VRAM_I,  16*1024);
+
+    u32 pagesize = sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < NumBackings; i++)
+    {
+        if (((u64)Backings[i].Mem & (pagesize-1)) || (Backings[i].Size & (pagesize-1)))
+        {
+            printf("FastMem: memory isn't page aligned, not using it\n");
+            return false;
+        }
+    }
+
+    u32 totalsize = Backings[NumBackings-1].Offset + Backings[NumBackings-1].Size;
+
+    MemFD = syscall(SYS_memfd_create, "melonDS", 0);
+    if (MemFD < 0 || ftruncate(MemFD, totalsize))
+    {
+        printf("FastMem: couldn't create the shared memory\n");
+        if (MemFD >= 0) close(MemFD);
+        MemFD = -1;
+        return false;
+    }
+
+    // move the emulator's memory into the file
+    for (int i = 0; i < NumBackings; i++)
+    {
+        Backing& b = Backings[i];
+        if (!Rebind(b.Mem, b.Size, MemFD, b.Offset))
+        {
+            printf("FastMem: couldn't move memory into the shared file\n");
+            Unbind(i);
+            close(MemFD);
+            MemFD = -1;
+            return false;
+        }
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        void* view = mmap(NULL, kViewSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (view == MAP_FAILED)
+        {
+            printf("FastMem: couldn't reserve address space\n");
+            DeInit();
+            return false;
+        }
+
+        Base[i] = (u8*)view;
+        for (int j = 0; j < 0x4000; j++)
+            Mapped[i][j] = -1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = SignalHandler;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, &OldSegv);
+
+    RemapPages(0, 0x10000000);
+    return true;
+}
+
+void DeInit()
+{
+    if (Base[0] && Base[1])
+        sigaction(SIGSEGV, &OldSegv, NULL);
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (Base[i]) munmap(Base[i], kViewSize);
+        Base[i] = NULL;
+    }
+
+    if (MemFD >= 0)
+    {
+        Unbind(NumBackings);
+        close(MemFD);
+        MemFD = -1;
+    }
+}
+
+s32 GetFileOffset(NDS::MemPage& page)
+{
+    // the mirror can't do anything smaller than a page, so no palette/OAM
+    if (!page.Mem || page.Mask != 0x3FFF)
+        return -1;
+
+    for (int i = 0; i < NumBackings; i++)
+    {
+        Backing& b = Backings[i];
+        if (page.Mem >= b.Mem && page.Mem < (b.Mem + b.Size))
+            return b.Offset + (page.Mem - b.Mem);
+    }
+
+    return -1;
+}
+
+void MapRange(int num, u32 start, u32 numpages, s32 offset)
+{
+    u8* ptr = Base[num] + (start << 14);
+    u32 size = numpages << 14;
+
+    void* ret;
+    if (offset < 0)
+        ret = mmap(ptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    else
+        ret = mmap(ptr, size, PROT_READ, MAP_SHARED | MAP_FIXED, MemFD, offset);
+
+    if (ret == MAP_FAILED)
+    {
+        printf("FastMem: mapping %08X failed\n", start << 14);
+        abort();
+    }
+}
+
+void RemapPages(u32 start, u32 end)
+{
+    if (!Base[0]) return;
+
+    for (int num = 0; num < 2; num++)
+    {
+        NDS::MemPage* map = num ? NDS::ARM7ReadMap : NDS::ARM9ReadMap;
+        s32* mapped = Mapped[num];
+
+        // only touch what changed, in as few calls as possible
+        u32 i = start >> 14;
+        while (i < (end >> 14))
+        {
+            s32 offset = GetFileOffset(map[i]);
+            if (offset == mapped[i])
+            {
+                i++;
+                continue;
+            }
+
+            u32 first = i;
+            mapped[i++] = offset;
+            while (i < (end >> 14))
+            {
+                s32 next = GetFileOffset(map[i]);
+                if (next == mapped[i]) break;
+                if (offset < 0 ? (next >= 0) : (next != offset + (s32)((i - first) << 14))) break;
+
+                mapped[i++] = next;
+            }
+
+            MapRange(num, first, i - first, offset);
+        }
+    }
+}
+
+#else
+
+bool Init()
+{
+    Base[0] = NULL;
+    Base[1] = NULL;
+    return false;
+}
+
+void DeInit() {}
+void RemapPages(u32 start, u32 end) {}
+
+#endif
+
+}
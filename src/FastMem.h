@@ -0,0 +1,57 @@
+/*
+    Copyright 2016-2019 StapleButter
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef FASTMEM_H
+#define FASTMEM_H
+
+#include "types.h"
+
+// host virtual memory mirror of the CPU address spaces
+//
+// each CPU gets a 4GB reservation, in which every page that reads plain
+// memory (main RAM, WRAM, VRAM with one bank mapped) is mapped read-only at
+// its DS address, mirrors included. a load from anywhere is then just
+// Base[cpu] + addr. the rest (I/O, palette/OAM, unmapped) stays inaccessible
+// and faults, which is how code using the mirror finds out it needs to take
+// the slow path.
+//
+// only set up while the JIT is on and allowed to use it (NDS::RunFrame
+// takes care of that). only works on Linux for now, elsewhere Base stays
+// NULL.
+
+namespace FastMem
+{
+
+extern u8* Base[2];
+
+// moves the emulator's memory into a shared file and builds the mirrors,
+// or moves it back out. both can be called any time between frames
+bool Init();
+void DeInit();
+
+// follows NDS::ARM9ReadMap/ARM7ReadMap, called after they're updated
+void RemapPages(u32 start, u32 end);
+
+// called when something faults inside the mirrors, with the faulting
+// instruction. returns where to resume execution, or NULL if it isn't
+// an access that's prepared for it
+void SetFaultHandler(u8* (*handler)(u8* pc));
+
+}
+
+#endif // FASTMEM_H
@@ -18,8 +18,11 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <atomic>
+#include "Config.h"
 #include "NDS.h"
 #include "GPU.h"
+#include "Platform.h"
 
 
 namespace GPU
@@ -40,15 +43,16 @@ u16 DispStat[2], VMatch[2];
 u8 Palette[2*1024];
 u8 OAM[2*1024];
 
-u8 VRAM_A[128*1024];
-u8 VRAM_B[128*1024];
-u8 VRAM_C[128*1024];
-u8 VRAM_D[128*1024];
-u8 VRAM_E[ 64*1024];
-u8 VRAM_F[ 16*1024];
-u8 VRAM_G[ 16*1024];
-u8 VRAM_H[ 32*1024];
-u8 VRAM_I[ 16*1024];
+// page aligned for fastmem
+alignas(0x1000) u8 VRAM_A[128*1024];
+alignas(0x1000) u8 VRAM_B[128*1024];
+alignas(0x1000) u8 VRAM_C[128*1024];
+alignas(0x1000) u8 VRAM_D[128*1024];
+alignas(0x1000) u8 VRAM_E[ 64*1024];
+alignas(0x1000) u8 VRAM_F[ 16*1024];
+alignas(0x1000) u8 VRAM_G[ 16*1024];
+alignas(0x1000) u8 VRAM_H[ 32*1024];
+alignas(0x1000) u8 VRAM_I[ 16*1024];
 u8* VRAM[9] = {VRAM_A, VRAM_B, VRAM_C, VRAM_D, VRAM_E, VRAM_F, VRAM_G, VRAM_H, VRAM_I};
 
 u8 VRAMCNT[9];
@@ -71,11 +75,63 @@ u32 VRAMMap_TexPal[8];
 
 u32 VRAMMap_ARM7[2];
 
+u32 VRAMDirty_ABG;
+u32 VRAMDirty_BBG;
+bool OAMDirty[2];
+u32 LastVRAMMap_ABG[0x20];
+u32 LastVRAMMap_BBG[0x8];
+
 u32 Framebuffer[256*192*2];
 
 GPU2D* GPU2D_A;
 GPU2D* GPU2D_B;
 
+// 2D thread
+//
+// with Config::Threaded2D, engine B draws its scanlines on another thread
+// while engine A draws them on this one. StartHBlank() waits for both to be
+// done before going on, so they see the same registers and memory as when
+// drawing one after the other, mid-frame writes included. they share nothing
+// they write to: display capture only goes to LCDC banks, which engine B
+// can't see.
+// lines come way too often to wait on a semaphore for each of them, so the
+// thread only sleeps on it outside of the visible lines.
+//
+// deferred 2D rendering
+//
+// with Config::Deferred2D, the engines don't draw their scanlines when they
+// come. they latch everything a line depends on from them into a log (see
+// GPU2D::LatchScanline()), and the 2D thread draws the logged lines on a
+// second pair of engines, as far behind as it likes. what isn't latched is
+// memory: anything about to change VRAM, palette or OAM first waits for the
+// thread to catch up, through Sync2D(). so does the 3D renderer starting on
+// the next frame, and the frame ending. lines with display capture or the
+// display FIFO are drawn right away, the CPU could be looking at either.
+
+enum
+{
+    Render2DCmd_Idle = -1,
+    Render2DCmd_Sleep = -2,
+};
+
+void* Render2DThread;
+bool Render2DThreadRunning;
+bool Render2DThreadAwake;
+void* Sema_Render2DStart;
+std::atomic<s32> Render2DCommand; // line to draw, or one of the above
+
+const u32 kRender2DLogSize = 256;
+
+bool Render2DDeferred;
+bool Render2DPending; // there are logged lines that might not be drawn yet
+GPU2D* Render2D_A;
+GPU2D* Render2D_B;
+GPU2D::LineState Render2DLog[kRender2DLogSize][2];
+std::atomic<u32> Render2DNumLogged;
+std::atomic<u32> Render2DNumDrawn;
+
+void StopRender2DThread();
+
 
 bool Init()
 {
@@ -83,18 +139,203 @@ bool Init()
     GPU2D_B = new GPU2D(1);
     if (!GPU3D::Init()) return false;
 
+    Render2D_A = new GPU2D(0);
+    Render2D_B = new GPU2D(1);
+
+    Sema_Render2DStart = Platform::Semaphore_Create();
+    Render2DThreadRunning = false;
+    Render2DThreadAwake = false;
+    Render2DDeferred = false;
+    Render2DPending = false;
+    Render2DNumLogged = 0;
+    Render2DNumDrawn = 0;
+
     return true;
 }
 
 void DeInit()
 {
+    StopRender2DThread();
+    Platform::Semaphore_Free(Sema_Render2DStart);
+
     delete GPU2D_A;
     delete GPU2D_B;
+    delete Render2D_A;
+    delete Render2D_B;
     GPU3D::DeInit();
 }
 
+void Render2DThreadFunc()
+{
+    for (;;)
+    {
+        Platform::Semaphore_Wait(Sema_Render2DStart);
+        if (!Render2DThreadRunning) return;
+
+        for (;;)
+        {
+            // logged lines come first, going back to sleep means being done with them
+            u32 drawn = Render2DNumDrawn.load();
+            if (drawn != Render2DNumLogged.load())
+            {
+                GPU2D::LineState* state = Render2DLog[drawn & (kRender2DLogSize-1)];
+                Render2D_A->DrawLatchedScanline(&state[0]);
+                Render2D_B->DrawLatchedScanline(&state[1]);
+                Render2DNumDrawn = drawn + 1;
+                continue;
+            }
+
+            s32 cmd = Render2DCommand.load();
+            if (cmd == Render2DCmd_Idle)
+            {
+                Platform::Thread_Yield();
+                continue;
+            }
+
+            if (cmd == Render2DCmd_Sleep)
+            {
+                Render2DCommand = Render2DCmd_Idle;
+                break;
+            }
+
+            GPU2D_B->DrawScanline(cmd);
+            Render2DCommand = Render2DCmd_Idle;
+        }
+    }
+}
+
+void WakeRender2DThread()
+{
+    if (Render2DThreadAwake) return;
+
+    Render2DThreadAwake = true;
+    Platform::Semaphore_Post(Sema_Render2DStart);
+}
+
+void SleepRender2DThread()
+{
+    if (!Render2DThreadAwake) return;
+
+    Render2DThreadAwake = false;
+    Render2DCommand = Render2DCmd_Sleep;
+    while (Render2DCommand.load() != Render2DCmd_Idle)
+        Platform::Thread_Yield();
+
+    Render2DPending = false;
+}
+
+void FinishRender2D()
+{
+    while (Render2DNumDrawn.load() != Render2DNumLogged.load())
+        Platform::Thread_Yield();
+
+    Render2DPending = false;
+}
+
+void StopRender2DThread()
+{
+    if (Render2DThreadRunning)
+    {
+        SleepRender2DThread();
+
+        Render2DThreadRunning = false;
+        Platform::Semaphore_Post(Sema_Render2DStart);
+        Platform::Thread_Wait(Render2DThread);
+        Platform::Thread_Free(Render2DThread);
+    }
+}
+
+void SetupRender2DThread()
+{
+    Sync2D();
+
+    // whichever engines draw from now on might have missed VRAM changes
+    bool deferred = Config::Deferred2D != 0;
+    if (deferred != Render2DDeferred)
+    {
+        Render2DDeferred = deferred;
+        if (deferred)
+        {
+            Render2D_A->ResetCaches();
+            Render2D_B->ResetCaches();
+        }
+        else
+        {
+            GPU2D_A->ResetCaches();
+            GPU2D_B->ResetCaches();
+        }
+    }
+
+    if (Config::Threaded2D || Render2DDeferred)
+    {
+        if (!Render2DThreadRunning)
+        {
+            Render2DCommand = Render2DCmd_Idle;
+            Render2DThreadAwake = false;
+            Render2DThreadRunning = true;
+            Render2DThread = Platform::Thread_Create(Render2DThreadFunc);
+        }
+    }
+    else
+    {
+        StopRender2DThread();
+    }
+}
+
+void DrawScanlinesDeferred(u32 line)
+{
+    bool now = GPU2D_A->UsesCapture() || GPU2D_A->UsesFIFO();
+    if (now)
+        Sync2D();
+
+    u32 num = Render2DNumLogged.load();
+    while ((num - Render2DNumDrawn.load()) >= kRender2DLogSize)
+        Platform::Thread_Yield();
+
+    GPU2D::LineState* state = Render2DLog[num & (kRender2DLogSize-1)];
+    GPU2D_A->LatchScanline(line, &state[0]);
+    GPU2D_B->LatchScanline(line, &state[1]);
+
+    if (now)
+    {
+        Render2D_A->DrawLatchedScanline(&state[0]);
+        Render2D_B->DrawLatchedScanline(&state[1]);
+        return;
+    }
+
+    Render2DNumLogged = num + 1;
+    Render2DPending = true;
+    WakeRender2DThread();
+}
+
+void DrawScanlines(u32 line)
+{
+    if (!Render2DThreadRunning)
+    {
+        GPU2D_A->DrawScanline(line);
+        GPU2D_B->DrawScanline(line);
+        return;
+    }
+
+    if (Render2DDeferred)
+    {
+        DrawScanlinesDeferred(line);
+        return;
+    }
+
+    WakeRender2DThread();
+
+    Render2DCommand = line;
+    GPU2D_A->DrawScanline(line);
+
+    while (Render2DCommand.load() != Render2DCmd_Idle)
+        Platform::Thread_Yield();
+}
+
 void Reset()
 {
+    Sync2D();
+
     VCount = 0;
     NextVCount = -1;
     TotalScanlines = 0;
@@ -138,6 +379,13 @@ void Reset()
     VRAMMap_ARM7[0] = 0;
     VRAMMap_ARM7[1] = 0;
 
+    VRAMDirty_ABG = 0;
+    VRAMDirty_BBG = 0;
+    OAMDirty[0] = false;
+    OAMDirty[1] = false;
+    memset(LastVRAMMap_ABG, 0, sizeof(LastVRAMMap_ABG));
+    memset(LastVRAMMap_BBG, 0, sizeof(LastVRAMMap_BBG));
+
     for (int i = 0; i < 256*192*2; i++)
     {
         Framebuffer[i] = 0xFFFFFFFF;
@@ -145,14 +393,20 @@ void Reset()
 
     GPU2D_A->Reset();
     GPU2D_B->Reset();
+    Render2D_A->Reset();
+    Render2D_B->Reset();
     GPU3D::Reset();
 
+    SetupRender2DThread();
+
     GPU2D_A->SetFramebuffer(&Framebuffer[256*192]);
     GPU2D_B->SetFramebuffer(&Framebuffer[256*0]);
 }
 
 void Stop()
 {
+    SleepRender2DThread();
+
     memset(Framebuffer, 0, 256*192*2*4);
 }
 
@@ -160,6 +414,10 @@ void DoSavestate(Savestate* file)
 {
     file->Section("GPUG");
 
+    // the 2D and 3D renderers have to be done with what's about to be saved or replaced
+    Sync2D();
+    GPU3D::SoftRenderer::FinishRendering();
+
     file->Var16(&VCount);
     file->Var32(&NextVCount);
     file->Var16(&TotalScanlines);
@@ -203,9 +461,26 @@ void DoSavestate(Savestate* file)
     file->Var32(&VRAMMap_ARM7[0]);
     file->Var32(&VRAMMap_ARM7[1]);
 
+    if (!file->Saving)
+    {
+        // the 2D engines drop their tile caches on their own
+        VRAMDirty_ABG = 0;
+        VRAMDirty_BBG = 0;
+        OAMDirty[0] = false;
+        OAMDirty[1] = false;
+        memcpy(LastVRAMMap_ABG, VRAMMap_ABG, sizeof(VRAMMap_ABG));
+        memcpy(LastVRAMMap_BBG, VRAMMap_BBG, sizeof(VRAMMap_BBG));
+    }
+
     GPU2D_A->DoSavestate(file);
     GPU2D_B->DoSavestate(file);
     GPU3D::DoSavestate(file);
+
+    if (!file->Saving)
+    {
+        Render2D_A->ResetCaches();
+        Render2D_B->ResetCaches();
+    }
 }
 
 
@@ -239,6 +514,47 @@ void DoSavestate(Savestate* file)
 // when reading: values are read from each bank and ORed together
 // when writing: value is written to each bank
 
+void SetVRAMDirty(u32 addr)
+{
+    switch (addr & 0x00E00000)
+    {
+    case 0x00000000: VRAMDirty_ABG |= (1 << ((addr >> 14) & 0x1F)); break;
+    case 0x00200000: VRAMDirty_BBG |= (1 << ((addr >> 14) & 0x7)); break;
+    }
+}
+
+// BG pages whose mapping changed need their cached tiles thrown out
+void CheckBGRemap()
+{
+    for (int i = 0; i < 0x20; i++)
+    {
+        if (VRAMMap_ABG[i] == LastVRAMMap_ABG[i]) continue;
+        LastVRAMMap_ABG[i] = VRAMMap_ABG[i];
+        VRAMDirty_ABG |= (1 << i);
+    }
+
+    for (int i = 0; i < 0x8; i++)
+    {
+        if (VRAMMap_BBG[i] == LastVRAMMap_BBG[i]) continue;
+        LastVRAMMap_BBG[i] = VRAMMap_BBG[i];
+        VRAMDirty_BBG |= (1 << i);
+    }
+}
+
+// the ext palette caches are in both the live engines and the deferred
+// rendering ones, whichever set is drawing has to hear about remaps
+void BGExtPalDirty(u32 num, u32 base)
+{
+    (num ? GPU2D_B : GPU2D_A)->BGExtPalDirty(base);
+    (num ? Render2D_B : Render2D_A)->BGExtPalDirty(base);
+}
+
+void OBJExtPalDirty(u32 num)
+{
+    (num ? GPU2D_B : GPU2D_A)->OBJExtPalDirty();
+    (num ? Render2D_B : Render2D_A)->OBJExtPalDirty();
+}
+
 #define MAP_RANGE(map, base, n)  for (int i = 0; i < n; i++) map[(base)+i] |= bankmask;
 #define UNMAP_RANGE(map, base, n)  for (int i = 0; i < n; i++) map[(base)+i] &= ~bankmask;
 
@@ -249,6 +565,9 @@ void MapVRAM_AB(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+    NDS::SyncARM7(); // the ARM7 could be using VRAMMap_ARM7 or its read map
+
     u8 oldofs = (oldcnt >> 3) & 0x3;
     u8 ofs = (cnt >> 3) & 0x3;
     u32 bankmask = 1 << bank;
@@ -298,6 +617,9 @@ void MapVRAM_AB(u32 bank, u8 cnt)
             break;
         }
     }
+
+    CheckBGRemap();
+    NDS::RemapPages(0x06000000, 0x07000000);
 }
 
 void MapVRAM_CD(u32 bank, u8 cnt)
@@ -309,6 +631,9 @@ void MapVRAM_CD(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+    NDS::SyncARM7(); // the ARM7 could be using VRAMMap_ARM7 or its read map
+
     u8 oldofs = (oldcnt >> 3) & 0x7;
     u8 ofs = (cnt >> 3) & 0x7;
     u32 bankmask = 1 << bank;
@@ -381,6 +706,9 @@ void MapVRAM_CD(u32 bank, u8 cnt)
             break;
         }
     }
+
+    CheckBGRemap();
+    NDS::RemapPages(0x06000000, 0x07000000);
 }
 
 void MapVRAM_E(u32 bank, u8 cnt)
@@ -390,6 +718,9 @@ void MapVRAM_E(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+    NDS::SyncARM7(); // the ARM7 could be using VRAMMap_ARM7 or its read map
+
     u32 bankmask = 1 << bank;
 
     if (oldcnt & (1<<7))
@@ -414,8 +745,8 @@ void MapVRAM_E(u32 bank, u8 cnt)
 
         case 4: // ABG ext palette
             UNMAP_RANGE(VRAMMap_ABGExtPal, 0, 4);
-            GPU2D_A->BGExtPalDirty(0);
-            GPU2D_A->BGExtPalDirty(2);
+            BGExtPalDirty(0, 0);
+            BGExtPalDirty(0, 2);
             break;
         }
     }
@@ -442,11 +773,14 @@ void MapVRAM_E(u32 bank, u8 cnt)
 
         case 4: // ABG ext palette
             MAP_RANGE(VRAMMap_ABGExtPal, 0, 4);
-            GPU2D_A->BGExtPalDirty(0);
-            GPU2D_A->BGExtPalDirty(2);
+            BGExtPalDirty(0, 0);
+            BGExtPalDirty(0, 2);
             break;
         }
     }
+
+    CheckBGRemap();
+    NDS::RemapPages(0x06000000, 0x07000000);
 }
 
 void MapVRAM_FG(u32 bank, u8 cnt)
@@ -456,6 +790,9 @@ void MapVRAM_FG(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+    NDS::SyncARM7(); // the ARM7 could be using VRAMMap_ARM7 or its read map
+
     u8 oldofs = (oldcnt >> 3) & 0x7;
     u8 ofs = (cnt >> 3) & 0x7;
     u32 bankmask = 1 << bank;
@@ -485,12 +822,12 @@ void MapVRAM_FG(u32 bank, u8 cnt)
         case 4: // ABG ext palette
             VRAMMap_ABGExtPal[((oldofs & 0x1) << 1)] &= ~bankmask;
             VRAMMap_ABGExtPal[((oldofs & 0x1) << 1) + 1] &= ~bankmask;
-            GPU2D_A->BGExtPalDirty((oldofs & 0x1) << 1);
+            BGExtPalDirty(0, (oldofs & 0x1) << 1);
             break;
 
         case 5: // AOBJ ext palette
             VRAMMap_AOBJExtPal &= ~bankmask;
-            GPU2D_A->OBJExtPalDirty();
+            OBJExtPalDirty(0);
             break;
         }
     }
@@ -520,15 +857,18 @@ void MapVRAM_FG(u32 bank, u8 cnt)
         case 4: // ABG ext palette
             VRAMMap_ABGExtPal[((ofs & 0x1) << 1)] |= bankmask;
             VRAMMap_ABGExtPal[((ofs & 0x1) << 1) + 1] |= bankmask;
-            GPU2D_A->BGExtPalDirty((ofs & 0x1) << 1);
+            BGExtPalDirty(0, (ofs & 0x1) << 1);
             break;
 
         case 5: // AOBJ ext palette
             VRAMMap_AOBJExtPal |= bankmask;
-            GPU2D_A->OBJExtPalDirty();
+            OBJExtPalDirty(0);
             break;
         }
     }
+
+    CheckBGRemap();
+    NDS::RemapPages(0x06000000, 0x07000000);
 }
 
 void MapVRAM_H(u32 bank, u8 cnt)
@@ -538,6 +878,9 @@ void MapVRAM_H(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+    NDS::SyncARM7(); // the ARM7 could be using VRAMMap_ARM7 or its read map
+
     u32 bankmask = 1 << bank;
 
     if (oldcnt & (1<<7))
@@ -557,8 +900,8 @@ void MapVRAM_H(u32 bank, u8 cnt)
 
         case 2: // BBG ext palette
             UNMAP_RANGE(VRAMMap_BBGExtPal, 0, 4);
-            GPU2D_B->BGExtPalDirty(0);
-            GPU2D_B->BGExtPalDirty(2);
+            BGExtPalDirty(1, 0);
+            BGExtPalDirty(1, 2);
             break;
         }
     }
@@ -580,11 +923,14 @@ void MapVRAM_H(u32 bank, u8 cnt)
 
         case 2: // BBG ext palette
             MAP_RANGE(VRAMMap_BBGExtPal, 0, 4);
-            GPU2D_B->BGExtPalDirty(0);
-            GPU2D_B->BGExtPalDirty(2);
+            BGExtPalDirty(1, 0);
+            BGExtPalDirty(1, 2);
             break;
         }
     }
+
+    CheckBGRemap();
+    NDS::RemapPages(0x06000000, 0x07000000);
 }
 
 void MapVRAM_I(u32 bank, u8 cnt)
@@ -594,6 +940,9 @@ void MapVRAM_I(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+    NDS::SyncARM7(); // the ARM7 could be using VRAMMap_ARM7 or its read map
+
     u32 bankmask = 1 << bank;
 
     if (oldcnt & (1<<7))
@@ -617,7 +966,7 @@ void MapVRAM_I(u32 bank, u8 cnt)
 
         case 3: // BOBJ ext palette
             VRAMMap_BOBJExtPal &= ~bankmask;
-            GPU2D_B->OBJExtPalDirty();
+            OBJExtPalDirty(1);
             break;
         }
     }
@@ -643,10 +992,13 @@ void MapVRAM_I(u32 bank, u8 cnt)
 
         case 3: // BOBJ ext palette
             VRAMMap_BOBJExtPal |= bankmask;
-            GPU2D_B->OBJExtPalDirty();
+            OBJExtPalDirty(1);
             break;
         }
     }
+
+    CheckBGRemap();
+    NDS::RemapPages(0x06000000, 0x07000000);
 }
 
 
@@ -664,6 +1016,8 @@ void SetPowerCnt(u32 val)
 
     GPU2D_A->SetEnabled(val & (1<<1));
     GPU2D_B->SetEnabled(val & (1<<9));
+    NDS::RemapPages(0x05000000, 0x06000000); // palette
+    NDS::RemapPages(0x07000000, 0x08000000); // OAM
     GPU3D::SetEnabled(val & (1<<3), val & (1<<2));
 
     if (val & (1<<15))
@@ -723,18 +1077,21 @@ void StartHBlank(u32 line)
         // draw
         // note: this should start 48 cycles after the scanline start
         if (line < 192)
-        {
-            GPU2D_A->DrawScanline(line);
-            GPU2D_B->DrawScanline(line);
-        }
+            DrawScanlines(line);
 
         NDS::CheckDMAs(0, 0x02);
     }
     else if (VCount == 215)
     {
+        SleepRender2DThread();
         GPU3D::VCount215();
     }
 
+    // done with the visible lines for this frame
+    // (deferred lines can still be drawn until the 3D renderer moves on)
+    if (line == 191 && !Render2DDeferred)
+        SleepRender2DThread();
+
     if (DispStat[0] & (1<<4)) NDS::SetIRQ(0, NDS::IRQ_HBlank);
     if (DispStat[1] & (1<<4)) NDS::SetIRQ(1, NDS::IRQ_HBlank);
 
@@ -746,6 +1103,9 @@ void StartHBlank(u32 line)
 
 void FinishFrame(u32 lines)
 {
+    // the frame has to be all there for the frontend
+    SleepRender2DThread();
+
     TotalScanlines = lines;
 }
 
@@ -61,6 +61,13 @@ extern u32 VRAMMap_Texture[4];
 extern u32 VRAMMap_TexPal[8];
 extern u32 VRAMMap_ARM7[2];
 
+// 16K pages of BG VRAM that were written to or remapped, for the 2D engines' tile caches
+extern u32 VRAMDirty_ABG;
+extern u32 VRAMDirty_BBG;
+
+// OAM was written, per engine, for the 2D engines' sprite bins
+extern bool OAMDirty[2];
+
 extern u32 Framebuffer[256*192*2];
 
 extern GPU2D* GPU2D_A;
@@ -74,6 +81,18 @@ void Stop();
 
 void DoSavestate(Savestate* file);
 
+void SetupRender2DThread();
+
+// with deferred 2D rendering, scanlines can be drawn a while after they are
+// done. this waits for them, it has to be called before anything the 2D
+// engines read from memory (VRAM, palette, OAM) changes
+extern bool Render2DPending;
+void FinishRender2D();
+inline void Sync2D()
+{
+    if (Render2DPending) FinishRender2D();
+}
+
 
 void MapVRAM_AB(u32 bank, u8 cnt);
 void MapVRAM_CD(u32 bank, u8 cnt);
@@ -82,6 +101,9 @@ void MapVRAM_FG(u32 bank, u8 cnt);
 void MapVRAM_H(u32 bank, u8 cnt);
 void MapVRAM_I(u32 bank, u8 cnt);
 
+// for writes that go straight to the VRAM banks, takes an ARM9 address
+void SetVRAMDirty(u32 addr);
+
 
 template<typename T>
 T ReadVRAM_LCDC(u32 addr)
@@ -151,6 +173,8 @@ T ReadVRAM_LCDC(u32 addr)
 template<typename T>
 void WriteVRAM_LCDC(u32 addr, T val)
 {
+    Sync2D();
+
     int bank;
 
     switch (addr & 0xFF8FC000)
@@ -232,7 +256,10 @@ T ReadVRAM_ABG(u32 addr)
 template<typename T>
 void WriteVRAM_ABG(u32 addr, T val)
 {
+    Sync2D();
+
     u32 mask = VRAMMap_ABG[(addr >> 14) & 0x1F];
+    VRAMDirty_ABG |= (1 << ((addr >> 14) & 0x1F));
 
     if (mask & (1<<0)) *(T*)&VRAM_A[addr & 0x1FFFF] = val;
     if (mask & (1<<1)) *(T*)&VRAM_B[addr & 0x1FFFF] = val;
@@ -262,6 +289,8 @@ T ReadVRAM_AOBJ(u32 addr)
 template<typename T>
 void WriteVRAM_AOBJ(u32 addr, T val)
 {
+    Sync2D();
+
     u32 mask = VRAMMap_AOBJ[(addr >> 14) & 0xF];
 
     if (mask & (1<<0)) *(T*)&VRAM_A[addr & 0x1FFFF] = val;
@@ -288,7 +317,10 @@ T ReadVRAM_BBG(u32 addr)
 template<typename T>
 void WriteVRAM_BBG(u32 addr, T val)
 {
+    Sync2D();
+
     u32 mask = VRAMMap_BBG[(addr >> 14) & 0x7];
+    VRAMDirty_BBG |= (1 << ((addr >> 14) & 0x7));
 
     if (mask & (1<<2)) *(T*)&VRAM_C[addr & 0x1FFFF] = val;
     if (mask & (1<<7)) *(T*)&VRAM_H[addr & 0x7FFF] = val;
@@ -311,6 +343,8 @@ T ReadVRAM_BOBJ(u32 addr)
 template<typename T>
 void WriteVRAM_BOBJ(u32 addr, T val)
 {
+    Sync2D();
+
     u32 mask = VRAMMap_BOBJ[(addr >> 14) & 0x7];
 
     if (mask & (1<<3)) *(T*)&VRAM_D[addr & 0x1FFFF] = val;
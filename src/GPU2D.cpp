@@ -21,6 +21,10 @@
 #include "NDS.h"
 #include "GPU.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 
 // notes on color conversion
 //
@@ -134,11 +138,7 @@ void GPU2D::Reset()
 
     MasterBrightness = 0;
 
-    BGExtPalStatus[0] = 0;
-    BGExtPalStatus[1] = 0;
-    BGExtPalStatus[2] = 0;
-    BGExtPalStatus[3] = 0;
-    OBJExtPalStatus = 0;
+    ResetCaches();
 }
 
 void GPU2D::DoSavestate(Savestate* file)
@@ -202,11 +202,7 @@ void GPU2D::DoSavestate(Savestate* file)
     if (!file->Saving)
     {
         // refresh those
-        BGExtPalStatus[0] = 0;
-        BGExtPalStatus[1] = 0;
-        BGExtPalStatus[2] = 0;
-        BGExtPalStatus[3] = 0;
-        OBJExtPalStatus = 0;
+        ResetCaches();
     }
 }
 
@@ -550,6 +546,11 @@ void GPU2D::Write32(u32 addr, u32 val)
 
 
 void GPU2D::DrawScanline(u32 line)
+{
+    DrawScanline(line, GPU::VCount);
+}
+
+void GPU2D::DrawScanline(u32 line, u32 vcount)
 {
     u32* dst = &Framebuffer[256*line];
     u32 mode1gfx[256];
@@ -560,7 +561,7 @@ void GPU2D::DrawScanline(u32 line)
     if (Num == 0)
         GPU3D::RequestLine(line);
 
-    line = GPU::VCount;
+    line = vcount;
 
     bool forceblank = false;
 
@@ -727,6 +728,108 @@ void GPU2D::DrawScanline(u32 line)
     }
 }
 
+template<bool save>
+void GPU2D::CopyLineState(LineState* state)
+{
+#define COPY(var) \
+    if (save) memcpy(&state->var, &var, sizeof(var)); \
+    else      memcpy(&var, &state->var, sizeof(var));
+
+    COPY(Enabled);
+    COPY(Framebuffer);
+
+    COPY(DispCnt);
+    COPY(BGCnt);
+    COPY(BGXPos);
+    COPY(BGYPos);
+    COPY(BGXRefInternal);
+    COPY(BGYRefInternal);
+    COPY(BGRotA);
+    COPY(BGRotB);
+    COPY(BGRotC);
+    COPY(BGRotD);
+
+    COPY(Win0Coords);
+    COPY(Win1Coords);
+    COPY(WinCnt);
+    COPY(Win0Active);
+    COPY(Win1Active);
+
+    COPY(BGMosaicSize);
+    COPY(OBJMosaicSize);
+    COPY(BGMosaicY);
+    COPY(OBJMosaicY);
+
+    COPY(BlendCnt);
+    COPY(EVA);
+    COPY(EVB);
+    COPY(EVY);
+
+    COPY(CaptureCnt);
+    COPY(MasterBrightness);
+
+#undef COPY
+}
+
+void GPU2D::LatchScanline(u32 line, LineState* state)
+{
+    state->Line = line;
+    state->VCount = GPU::VCount;
+    CopyLineState<true>(state);
+
+    // from there, do what drawing the line would do to the engine state,
+    // following DrawScanline() and DrawScanline_Mode1()
+
+    if (GPU::VCount > 192) return;
+    if (Num && !Enabled) return;
+    if (DispCnt & (1<<7)) return;
+
+    // CalculateWindowMask() goes through both edges of a window,
+    // it is left open if the start comes last
+    if (DispCnt & (1<<14))
+    {
+        if (Win1Coords[0] > Win1Coords[1]) Win1Active |=  0x2;
+        else                               Win1Active &= ~0x2;
+    }
+    if (DispCnt & (1<<13))
+    {
+        if (Win0Coords[0] > Win0Coords[1]) Win0Active |=  0x2;
+        else                               Win0Active &= ~0x2;
+    }
+
+    // affine/extended/large BGs move their reference point
+    u32 bgmode = DispCnt & 0x7;
+    if (bgmode == 6)
+    {
+        if ((!Num) && (DispCnt & 0x0400) && !(BGCnt[2] & 0x8000))
+        {
+            BGXRefInternal[0] += BGRotB[0];
+            BGYRefInternal[0] += BGRotD[0];
+        }
+    }
+    else if (bgmode >= 1 && bgmode <= 5)
+    {
+        if ((DispCnt & 0x0400) && (bgmode == 2 || bgmode >= 4))
+        {
+            BGXRefInternal[0] += BGRotB[0];
+            BGYRefInternal[0] += BGRotD[0];
+        }
+        if (DispCnt & 0x0800)
+        {
+            BGXRefInternal[1] += BGRotB[1];
+            BGYRefInternal[1] += BGRotD[1];
+        }
+    }
+
+    UpdateMosaicCounters();
+}
+
+void GPU2D::DrawLatchedScanline(LineState* state)
+{
+    CopyLineState<false>(state);
+    DrawScanline(state->Line, state->VCount);
+}
+
 void GPU2D::VBlank()
 {
     CaptureCnt &= ~(1<<31);
@@ -924,6 +1027,19 @@ void GPU2D::OBJExtPalDirty()
     OBJExtPalStatus = 0;
 }
 
+void GPU2D::ResetCaches()
+{
+    BGExtPalStatus[0] = 0;
+    BGExtPalStatus[1] = 0;
+    BGExtPalStatus[2] = 0;
+    BGExtPalStatus[3] = 0;
+    OBJExtPalStatus = 0;
+
+    memset(TileRowStatus, 0, sizeof(TileRowStatus));
+
+    SpriteBinsValid = false;
+}
+
 
 u16* GPU2D::GetBGExtPal(u32 slot, u32 pal)
 {
@@ -994,6 +1110,42 @@ u16* GPU2D::GetOBJExtPal(u32 pal)
 }
 
 
+void GPU2D::CheckTileRowCache()
+{
+    u32& dirty = Num ? GPU::VRAMDirty_BBG : GPU::VRAMDirty_ABG;
+    if (!dirty) return;
+
+    // each 16K page is 128 words of status bits
+    for (int page = 0; page < 32; page++)
+    {
+        if (dirty & (1<<page))
+            memset(&TileRowStatus[page << 7], 0, 128*4);
+    }
+
+    dirty = 0;
+}
+
+u8* GPU2D::GetTileRow16(u32 addr)
+{
+    u32 row = (addr & (Num ? 0x1FFFF : 0x7FFFF)) >> 2;
+    u64* dst = &TileRowCache[row];
+
+    if (!(TileRowStatus[row >> 5] & (1 << (row & 0x1F))))
+    {
+        // spread the 8 nibbles out to one byte each
+        u64 pixels = GPU::ReadVRAM_BG<u32>(addr);
+        pixels = (pixels | (pixels << 16)) & 0x0000FFFF0000FFFFULL;
+        pixels = (pixels | (pixels << 8))  & 0x00FF00FF00FF00FFULL;
+        pixels = (pixels | (pixels << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+        *dst = pixels;
+
+        TileRowStatus[row >> 5] |= (1 << (row & 0x1F));
+    }
+
+    return (u8*)dst;
+}
+
+
 void GPU2D::CheckWindows(u32 line)
 {
     line &= 0xFF;
@@ -1127,6 +1279,130 @@ void GPU2D::DrawScanlineBGMode6(u32 line, u32* spritebuf, u32* dst)
     }
 }
 
+#ifdef __SSE2__
+
+static inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128i TestMask(__m128i val, __m128i bits)
+{
+    __m128i none = _mm_cmpeq_epi32(_mm_and_si128(val, bits), _mm_setzero_si128());
+    return _mm_xor_si128(none, _mm_set1_epi32(-1));
+}
+
+// same as the scalar loop in DrawScanline_Mode1(), four pixels at a time.
+// all the effects come down to (c1*wa + c2*wb + bias) >> 5 for each channel:
+// * blending: wa = EVA*2, wb = EVB*2
+// * 3D layer blending: wa = eva, wb = 32-eva, bias = 32 (the +1) if eva <= 16
+// * brightness up: c2 = 63, wa = 32-EVY*2, wb = EVY*2
+// * brightness down: wa = 32-EVY*2, wb = 0, bias = 31 (it rounds up)
+static void ColorEffects_SSE2(u32* dst, u32* linebuf, u8* windowmask, u32 blendcnt, u32 eva, u32 evb, u32 evy)
+{
+    u32 bldcnteffect = (blendcnt >> 6) & 0x3;
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i colormask = _mm_set1_epi32(0x003F3F3F);
+    const __m128i bldcnt = _mm_set1_epi32(blendcnt);
+    const __m128i blendwa = _mm_set1_epi32(eva << 1);
+    const __m128i blendwb = _mm_set1_epi32(evb << 1);
+    const __m128i brightwa = _mm_set1_epi32(32 - (evy << 1));
+    const __m128i brightwb = _mm_set1_epi32((bldcnteffect == 2) ? (evy << 1) : 0);
+    const __m128i brightbias = _mm_set1_epi32((bldcnteffect == 3) ? 31 : 0);
+
+    for (int i = 0; i < 256; i += 4)
+    {
+        __m128i val1 = _mm_loadu_si128((__m128i*)&linebuf[i]);
+        __m128i val2 = _mm_loadu_si128((__m128i*)&linebuf[256+i]);
+
+        u32 win4;
+        memcpy(&win4, &windowmask[i], 4);
+        __m128i win = _mm_cvtsi32_si128(win4);
+        win = _mm_unpacklo_epi16(_mm_unpacklo_epi8(win, zero), zero);
+
+        __m128i flag1 = _mm_srli_epi32(val1, 24);
+        __m128i flag2 = _mm_srli_epi32(val2, 24);
+
+        __m128i obj1 = TestMask(flag1, _mm_set1_epi32(0x80));
+        __m128i bg3d1 = TestMask(flag1, _mm_set1_epi32(0x40));
+        __m128i obj2 = TestMask(flag2, _mm_set1_epi32(0x80));
+        __m128i bg3d2 = TestMask(flag2, _mm_set1_epi32(0x40));
+
+        __m128i target2 = Select(obj2, _mm_set1_epi32(0x1000),
+                          Select(bg3d2, _mm_set1_epi32(0x0100), _mm_slli_epi32(flag2, 8)));
+        __m128i target2ok = TestMask(target2, bldcnt);
+
+        __m128i target1 = Select(obj1, _mm_set1_epi32(0x10),
+                          Select(bg3d1, _mm_set1_epi32(0x01), flag1));
+        __m128i target1ok = _mm_and_si128(TestMask(target1, bldcnt),
+                                          TestMask(win, _mm_set1_epi32(0x20)));
+
+        __m128i objblend = _mm_and_si128(obj1, target2ok);
+        __m128i blend3d = _mm_andnot_si128(obj1, _mm_and_si128(bg3d1, target2ok));
+        __m128i other = _mm_andnot_si128(_mm_or_si128(objblend, blend3d), target1ok);
+
+        __m128i blend, bright;
+        if (bldcnteffect == 1)
+        {
+            blend = _mm_or_si128(objblend, _mm_and_si128(other, target2ok));
+            bright = zero;
+        }
+        else
+        {
+            blend = objblend;
+            bright = (bldcnteffect >= 2) ? other : zero;
+        }
+
+        // bitmap sprites bring their own alpha, so does the 3D layer
+        __m128i alpha = _mm_and_si128(flag1, _mm_set1_epi32(0x1F));
+        __m128i objalpha = _mm_and_si128(objblend, bg3d1);
+        __m128i alpha3d = _mm_add_epi32(alpha, _mm_set1_epi32(1));
+        alpha = _mm_slli_epi32(alpha, 1);
+
+        __m128i wa = Select(objalpha, alpha, blendwa);
+        __m128i wb = Select(objalpha, _mm_sub_epi32(_mm_set1_epi32(32), alpha), blendwb);
+        wa = Select(blend3d, alpha3d, wa);
+        wb = Select(blend3d, _mm_sub_epi32(_mm_set1_epi32(32), alpha3d), wb);
+        wa = Select(bright, brightwa, wa);
+        wb = Select(bright, brightwb, wb);
+
+        __m128i bias = _mm_and_si128(blend3d, _mm_cmplt_epi32(alpha3d, _mm_set1_epi32(17)));
+        bias = _mm_and_si128(bias, _mm_set1_epi32(32));
+        bias = _mm_or_si128(bias, _mm_and_si128(bright, brightbias));
+
+        __m128i c1 = _mm_and_si128(val1, colormask);
+        __m128i c2 = Select(bright, colormask, _mm_and_si128(val2, colormask));
+
+        // 16-bit lanes, two pixels per register
+        wa = _mm_or_si128(wa, _mm_slli_epi32(wa, 16));
+        wb = _mm_or_si128(wb, _mm_slli_epi32(wb, 16));
+        bias = _mm_or_si128(bias, _mm_slli_epi32(bias, 16));
+
+        __m128i res[2];
+        for (int j = 0; j < 2; j++)
+        {
+            __m128i c1w = j ? _mm_unpackhi_epi8(c1, zero) : _mm_unpacklo_epi8(c1, zero);
+            __m128i c2w = j ? _mm_unpackhi_epi8(c2, zero) : _mm_unpacklo_epi8(c2, zero);
+            __m128i waw = j ? _mm_unpackhi_epi32(wa, wa) : _mm_unpacklo_epi32(wa, wa);
+            __m128i wbw = j ? _mm_unpackhi_epi32(wb, wb) : _mm_unpacklo_epi32(wb, wb);
+            __m128i biasw = j ? _mm_unpackhi_epi32(bias, bias) : _mm_unpacklo_epi32(bias, bias);
+
+            __m128i sum = _mm_add_epi16(_mm_mullo_epi16(c1w, waw), _mm_mullo_epi16(c2w, wbw));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, biasw), 5);
+            res[j] = _mm_min_epi16(sum, _mm_set1_epi16(0x3F));
+        }
+
+        __m128i out = _mm_packus_epi16(res[0], res[1]);
+        out = _mm_or_si128(out, _mm_set1_epi32(0xFF000000));
+
+        __m128i effect = _mm_or_si128(_mm_or_si128(blend, blend3d), bright);
+        _mm_storeu_si128((__m128i*)&dst[i], Select(effect, out, val1));
+    }
+}
+
+#endif
+
 void GPU2D::DrawScanline_Mode1(u32 line, u32* dst)
 {
     u32 linebuf[256*2 + 64];
@@ -1170,11 +1446,16 @@ void GPU2D::DrawScanline_Mode1(u32 line, u32* dst)
     }
 
     // color special effects
-    // can likely be optimized
 
     u32 bldcnteffect = (BlendCnt >> 6) & 0x3;
 
-    for (int i = 0; i < 256; i++)
+    int i = 0;
+#ifdef __SSE2__
+    ColorEffects_SSE2(dst, linebuf, windowmask, BlendCnt, EVA, EVB, EVY);
+    i = 256;
+#endif
+
+    for (; i < 256; i++)
     {
         u32 val1 = linebuf[i];
         u32 val2 = linebuf[256+i];
@@ -1304,6 +1585,11 @@ void GPU2D::DrawScanline_Mode1(u32 line, u32* dst)
         }
     }
 
+    UpdateMosaicCounters();
+}
+
+void GPU2D::UpdateMosaicCounters()
+{
     if (BGMosaicY >= BGMosaicYMax)
     {
         BGMosaicY = 0;
@@ -1419,6 +1705,8 @@ void GPU2D::DrawBG_Text(u32 line, u32* dst, u32 bgnum)
     u16 curtile;
     u16* curpal;
     u32 pixelsaddr;
+    u8* pixels = NULL; // set by the first tile load, before it's drawn from
+    u8 pixels256[8];
     u8 color;
 
     if (bgcnt & 0x0080)
@@ -1436,6 +1724,8 @@ void GPU2D::DrawBG_Text(u32 line, u32* dst, u32 bgnum)
 
             pixelsaddr = tilesetaddr + ((curtile & 0x03FF) << 6)
                                      + (((curtile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7)) << 3);
+            *(u32*)&pixels256[0] = GPU::ReadVRAM_BG<u32>(pixelsaddr);
+            *(u32*)&pixels256[4] = GPU::ReadVRAM_BG<u32>(pixelsaddr + 4);
         }
 
         for (int i = 0; i < 256; i++)
@@ -1450,6 +1740,8 @@ void GPU2D::DrawBG_Text(u32 line, u32* dst, u32 bgnum)
 
                 pixelsaddr = tilesetaddr + ((curtile & 0x03FF) << 6)
                                          + (((curtile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7)) << 3);
+                *(u32*)&pixels256[0] = GPU::ReadVRAM_BG<u32>(pixelsaddr);
+                *(u32*)&pixels256[4] = GPU::ReadVRAM_BG<u32>(pixelsaddr + 4);
             }
 
             // draw pixel
@@ -1458,7 +1750,7 @@ void GPU2D::DrawBG_Text(u32 line, u32* dst, u32 bgnum)
                 if (xmos == 0)
                 {
                     u32 tilexoff = (curtile & 0x0400) ? (7-(xoff&0x7)) : (xoff&0x7);
-                    color = GPU::ReadVRAM_BG<u8>(pixelsaddr + tilexoff);
+                    color = pixels256[tilexoff];
                     xmos = xmossize;
                 }
                 else
@@ -1475,6 +1767,8 @@ void GPU2D::DrawBG_Text(u32 line, u32* dst, u32 bgnum)
     {
         // 16-color
 
+        CheckTileRowCache();
+
         // preload shit as needed
         if (xoff & 0x7)
         {
@@ -1483,6 +1777,7 @@ void GPU2D::DrawBG_Text(u32 line, u32* dst, u32 bgnum)
             curpal = pal + ((curtile & 0xF000) >> 8);
             pixelsaddr = tilesetaddr + ((curtile & 0x03FF) << 5)
                                      + (((curtile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7)) << 2);
+            pixels = GetTileRow16(pixelsaddr);
         }
 
         for (int i = 0; i < 256; i++)
@@ -1494,23 +1789,16 @@ void GPU2D::DrawBG_Text(u32 line, u32* dst, u32 bgnum)
                 curpal = pal + ((curtile & 0xF000) >> 8);
                 pixelsaddr = tilesetaddr + ((curtile & 0x03FF) << 5)
                                          + (((curtile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7)) << 2);
+                pixels = GetTileRow16(pixelsaddr);
             }
 
             // draw pixel
-            // TODO: optimize VRAM access
             if (windowmask[i] & (1<<bgnum))
             {
                 if (xmos == 0)
                 {
                     u32 tilexoff = (curtile & 0x0400) ? (7-(xoff&0x7)) : (xoff&0x7);
-                    if (tilexoff & 0x1)
-                    {
-                        color = GPU::ReadVRAM_BG<u8>(pixelsaddr + (tilexoff >> 1)) >> 4;
-                    }
-                    else
-                    {
-                        color = GPU::ReadVRAM_BG<u8>(pixelsaddr + (tilexoff >> 1)) & 0x0F;
-                    }
+                    color = pixels[tilexoff];
                     xmos = xmossize;
                 }
                 else
@@ -1930,25 +2218,60 @@ void GPU2D::InterleaveSprites(u32* buf, u32 prio, u32* dst)
     }
 }
 
-void GPU2D::DrawSprites(u32 line, u32* dst)
+const s32 SpriteWidth[16] =
 {
-    u16* oam = (u16*)&GPU::OAM[Num ? 0x400 : 0];
+    8, 16, 8, 0,
+    16, 32, 8, 0,
+    32, 32, 16, 0,
+    64, 64, 32, 0
+};
+const s32 SpriteHeight[16] =
+{
+    8, 8, 16, 0,
+    16, 8, 32, 0,
+    32, 16, 32, 0,
+    64, 32, 64, 0
+};
+
+// height of the sprite's bounding box, or 0 if it isn't drawn at all
+static s32 SpriteBoundHeight(u16* attrib)
+{
+    u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
+    s32 width = SpriteWidth[sizeparam];
+    s32 height = SpriteHeight[sizeparam];
 
-    const s32 spritewidth[16] =
+    if (attrib[0] & 0x0200)
     {
-        8, 16, 8, 0,
-        16, 32, 8, 0,
-        32, 32, 16, 0,
-        64, 64, 32, 0
-    };
-    const s32 spriteheight[16] =
-    {
-        8, 8, 16, 0,
-        16, 8, 32, 0,
-        32, 16, 32, 0,
-        64, 32, 64, 0
-    };
+        // disabled if it isn't rotscaled, double size otherwise
+        if (!(attrib[0] & 0x0100))
+            return 0;
+
+        width <<= 1;
+        height <<= 1;
+    }
+
+    s32 xpos = (s32)(attrib[1] << 23) >> 23;
+    if (xpos <= -width)
+        return 0;
+
+    return height;
+}
+
+void GPU2D::CheckSpriteBins()
+{
+    if (SpriteBinsValid && !GPU::OAMDirty[Num])
+        return;
+
+    GPU::OAMDirty[Num] = false;
+    SpriteBinsValid = true;
+
+    u16* oam = (u16*)&GPU::OAM[Num ? 0x400 : 0];
+
+    memset(SpriteBinCount, 0, 256);
+    memset(SpriteWindowBinCount, 0, 256);
 
+    // regular sprites go back to front: lowest priority first, then from the
+    // last OAM entry to the first, so the bins can be drawn as they are
     for (int bgnum = 0x0C00; bgnum >= 0x0000; bgnum -= 0x0400)
     {
         for (int sprnum = 127; sprnum >= 0; sprnum--)
@@ -1961,57 +2284,74 @@ void GPU2D::DrawSprites(u32 line, u32* dst)
             if (((attrib[0] >> 10) & 0x3) == 2)
                 continue;
 
-            if (attrib[0] & 0x0100)
+            s32 height = SpriteBoundHeight(attrib);
+            u32 ypos = attrib[0] & 0xFF;
+            for (s32 i = 0; i < height; i++)
             {
-                u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
-                s32 width = spritewidth[sizeparam];
-                s32 height = spriteheight[sizeparam];
-                s32 boundwidth = width;
-                s32 boundheight = height;
+                u32 line = (ypos + i) & 0xFF;
+                SpriteBins[line][SpriteBinCount[line]++] = sprnum;
+            }
+        }
+    }
 
-                if (attrib[0] & 0x0200)
-                {
-                    boundwidth <<= 1;
-                    boundheight <<= 1;
-                }
+    for (int sprnum = 127; sprnum >= 0; sprnum--)
+    {
+        u16* attrib = &oam[sprnum*4];
 
-                u32 ypos = attrib[0] & 0xFF;
-                ypos = (line - ypos) & 0xFF;
-                if (ypos >= (u32)boundheight)
-                    continue;
+        if (((attrib[0] >> 10) & 0x3) != 2)
+            continue;
 
-                s32 xpos = (s32)(attrib[1] << 23) >> 23;
-                if (xpos <= -boundwidth)
-                    continue;
+        s32 height = SpriteBoundHeight(attrib);
+        u32 ypos = attrib[0] & 0xFF;
+        for (s32 i = 0; i < height; i++)
+        {
+            u32 line = (ypos + i) & 0xFF;
+            SpriteWindowBins[line][SpriteWindowBinCount[line]++] = sprnum;
+        }
+    }
+}
 
-                u32 rotparamgroup = (attrib[1] >> 9) & 0x1F;
+void GPU2D::DrawSprites(u32 line, u32* dst)
+{
+    u16* oam = (u16*)&GPU::OAM[Num ? 0x400 : 0];
 
-                DrawSprite_Rotscale<false>(attrib, &oam[(rotparamgroup*16) + 3], boundwidth, boundheight, width, height, xpos, ypos, dst);
-            }
-            else
-            {
-                if (attrib[0] & 0x0200)
-                    continue;
+    CheckSpriteBins();
 
-                u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
-                s32 width = spritewidth[sizeparam];
-                s32 height = spriteheight[sizeparam];
+    u8* bin = SpriteBins[line & 0xFF];
+    u32 numsprites = SpriteBinCount[line & 0xFF];
 
-                u32 ypos = attrib[0] & 0xFF;
-                ypos = (line - ypos) & 0xFF;
-                if (ypos >= (u32)height)
-                    continue;
+    for (u32 i = 0; i < numsprites; i++)
+    {
+        u16* attrib = &oam[bin[i]*4];
 
-                s32 xpos = (s32)(attrib[1] << 23) >> 23;
-                if (xpos <= -width)
-                    continue;
+        u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
+        s32 width = SpriteWidth[sizeparam];
+        s32 height = SpriteHeight[sizeparam];
+        s32 xpos = (s32)(attrib[1] << 23) >> 23;
+        u32 ypos = (line - (attrib[0] & 0xFF)) & 0xFF;
 
-                // yflip
-                if (attrib[1] & 0x2000)
-                    ypos = height-1 - ypos;
+        if (attrib[0] & 0x0100)
+        {
+            s32 boundwidth = width;
+            s32 boundheight = height;
 
-                DrawSprite_Normal<false>(attrib, width, xpos, ypos, dst);
+            if (attrib[0] & 0x0200)
+            {
+                boundwidth <<= 1;
+                boundheight <<= 1;
             }
+
+            u32 rotparamgroup = (attrib[1] >> 9) & 0x1F;
+
+            DrawSprite_Rotscale<false>(attrib, &oam[(rotparamgroup*16) + 3], boundwidth, boundheight, width, height, xpos, ypos, dst);
+        }
+        else
+        {
+            // yflip
+            if (attrib[1] & 0x2000)
+                ypos = height-1 - ypos;
+
+            DrawSprite_Normal<false>(attrib, width, xpos, ypos, dst);
         }
     }
 }
@@ -2020,33 +2360,23 @@ void GPU2D::DrawSpritesWindow(u32 line, u8* dst)
 {
     u16* oam = (u16*)&GPU::OAM[Num ? 0x400 : 0];
 
-    const s32 spritewidth[16] =
-    {
-        8, 16, 8, 0,
-        16, 32, 8, 0,
-        32, 32, 16, 0,
-        64, 64, 32, 0
-    };
-    const s32 spriteheight[16] =
-    {
-        8, 8, 16, 0,
-        16, 8, 32, 0,
-        32, 16, 32, 0,
-        64, 32, 64, 0
-    };
+    CheckSpriteBins();
 
-    for (int sprnum = 127; sprnum >= 0; sprnum--)
+    u8* bin = SpriteWindowBins[line & 0xFF];
+    u32 numsprites = SpriteWindowBinCount[line & 0xFF];
+
+    for (u32 i = 0; i < numsprites; i++)
     {
-        u16* attrib = &oam[sprnum*4];
+        u16* attrib = &oam[bin[i]*4];
 
-        if (((attrib[0] >> 10) & 0x3) != 2)
-            continue;
+        u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
+        s32 width = SpriteWidth[sizeparam];
+        s32 height = SpriteHeight[sizeparam];
+        s32 xpos = (s32)(attrib[1] << 23) >> 23;
+        u32 ypos = (line - (attrib[0] & 0xFF)) & 0xFF;
 
         if (attrib[0] & 0x0100)
         {
-            u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
-            s32 width = spritewidth[sizeparam];
-            s32 height = spriteheight[sizeparam];
             s32 boundwidth = width;
             s32 boundheight = height;
 
@@ -2056,37 +2386,12 @@ void GPU2D::DrawSpritesWindow(u32 line, u8* dst)
                 boundheight <<= 1;
             }
 
-            u32 ypos = attrib[0] & 0xFF;
-            ypos = (line - ypos) & 0xFF;
-            if (ypos >= (u32)boundheight)
-                continue;
-
-            s32 xpos = (s32)(attrib[1] << 23) >> 23;
-            if (xpos <= -boundwidth)
-                continue;
-
             u32 rotparamgroup = (attrib[1] >> 9) & 0x1F;
 
             DrawSprite_Rotscale<true>(attrib, &oam[(rotparamgroup*16) + 3], boundwidth, boundheight, width, height, xpos, ypos, (u32*)dst);
         }
         else
         {
-            if (attrib[0] & 0x0200)
-                continue;
-
-            u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
-            s32 width = spritewidth[sizeparam];
-            s32 height = spriteheight[sizeparam];
-
-            u32 ypos = attrib[0] & 0xFF;
-            ypos = (line - ypos) & 0xFF;
-            if (ypos >= (u32)height)
-                continue;
-
-            s32 xpos = (s32)(attrib[1] << 23) >> 23;
-            if (xpos <= -width)
-                continue;
-
             // yflip
             if (attrib[1] & 0x2000)
                 ypos = height-1 - ypos;
@@ -49,16 +49,62 @@ public:
         return false;
     }
 
+    bool UsesCapture() { return CaptureCnt & (1<<31); }
+
     void SampleFIFO(u32 offset, u32 num);
 
     void DrawScanline(u32 line);
     void VBlank();
     void VBlankEnd();
 
+    // what drawing a scanline depends on, for drawing it later (see GPU::Sync2D())
+    struct LineState
+    {
+        u32 Line;
+        u32 VCount;
+        bool Enabled;
+        u32* Framebuffer;
+
+        u32 DispCnt;
+        u16 BGCnt[4];
+        u16 BGXPos[4];
+        u16 BGYPos[4];
+        s32 BGXRefInternal[2];
+        s32 BGYRefInternal[2];
+        s16 BGRotA[2];
+        s16 BGRotB[2];
+        s16 BGRotC[2];
+        s16 BGRotD[2];
+
+        u8 Win0Coords[4];
+        u8 Win1Coords[4];
+        u8 WinCnt[4];
+        u32 Win0Active;
+        u32 Win1Active;
+
+        u8 BGMosaicSize[2];
+        u8 OBJMosaicSize[2];
+        u8 BGMosaicY;
+        u8 OBJMosaicY;
+
+        u16 BlendCnt;
+        u8 EVA, EVB;
+        u8 EVY;
+
+        u32 CaptureCnt;
+        u16 MasterBrightness;
+    };
+
+    // latches the state for a scanline and moves on as if it was drawn
+    void LatchScanline(u32 line, LineState* state);
+    // draws a latched scanline, meant for another instance than the one it came from
+    void DrawLatchedScanline(LineState* state);
+
     void CheckWindows(u32 line);
 
     void BGExtPalDirty(u32 base);
     void OBJExtPalDirty();
+    void ResetCaches();
 
     u16* GetBGExtPal(u32 slot, u32 pal);
     u16* GetOBJExtPal(u32 pal);
@@ -114,6 +160,26 @@ private:
     u32 BGExtPalStatus[4];
     u32 OBJExtPalStatus;
 
+    // 16-color tile rows, one palette index per byte, by BG VRAM address / 4
+    u64 TileRowCache[0x80000 >> 2];
+    u32 TileRowStatus[0x80000 >> 7];
+
+    void CheckTileRowCache();
+    u8* GetTileRow16(u32 addr);
+
+    // sprites that show up on each line, in the order they're drawn
+    u8 SpriteBins[256][128];
+    u8 SpriteBinCount[256];
+    u8 SpriteWindowBins[256][128];
+    u8 SpriteWindowBinCount[256];
+    bool SpriteBinsValid;
+
+    void CheckSpriteBins();
+
+    template<bool save> void CopyLineState(LineState* state);
+    void DrawScanline(u32 line, u32 vcount);
+    void UpdateMosaicCounters();
+
     template<u32 bgmode> void DrawScanlineBGMode(u32 line, u32* spritebuf, u32* dst);
     void DrawScanlineBGMode6(u32 line, u32* spritebuf, u32* dst);
     void DrawScanline_Mode1(u32 line, u32* dst);
@@ -556,8 +556,6 @@ void DoSavestate(Savestate* file)
         }
     }
 
-    // probably not worth storing the vblank-latched Renderxxxxxx variables
-
     if (file->IsAtleastVersion(2, 1))
     {
         // command stall queue, only in version 2.1 and up
@@ -580,6 +578,38 @@ void DoSavestate(Savestate* file)
         VertexSlotsFree = 1;
     }
 
+    // the vblank-latched Renderxxxxxx variables and what was rendered from them
+    bool hasrenderstate = file->IsAtleastVersion(4, 5);
+    if (hasrenderstate)
+    {
+        file->Var32(&RenderDispCnt);
+        file->Var8(&RenderAlphaRef);
+
+        file->VarArray(RenderToonTable, 32*2);
+        file->VarArray(RenderEdgeTable, 8*2);
+
+        file->Var32(&RenderFogColor);
+        file->Var32(&RenderFogOffset);
+        file->Var32(&RenderFogShift);
+        file->VarArray(RenderFogDensityTable, 34);
+
+        file->Var32(&RenderClearAttr1);
+        file->Var32(&RenderClearAttr2);
+
+        file->Var32(&RenderNumPolygons);
+        if (RenderNumPolygons > 2048) RenderNumPolygons = 0;
+
+        for (u32 i = 0; i < RenderNumPolygons; i++)
+        {
+            u32 id;
+            if (file->Saving) id = (u32)(RenderPolygonRAM[i] - &PolygonRAM[0]);
+            file->Var32(&id);
+            if (!file->Saving) RenderPolygonRAM[i] = &PolygonRAM[id & 0xFFF];
+        }
+
+        SoftRenderer::DoSavestate(file);
+    }
+
     if (!file->Saving)
     {
         ClipMatrixDirty = true;
@@ -588,9 +618,12 @@ void DoSavestate(Savestate* file)
         CurVertexRAM = &VertexRAM[CurRAMBank ? 6144 : 0];
         CurPolygonRAM = &PolygonRAM[CurRAMBank ? 2048 : 0];
 
-        // better safe than sorry, I guess
-        // might cause a blank frame but atleast it won't shit itself
-        RenderNumPolygons = 0;
+        if (!hasrenderstate)
+        {
+            // better safe than sorry, I guess
+            // might cause a blank frame but atleast it won't shit itself
+            RenderNumPolygons = 0;
+        }
     }
 }
 
@@ -126,6 +126,8 @@ void Reset();
 void SetupRenderThread();
 
 void VCount144();
+void FinishRendering();
+void DoSavestate(Savestate* file);
 void RenderFrame();
 void RequestLine(int line);
 u32* GetLine(int line);
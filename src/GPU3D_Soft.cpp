@@ -62,7 +62,7 @@ bool Enabled;
 
 void* RenderThread;
 bool RenderThreadRunning;
-bool RenderThreadRendering;
+bool RenderThreadPending; // started a frame that VCount144() hasn't waited for yet
 void* Sema_RenderStart;
 void* Sema_RenderDone;
 void* Sema_ScanlineCount;
@@ -79,6 +79,8 @@ void StopRenderThread()
         Platform::Thread_Wait(RenderThread);
         Platform::Thread_Free(RenderThread);
     }
+
+    RenderThreadPending = false;
 }
 
 void SetupRenderThread()
@@ -91,12 +93,14 @@ void SetupRenderThread()
             RenderThread = Platform::Thread_Create(RenderThreadFunc);
         }
 
-        if (RenderThreadRendering)
+        if (RenderThreadPending)
             Platform::Semaphore_Wait(Sema_RenderDone);
 
         Platform::Semaphore_Reset(Sema_RenderStart);
+        Platform::Semaphore_Reset(Sema_RenderDone);
         Platform::Semaphore_Reset(Sema_ScanlineCount);
 
+        RenderThreadPending = true;
         Platform::Semaphore_Post(Sema_RenderStart);
     }
     else
@@ -113,7 +117,7 @@ bool Init()
     Sema_ScanlineCount = Platform::Semaphore_Create();
 
     RenderThreadRunning = false;
-    RenderThreadRendering = false;
+    RenderThreadPending = false;
 
     return true;
 }
@@ -2071,16 +2075,45 @@ void RenderPolygons(bool threaded, Polygon** polygons, int npolys)
         Platform::Semaphore_Post(Sema_ScanlineCount);
 }
 
-void VCount144()
+void FinishRendering()
 {
-    if (RenderThreadRunning)
+    if (RenderThreadRunning && RenderThreadPending)
+    {
         Platform::Semaphore_Wait(Sema_RenderDone);
+        RenderThreadPending = false;
+    }
+}
+
+void VCount144()
+{
+    FinishRendering();
+}
+
+void DoSavestate(Savestate* file)
+{
+    // the frame being shown. rendering it again after loading wouldn't work,
+    // VRAM might have changed since it was rendered
+    for (int y = 0; y < 192; y++)
+        file->VarArray(&ColorBuffer[(y * ScanlineWidth) + FirstPixelOffset], 256*4);
+
+    if (!file->Saving && RenderThreadRunning)
+    {
+        // the lines that are still to be shown are all there
+        int lines = 0;
+        if (GPU::VCount < 192)       lines = 192 - GPU::VCount;
+        else if (GPU::VCount >= 215) lines = 192;
+
+        Platform::Semaphore_Reset(Sema_ScanlineCount);
+        for (int i = 0; i < lines; i++)
+            Platform::Semaphore_Post(Sema_ScanlineCount);
+    }
 }
 
 void RenderFrame()
 {
     if (RenderThreadRunning)
     {
+        RenderThreadPending = true;
         Platform::Semaphore_Post(Sema_RenderStart);
     }
     else
@@ -2097,12 +2130,10 @@ void RenderThreadFunc()
         Platform::Semaphore_Wait(Sema_RenderStart);
         if (!RenderThreadRunning) return;
 
-        RenderThreadRendering = true;
         ClearBuffers();
         RenderPolygons(true, &RenderPolygonRAM[0], RenderNumPolygons);
 
         Platform::Semaphore_Post(Sema_RenderDone);
-        RenderThreadRendering = false;
     }
 }
 
@@ -0,0 +1,587 @@
+/*
+    Copyright 2016-2019 StapleButter
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "NDS.h"
+#include "IdleLoop.h"
+
+
+namespace IdleLoop
+{
+
+const u32 kMaxLoads = kMaxLoopSize / 2;
+const u8 kAbsolute = 0xFF; // load from a fixed address (PC-relative)
+
+struct Load
+{
+    u8 Base;
+    u8 Size;
+    u32 Offset;
+};
+
+// what the CPU looked like when getting back to the start of the loop
+struct LoopState
+{
+    u32 Regs[15];
+    u32 CPSR;
+    u32 Values[kMaxLoads];  // what the loads return
+};
+
+// the loop a CPU is currently sitting in, if any
+struct Watch
+{
+    u32 Start, End;     // first instruction, branch back to it
+    bool Thumb;
+    u32 Code[kMaxLoopSize / 4 + 1];
+
+    bool Allowed;       // only does things we can skip
+    u32 NumLoads;
+    Load Loads[kMaxLoads];
+
+    // last time around
+    bool PrevValid;
+    u32 PrevRun;
+    u64 PrevTimestamp;
+    u32 PrevCache;
+    LoopState Prev;
+
+    // a state that was seen to lead back to itself, in that many cycles.
+    // if the CPU is in that state again and memory still reads the same,
+    // the loop is going to go around until the end of the run
+    bool Idle;
+    u64 Cost;
+    u32 IdleCache;
+    LoopState IdleState;
+};
+
+Watch Watches[2];
+
+bool TitleAllowed;
+
+u32 RunCount[2];
+
+u64 SkippedCycles[2];
+
+
+void Reset()
+{
+    memset(Watches, 0, sizeof(Watches));
+    Watches[0].Start = 0xFFFFFFFF;
+    Watches[1].Start = 0xFFFFFFFF;
+
+    RunCount[0] = 0;
+    RunCount[1] = 0;
+
+    SkippedCycles[0] = 0;
+    SkippedCycles[1] = 0;
+}
+
+void SetTitle(u32 gamecode)
+{
+    TitleAllowed = false;
+
+    // list of gamecodes, separated by whatever isn't a letter or digit
+    const char* list = Config::IdleLoopTitles;
+    int len = 0;
+    for (int i = 0; ; i++)
+    {
+        char c = list[i];
+        bool alnum = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+
+        if (alnum)
+        {
+            len++;
+            continue;
+        }
+
+        if (len == 4)
+        {
+            const char* code = &list[i-4];
+            u32 val = code[0] | (code[1] << 8) | (code[2] << 16) | (code[3] << 24);
+            if (val == gamecode) TitleAllowed = true;
+        }
+
+        len = 0;
+        if (!c) break;
+    }
+
+    if (TitleAllowed)
+        printf("IdleLoop: %c%c%c%c is allowlisted\n", gamecode&0xFF, (gamecode>>8)&0xFF, (gamecode>>16)&0xFF, gamecode>>24);
+}
+
+
+// plain code fetch, no timings/cache/etc
+bool FetchCode(ARM* cpu, u32 addr, u32* val)
+{
+    addr &= ~0x3;
+
+    if (cpu->Num == 0)
+    {
+        ARMv5* cpu9 = (ARMv5*)cpu;
+        if (addr < cpu9->ITCMSize)
+        {
+            *val = *(u32*)&cpu9->ITCM[addr & 0x7FFF];
+            return true;
+        }
+    }
+
+    if (addr >= 0x10000000) return false;
+
+    NDS::MemPage& page = (cpu->Num ? NDS::ARM7ReadMap : NDS::ARM9ReadMap)[addr >> 14];
+    if (!page.Mem) return false;
+
+    *val = *(u32*)&page.Mem[addr & page.Mask];
+    return true;
+}
+
+// I/O registers that just return a variable, which only changes outside of
+// the CPU's run (or when the CPU itself writes something)
+bool IsSafeIORead(u32 num, u32 addr, u32 size)
+{
+    switch (size)
+    {
+    case 8:
+        if (addr >= 0x04000130 && addr < 0x04000134) return true;
+        if (num == 1 && (addr == 0x04000136 || addr == 0x04000137)) return true;
+        return addr == 0x04000208;
+
+    case 16:
+        switch (addr)
+        {
+        case 0x04000004: // DISPSTAT
+        case 0x04000006: // VCOUNT
+        case 0x04000130: // KEYINPUT
+        case 0x04000132:
+        case 0x04000180: // IPCSYNC
+        case 0x04000184: // IPCFIFOCNT
+        case 0x04000208: // IME
+        case 0x04000210: // IE
+        case 0x04000212:
+            return true;
+        case 0x04000134:
+        case 0x04000136:
+            return num == 1;
+        }
+        return false;
+
+    case 32:
+        switch (addr)
+        {
+        case 0x04000004:
+        case 0x04000130:
+        case 0x04000180:
+        case 0x04000208:
+        case 0x04000210:
+        case 0x04000214: // IF
+            return true;
+        case 0x04000134:
+            return num == 1;
+        }
+        return false;
+    }
+
+    return false;
+}
+
+bool IsSafeRead(ARM* cpu, u32 addr, u32 size)
+{
+    addr &= ~((size >> 3) - 1);
+
+    if (cpu->Num == 0)
+    {
+        ARMv5* cpu9 = (ARMv5*)cpu;
+        if (addr < cpu9->ITCMSize) return true;
+        if (addr >= cpu9->DTCMBase && addr < (cpu9->DTCMBase + cpu9->DTCMSize)) return true;
+    }
+
+    if (addr >= 0x10000000) return false;
+
+    NDS::MemPage& page = (cpu->Num ? NDS::ARM7ReadMap : NDS::ARM9ReadMap)[addr >> 14];
+    if (page.Mem) return true;
+
+    return IsSafeIORead(cpu->Num, addr, size);
+}
+
+
+// these return false for anything that isn't a load or an ALU op without
+// side effects. written is the set of registers the instruction changes.
+
+bool DecodeARM(Watch& w, u32 instr, u32 addr, u16* written)
+{
+    if ((instr >> 28) == 0xF) return false;
+
+    u32 rd = (instr >> 12) & 0xF;
+
+    switch ((instr >> 25) & 0x7)
+    {
+    case 0x0:
+        if ((instr & 0x90) == 0x90)
+        {
+            // LDRH/LDRSB/LDRSH, immediate offset, no writeback
+            // (multiplies/SWP/stores/LDRD aren't worth the trouble)
+            if ((instr & 0x60) == 0) return false;
+            if ((instr & 0x01700000) != 0x01500000) return false;
+            if (rd == 15) return false;
+
+            Load& load = w.Loads[w.NumLoads++];
+            u32 offset = ((instr >> 4) & 0xF0) | (instr & 0xF);
+            load.Base = (instr >> 16) & 0xF;
+            load.Offset = (instr & (1<<23)) ? offset : -offset;
+            load.Size = ((instr & 0x60) == 0x40) ? 8 : 16;
+            if (load.Base == 15)
+            {
+                load.Base = kAbsolute;
+                load.Offset += addr + 8;
+            }
+
+            *written |= (1 << rd);
+            return true;
+        }
+        // fallthrough
+
+    case 0x1:
+        {
+            // MRS/MSR/BX/CLZ/etc
+            if ((instr & 0x01900000) == 0x01000000) return false;
+            if (rd == 15) return false;
+
+            u32 op = (instr >> 21) & 0xF;
+            if (op < 0x8 || op > 0xB)
+                *written |= (1 << rd);
+        }
+        return true;
+
+    case 0x2:
+        {
+            // LDR/LDRB, immediate offset, no writeback
+            if ((instr & 0x01300000) != 0x01100000) return false;
+            if (rd == 15) return false;
+
+            Load& load = w.Loads[w.NumLoads++];
+            u32 offset = instr & 0xFFF;
+            load.Base = (instr >> 16) & 0xF;
+            load.Offset = (instr & (1<<23)) ? offset : -offset;
+            load.Size = (instr & (1<<22)) ? 8 : 32;
+            if (load.Base == 15)
+            {
+                load.Base = kAbsolute;
+                load.Offset += addr + 8;
+            }
+
+            *written |= (1 << rd);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool DecodeTHUMB(Watch& w, u16 instr, u32 addr, u16* written)
+{
+    switch (instr >> 11)
+    {
+    case 0x00: case 0x01: case 0x02: // shift by immediate
+    case 0x03:                       // ADD/SUB
+    case 0x08: // ALU ops
+        if ((instr >> 10) == 0x11) break;
+        *written |= (1 << (instr & 0x7));
+        return true;
+
+    case 0x04: case 0x05: case 0x06: case 0x07: // MOV/CMP/ADD/SUB immediate
+    case 0x14: case 0x15:                       // ADD Rd, PC/SP
+        *written |= (1 << ((instr >> 8) & 0x7));
+        return true;
+
+    case 0x09: // LDR PC-relative
+        {
+            Load& load = w.Loads[w.NumLoads++];
+            load.Base = kAbsolute;
+            load.Offset = ((addr + 4) & ~0x2) + ((instr & 0xFF) << 2);
+            load.Size = 32;
+            *written |= (1 << ((instr >> 8) & 0x7));
+        }
+        return true;
+
+    case 0x0D: // LDR immediate
+    case 0x0F: // LDRB immediate
+    case 0x11: // LDRH immediate
+        {
+            Load& load = w.Loads[w.NumLoads++];
+            u32 offset = (instr >> 6) & 0x1F;
+            load.Base = (instr >> 3) & 0x7;
+            if      ((instr >> 11) == 0x0D) { load.Offset = offset << 2; load.Size = 32; }
+            else if ((instr >> 11) == 0x0F) { load.Offset = offset;      load.Size = 8; }
+            else                            { load.Offset = offset << 1; load.Size = 16; }
+            *written |= (1 << (instr & 0x7));
+        }
+        return true;
+
+    case 0x13: // LDR SP-relative
+        {
+            Load& load = w.Loads[w.NumLoads++];
+            load.Base = 13;
+            load.Offset = (instr & 0xFF) << 2;
+            load.Size = 32;
+            *written |= (1 << ((instr >> 8) & 0x7));
+        }
+        return true;
+
+    case 0x16: // ADD SP, immediate
+        if ((instr & 0xFF00) != 0xB000) return false;
+        *written |= (1 << 13);
+        return true;
+    }
+
+    if ((instr & 0xFC00) == 0x4400)
+    {
+        // hi register ops. no BX, nothing that writes PC
+        u32 op = (instr >> 8) & 0x3;
+        u32 rd = (instr & 0x7) | ((instr >> 4) & 0x8);
+        if (op == 3) return false;
+        if (op != 1)
+        {
+            if (rd == 15) return false;
+            *written |= (1 << rd);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool IsBranchTo(u32 instr, u32 addr, bool thumb, u32 target)
+{
+    if (thumb)
+    {
+        u16 t = instr;
+        if ((t & 0xF000) == 0xD000 && ((t >> 8) & 0xF) < 0xE)
+            return (addr + 4 + ((s32)(t << 24) >> 23)) == target;
+        if ((t & 0xF800) == 0xE000)
+            return (addr + 4 + ((s32)((t & 0x7FF) << 21) >> 20)) == target;
+        return false;
+    }
+    else
+    {
+        if ((instr >> 28) == 0xF) return false;
+        if ((instr & 0x0F000000) != 0x0A000000) return false;
+        return (addr + 8 + ((s32)(instr << 8) >> 6)) == target;
+    }
+}
+
+bool Analyze(ARM* cpu, Watch& w)
+{
+    u32 step = w.Thumb ? 2 : 4;
+    u16 written = 0;
+
+    w.NumLoads = 0;
+
+    for (u32 addr = w.Start; addr <= w.End; addr += step)
+    {
+        u32 instr;
+        if (!FetchCode(cpu, addr, &instr)) return false;
+        w.Code[(addr >> 2) - (w.Start >> 2)] = instr;
+        if (w.Thumb && (addr & 0x2)) instr >>= 16;
+
+        if (addr == w.End)
+        {
+            if (!IsBranchTo(instr, addr, w.Thumb, w.Start)) return false;
+
+            // the addresses have to stay the same every time around
+            for (u32 i = 0; i < w.NumLoads; i++)
+            {
+                u8 base = w.Loads[i].Base;
+                if (base != kAbsolute && (written & (1 << base))) return false;
+            }
+            return true;
+        }
+
+        bool ok = w.Thumb ? DecodeTHUMB(w, instr & 0xFFFF, addr, &written)
+                          : DecodeARM(w, instr, addr, &written);
+        if (!ok) return false;
+    }
+
+    return false;
+}
+
+bool CodeChanged(ARM* cpu, Watch& w)
+{
+    for (u32 addr = w.Start & ~0x3; addr <= w.End; addr += 4)
+    {
+        u32 instr;
+        if (!FetchCode(cpu, addr, &instr)) return true;
+        if (instr != w.Code[(addr >> 2) - (w.Start >> 2)]) return true;
+    }
+
+    return false;
+}
+
+u32 LoadAddr(ARM* cpu, Load& load)
+{
+    u32 addr = load.Offset;
+    if (load.Base != kAbsolute) addr += cpu->R[load.Base];
+    return addr & ~((load.Size >> 3) - 1);
+}
+
+u32 ReadValue(ARM* cpu, u32 addr, u32 size)
+{
+    if (cpu->Num == 0)
+    {
+        ARMv5* cpu9 = (ARMv5*)cpu;
+        u8* mem = NULL;
+        if (addr < cpu9->ITCMSize)
+            mem = &cpu9->ITCM[addr & 0x7FFF];
+        else if (addr >= cpu9->DTCMBase && addr < (cpu9->DTCMBase + cpu9->DTCMSize))
+            mem = &cpu9->DTCM[(addr - cpu9->DTCMBase) & 0x3FFF];
+
+        if (mem)
+        {
+            if (size == 8)  return *(u8*)mem;
+            if (size == 16) return *(u16*)mem;
+            return *(u32*)mem;
+        }
+
+        if (size == 8)  return NDS::ARM9Read8(addr);
+        if (size == 16) return NDS::ARM9Read16(addr);
+        return NDS::ARM9Read32(addr);
+    }
+    else
+    {
+        if (size == 8)  return NDS::ARM7Read8(addr);
+        if (size == 16) return NDS::ARM7Read16(addr);
+        return NDS::ARM7Read32(addr);
+    }
+}
+
+// false if the loads can't be done without side effects
+bool ReadLoads(ARM* cpu, Watch& w, u32* values)
+{
+    for (u32 i = 0; i < w.NumLoads; i++)
+    {
+        u32 addr = LoadAddr(cpu, w.Loads[i]);
+        if (!IsSafeRead(cpu, addr, w.Loads[i].Size)) return false;
+
+        values[i] = ReadValue(cpu, addr, w.Loads[i].Size);
+    }
+
+    return true;
+}
+
+// the ARM9's instruction cache changes how long the loop takes. it only
+// takes the same time every time around if nothing was filled or
+// invalidated in the meantime
+u32 CacheVersion(ARM* cpu)
+{
+    if (cpu->Num) return 0;
+    return ((ARMv5*)cpu)->CacheVersion;
+}
+
+bool SameState(ARM* cpu, LoopState& state)
+{
+    return !memcmp(state.Regs, cpu->R, sizeof(state.Regs)) && state.CPSR == cpu->CPSR;
+}
+
+void Skip(ARM* cpu, Watch& w)
+{
+    u64& timestamp = cpu->Num ? NDS::ARM7Timestamp : NDS::ARM9Timestamp;
+    u64 target = cpu->Num ? NDS::ARM7Target : NDS::ARM9Target;
+
+    // the CPU stops once it's past the target, which can be in the middle
+    // of an iteration. skip as many whole iterations as possible without
+    // getting there, the rest runs normally
+    if (w.Cost && (timestamp + w.Cost) < target)
+    {
+        u64 skip = ((target - timestamp - 1) / w.Cost) * w.Cost;
+        timestamp += skip;
+        SkippedCycles[cpu->Num] += skip;
+    }
+}
+
+void Visit(ARM* cpu, u32 addr)
+{
+    Watch& w = Watches[cpu->Num];
+    u32 run = RunCount[cpu->Num];
+
+    // the flags are part of the state that has to match
+    cpu->UpdateNZ();
+
+    bool thumb = (cpu->CPSR & 0x20) != 0;
+    u32 start = addr & ~0x1;
+    u32 end = cpu->R[15] - (thumb ? 4 : 8);
+
+    if (start != w.Start || end != w.End || thumb != w.Thumb ||
+        (run != w.PrevRun && w.Allowed && CodeChanged(cpu, w)))
+    {
+        // new loop (or the old one was overwritten while we weren't looking)
+        w.Start = start;
+        w.End = end;
+        w.Thumb = thumb;
+        w.Allowed = ((addr & 0x1) == (thumb ? 1 : 0)) && Analyze(cpu, w);
+        w.PrevValid = false;
+        w.Idle = false;
+    }
+
+    if (!w.Allowed) return;
+
+    u64 timestamp = cpu->Num ? NDS::ARM7Timestamp : NDS::ARM9Timestamp;
+    u32 cache = CacheVersion(cpu);
+    u32 values[kMaxLoads];
+
+    // an IRQ can only be pending right when the CPU starts running, it's
+    // going to be taken after this instruction
+    if (cpu->IRQPending() || !ReadLoads(cpu, w, values))
+    {
+        w.PrevValid = false;
+        w.PrevRun = run;
+        return;
+    }
+
+    if (w.Idle && w.IdleCache == cache && SameState(cpu, w.IdleState) &&
+        !memcmp(values, w.IdleState.Values, w.NumLoads * sizeof(u32)))
+    {
+        w.PrevValid = false;
+        w.PrevRun = run;
+        Skip(cpu, w);
+        return;
+    }
+
+    // nothing else runs while the CPU does, so if it went all the way around
+    // in this run and came back in the same state, it has found a state that
+    // leads back to itself
+    if (w.PrevValid && w.PrevRun == run && w.PrevCache == cache && SameState(cpu, w.Prev))
+    {
+        w.Idle = true;
+        w.Cost = timestamp - w.PrevTimestamp;
+        w.IdleCache = cache;
+        memcpy(&w.IdleState, &w.Prev, sizeof(LoopState));
+        memcpy(w.IdleState.Values, values, w.NumLoads * sizeof(u32));
+
+        w.PrevValid = false;
+        Skip(cpu, w);
+        return;
+    }
+
+    w.PrevValid = true;
+    w.PrevRun = run;
+    w.PrevTimestamp = timestamp;
+    w.PrevCache = cache;
+    memcpy(w.Prev.Regs, cpu->R, sizeof(w.Prev.Regs));
+    w.Prev.CPSR = cpu->CPSR;
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+    Copyright 2016-2019 StapleButter
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef IDLELOOP_H
+#define IDLELOOP_H
+
+#include "types.h"
+#include "ARM.h"
+#include "Config.h"
+
+// idle loop skipping
+//
+// lots of games wait for VCOUNT, an IPC flag or an IRQ flag word by polling
+// it in a tight loop instead of halting. within one run of a CPU (until
+// ARMxTarget) nothing but that CPU can change what it's polling: events,
+// DMA and the other CPU only run between runs. so once such a loop has gone
+// around and come back with the exact same registers, it's going to keep
+// doing that until the target, and we can just add up those iterations
+// instead of running them. later runs can skip right away as long as the
+// registers and the polled values are still the same.
+//
+// the loop has to be a short backwards branch whose body only does loads
+// from memory or from I/O registers that are known to have no side effects,
+// and ALU ops. it comes out cycle exact.
+
+namespace IdleLoop
+{
+
+// loops longer than this aren't considered
+const u32 kMaxLoopSize = 0x40;
+
+extern bool TitleAllowed;
+
+extern u32 RunCount[2];
+
+extern u64 SkippedCycles[2];
+
+void Reset();
+
+// gamecode as read from the ROM header, checked against the allowlist
+void SetTitle(u32 gamecode);
+
+void Visit(ARM* cpu, u32 addr);
+
+// called when a CPU starts running. loops are only trusted once they've
+// been seen going around within one run
+inline void NewRun(u32 num)
+{
+    RunCount[num]++;
+}
+
+inline bool Enabled()
+{
+    // with the ARM7 thread, the other CPU does run at the same time
+    if (NDS::ThreadedSlice) return false;
+
+    return Config::IdleLoopSkip == 2 || (Config::IdleLoopSkip == 1 && TitleAllowed);
+}
+
+// called by JumpTo() before anything is changed
+inline void CheckBranch(ARM* cpu, u32 addr)
+{
+    // (if it's a forward jump this wraps around)
+    if ((cpu->R[15] - (addr & ~0x1)) > kMaxLoopSize) return;
+    if (!Enabled()) return;
+
+    Visit(cpu, addr);
+}
+
+}
+
+#endif // IDLELOOP_H
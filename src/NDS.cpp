@@ -18,9 +18,16 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
 #include "Config.h"
 #include "NDS.h"
 #include "ARM.h"
+#include "ARMJIT.h"
+#include "FastMem.h"
+#include "IdleLoop.h"
 #include "NDSCart.h"
 #include "DMA.h"
 #include "FIFO.h"
@@ -29,6 +36,7 @@
 #include "SPI.h"
 #include "RTC.h"
 #include "Wifi.h"
+#include "CRC32.h"
 #include "Platform.h"
 #include "melon_fopen.h"
 
@@ -65,13 +73,66 @@ ARMv5* ARM9;
 ARMv4* ARM7;
 
 u32 NumFrames;
+u32 Speculative;
 u64 LastSysClockCycles;
 u64 FrameStartTimestamp;
 
-int CurCPU;
+// the ARM7 thread has its own
+thread_local int CurCPU;
 
 const s32 kMaxIterationCycles = 16;
 
+// while the ARM9 is stuck on a full GXFIFO, nothing but the scheduler can
+// happen before the 3D engine drains it, so slices can be this long
+const s32 kMaxStallCycles = 0x10000;
+
+// ARM7 thread
+//
+// with Config::ThreadedARM7, the ARM7 runs on its own thread while the ARM9
+// runs, in slices of up to Config::ARM7SkewCycles. as soon as it gets to
+// anything the ARM9 could see or change (I/O, IRQs, DMA, the scheduler,
+// checking whether it's still halted), it waits for the ARM9 to be done with
+// the slice, so all that happens in the same order as when they run one
+// after the other (see SyncCPUs()).
+// the ARM9 never waits for that, it's like it ran the whole slice first. but
+// before it touches what the ARM7 is using (remapping shared WRAM or VRAM,
+// writing to shared WRAM, the ARM7's IRQs, the end of its slice), it waits
+// for the ARM7 to be either done or waiting on it (see SyncARM7()).
+// main RAM isn't covered: a CPU can see the other's writes there up to a
+// slice early or late. that makes it nondeterministic, and setting
+// ThreadedARM7 to 2 checks every frame against a single-threaded run of it.
+// the JIT isn't thread safe, so this is only used with it off.
+
+enum
+{
+    ARM7Cmd_Idle = 0,
+    ARM7Cmd_RunSlice,
+    ARM7Cmd_EndFrame,
+};
+
+void* ARM7Thread;
+bool ARM7ThreadRunning;
+void* Sema_ARM7Start;
+std::atomic<u32> ARM7Command;
+std::atomic<u64> ARM7SliceTarget;
+
+bool ThreadedSlice;
+std::atomic<bool> ARM9SliceDone;
+std::atomic<bool> ARM7Parked; // done with the slice, or waiting on the ARM9
+
+std::vector<u8> CheckState;
+
+FrameStats Stats; // the frame being ran
+FrameStats LastFrameStats;
+u64 ProfileTimestamp;
+
+const char* EventNames[Event_MAX] =
+{
+    "LCD", "SPU", "Wifi",
+    "DisplayFIFO", "ROMTransfer", "ROMSPITransfer", "SPITransfer", "Div", "Sqrt",
+    "Timer0", "Timer1", "Timer2", "Timer3", "Timer4", "Timer5", "Timer6", "Timer7"
+};
+
 u32 ARM9ClockShift;
 
 // no need to worry about those overflowing, they can keep going for atleast 4350 years
@@ -80,23 +141,39 @@ u64 ARM7Timestamp, ARM7Target;
 u64 SysTimestamp;
 
 SchedEvent SchedList[Event_MAX];
-u32 SchedListMask;
+
+// the scheduled events, as a binary min-heap ordered by timestamp then ID,
+// so that finding the next one doesn't depend on how many events there are.
+// SchedEvent::Scheduled is still what says whether an event is scheduled
+u8 SchedHeap[Event_MAX];
+u32 SchedHeapLen;
+u8 SchedHeapPos[Event_MAX];
+u64 SchedNextTimestamp;
 
 u32 CPUStop;
 
 u8 ARM9BIOS[0x1000];
 u8 ARM7BIOS[0x4000];
 
-u8 MainRAM[MAIN_RAM_SIZE];
+// page aligned so that fastmem can map them elsewhere
+alignas(0x1000) u8 MainRAM[MAIN_RAM_SIZE];
 
-u8 SharedWRAM[0x8000];
+alignas(0x1000) u8 SharedWRAM[0x8000];
 u8 WRAMCnt;
 u8* SWRAM_ARM9;
 u8* SWRAM_ARM7;
 u32 SWRAM_ARM9Mask;
 u32 SWRAM_ARM7Mask;
 
-u8 ARM7WRAM[0x10000];
+alignas(0x1000) u8 ARM7WRAM[0x10000];
+
+// read page tables
+// each 16KB page of 0x00000000-0x0FFFFFFF points to the memory backing it,
+// when it's something that can be read directly. everything else (I/O,
+// BIOS, GBA slot, VRAM pages with zero or several banks mapped) is NULL
+// and goes through the regular address decoding
+MemPage ARM9ReadMap[0x4000];
+MemPage ARM7ReadMap[0x4000];
 
 u16 ExMemCnt[2];
 
@@ -148,8 +225,12 @@ bool Running;
 void DivDone(u32 param);
 void SqrtDone(u32 param);
 void RunTimer(u32 tid, s32 cycles);
+void TimerOverflowEvent(u32 tid);
+void ScheduleTimerOverflow(u32 tid);
 void SetWifiWaitCnt(u16 val);
 void SetGBASlotTimings();
+void RebuildSchedHeap();
+void StopARM7Thread();
 
 
 bool Init()
@@ -169,6 +250,12 @@ bool Init()
     IPCFIFO9 = new FIFO<u32>(16);
     IPCFIFO7 = new FIFO<u32>(16);
 
+    Sema_ARM7Start = Platform::Semaphore_Create();
+    ARM7ThreadRunning = false;
+    ARM7Command = ARM7Cmd_Idle;
+    ThreadedSlice = false;
+
+    if (!ARMJIT::Init()) return false;
     if (!NDSCart::Init()) return false;
     if (!GPU::Init()) return false;
     if (!SPU::Init()) return false;
@@ -181,6 +268,9 @@ bool Init()
 
 void DeInit()
 {
+    StopARM7Thread();
+    Platform::Semaphore_Free(Sema_ARM7Start);
+
     delete ARM9;
     delete ARM7;
 
@@ -190,6 +280,8 @@ void DeInit()
     delete IPCFIFO9;
     delete IPCFIFO7;
 
+    ARMJIT::DeInit();
+    FastMem::DeInit();
     NDSCart::DeInit();
     GPU::DeInit();
     SPU::DeInit();
@@ -472,6 +564,8 @@ void Reset()
 
     ARM9->Reset();
     ARM7->Reset();
+    ARMJIT::Reset();
+    IdleLoop::Reset();
 
     CPUStop = 0;
 
@@ -485,7 +579,7 @@ void Reset()
     memset(DMA9Fill, 0, 4*4);
 
     memset(SchedList, 0, sizeof(SchedList));
-    SchedListMask = 0;
+    RebuildSchedHeap();
 
     KeyInput = 0x007F03FF;
     KeyCnt = 0;
@@ -497,6 +591,8 @@ void Reset()
     SPI::Reset();
     RTC::Reset();
     Wifi::Reset();
+
+    RemapPages(0, 0x10000000);
 }
 
 void Stop()
@@ -533,10 +629,13 @@ bool DoSavestate_Scheduler(Savestate* file)
         DivDone,
         SqrtDone,
 
+        TimerOverflowEvent,
+
         NULL
     };
 
-    int len = Event_MAX;
+    // the timer events came after that
+    int len = file->IsAtleastVersion(4, 4) ? Event_MAX : Event_Timer0;
     if (file->Saving)
     {
         for (int i = 0; i < len; i++)
@@ -564,6 +663,7 @@ bool DoSavestate_Scheduler(Savestate* file)
             file->Var32(&funcid);
             file->Var64(&evt->Timestamp);
             file->Var32(&evt->Param);
+            file->Var8(&evt->Scheduled);
         }
     }
     else
@@ -594,6 +694,10 @@ bool DoSavestate_Scheduler(Savestate* file)
 
             file->Var64(&evt->Timestamp);
             file->Var32(&evt->Param);
+
+            // older savestates have one bit per event in NDS::DoSavestate()
+            if (file->IsAtleastVersion(4, 3))
+                file->Var8(&evt->Scheduled);
         }
     }
 
@@ -604,9 +708,9 @@ bool DoSavestate(Savestate* file)
 {
     file->Section("NDSG");
 
-    file->VarArray(MainRAM, 0x400000);
-    file->VarArray(SharedWRAM, 0x8000);
-    file->VarArray(ARM7WRAM, 0x10000);
+    ARMJIT::DoSavestateCode(file, ARMJIT::CodeSpace_MainRAM, MainRAM, 0x400000);
+    ARMJIT::DoSavestateCode(file, ARMJIT::CodeSpace_SWRAM, SharedWRAM, 0x8000);
+    ARMJIT::DoSavestateCode(file, ARMJIT::CodeSpace_ARM7WRAM, ARM7WRAM, 0x10000);
 
     file->VarArray(ExMemCnt, 2*sizeof(u16));
     file->VarArray(ROMSeed0, 2*8);
@@ -652,7 +756,33 @@ bool DoSavestate(Savestate* file)
     file->VarArray(DMA9Fill, 4*sizeof(u32));
 
     if (!DoSavestate_Scheduler(file)) return false;
-    file->Var32(&SchedListMask);
+    if (!file->Saving)
+    {
+        if (!file->IsAtleastVersion(4, 3))
+        {
+            u32 mask;
+            file->Var32(&mask);
+            for (int i = 0; i < Event_MAX; i++)
+                SchedList[i].Scheduled = (i < 32) && (mask & (1<<i));
+        }
+
+        // older savestates don't have the timer events, they're made up
+        // from the timers themselves
+        bool notimerevents = !file->IsAtleastVersion(4, 4);
+        if (notimerevents)
+        {
+            for (int i = Event_Timer0; i < Event_MAX; i++)
+                memset(&SchedList[i], 0, sizeof(SchedEvent));
+        }
+
+        RebuildSchedHeap();
+
+        if (notimerevents)
+        {
+            for (int i = 0; i < 8; i++)
+                ScheduleTimerOverflow(i);
+        }
+    }
     file->Var64(&ARM9Timestamp);
     file->Var64(&ARM9Target);
     file->Var64(&ARM7Timestamp);
@@ -670,13 +800,17 @@ bool DoSavestate(Savestate* file)
     for (int i = 0; i < 8; i++)
         DMAs[i]->DoSavestate(file);
 
+    u8 oldwramcnt = WRAMCnt;
     file->Var8(&WRAMCnt);
 
     if (!file->Saving)
     {
         // 'dept of redundancy dept'
-        // but we do need to update the mappings
-        MapSharedWRAM(WRAMCnt);
+        // but we do need to update the mappings. and to know whether it
+        // changed, compiled code depends on it
+        u8 newwramcnt = WRAMCnt;
+        WRAMCnt = oldwramcnt;
+        MapSharedWRAM(newwramcnt);
     }
 
     if (!file->Saving)
@@ -692,6 +826,13 @@ bool DoSavestate(Savestate* file)
     ARM9->DoSavestate(file);
     ARM7->DoSavestate(file);
 
+    if (!file->Saving && !file->SameSession)
+    {
+        // memory contents changed under our feet. with a state from this
+        // session, only the code that changed was thrown out
+        ARMJIT::InvalidateAll();
+    }
+
     NDSCart::DoSavestate(file);
     GPU::DoSavestate(file);
     SPU::DoSavestate(file);
@@ -702,6 +843,10 @@ bool DoSavestate(Savestate* file)
     if (!file->Saving)
     {
         GPU::SetPowerCnt(PowerControl9);
+        RemapPages(0, 0x10000000);
+
+        if (file->SameSession)
+            ARMJIT::InvalidateStaleICache(ARM9);
     }
 
     return true;
@@ -735,23 +880,122 @@ void RelocateSave(const char* path, bool write)
 
 
 
-u64 NextTarget()
+bool SchedBefore(u32 a, u32 b)
 {
-    u64 ret = SysTimestamp + kMaxIterationCycles;
+    if (SchedList[a].Timestamp != SchedList[b].Timestamp)
+        return SchedList[a].Timestamp < SchedList[b].Timestamp;
+    return a < b;
+}
 
-    u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
+void SchedHeapSet(u32 pos, u32 id)
+{
+    SchedHeap[pos] = id;
+    SchedHeapPos[id] = pos;
+}
+
+void SchedHeapUp(u32 pos)
+{
+    u32 id = SchedHeap[pos];
+    while (pos > 0)
     {
-        if (!mask) break;
-        if (mask & 0x1)
-        {
-            if (SchedList[i].Timestamp < ret)
-                ret = SchedList[i].Timestamp;
-        }
+        u32 parent = (pos - 1) >> 1;
+        if (!SchedBefore(id, SchedHeap[parent])) break;
+
+        SchedHeapSet(pos, SchedHeap[parent]);
+        pos = parent;
+    }
+    SchedHeapSet(pos, id);
+}
+
+void SchedHeapDown(u32 pos)
+{
+    u32 id = SchedHeap[pos];
+    for (;;)
+    {
+        u32 child = (pos << 1) + 1;
+        if (child >= SchedHeapLen) break;
+        if ((child + 1) < SchedHeapLen && SchedBefore(SchedHeap[child + 1], SchedHeap[child]))
+            child++;
+        if (!SchedBefore(SchedHeap[child], id)) break;
+
+        SchedHeapSet(pos, SchedHeap[child]);
+        pos = child;
+    }
+    SchedHeapSet(pos, id);
+}
+
+void UpdateSchedNext()
+{
+    SchedNextTimestamp = SchedHeapLen ? SchedList[SchedHeap[0]].Timestamp : 0xFFFFFFFFFFFFFFFFULL;
+}
+
+void SchedHeapInsert(u32 id)
+{
+    SchedHeapSet(SchedHeapLen, id);
+    SchedHeapUp(SchedHeapLen++);
+    UpdateSchedNext();
+}
+
+void SchedHeapRemove(u32 id)
+{
+    u32 pos = SchedHeapPos[id];
+    u32 last = SchedHeap[--SchedHeapLen];
+    if (pos < SchedHeapLen)
+    {
+        SchedHeapSet(pos, last);
+        SchedHeapUp(pos);
+        SchedHeapDown(SchedHeapPos[last]);
+    }
+    UpdateSchedNext();
+}
+
+void RebuildSchedHeap()
+{
+    SchedHeapLen = 0;
+    for (u32 i = 0; i < Event_MAX; i++)
+    {
+        if (SchedList[i].Scheduled)
+            SchedHeapInsert(i);
+    }
+    UpdateSchedNext();
+}
 
-        mask >>= 1;
+// which events are due at the given time, in ID order. the heap is only
+// walked as far as there are due events in it
+u32 GetDueEvents(u64 timestamp, u8* due)
+{
+    u32 num = 0;
+    u8 stack[Event_MAX];
+    u32 sp = 0;
+
+    if (SchedHeapLen) stack[sp++] = 0;
+    while (sp)
+    {
+        u32 pos = stack[--sp];
+        u32 id = SchedHeap[pos];
+        if (SchedList[id].Timestamp > timestamp) continue;
+
+        // there are rarely more than a couple
+        u32 i = num++;
+        for (; i > 0 && due[i-1] > id; i--)
+            due[i] = due[i-1];
+        due[i] = id;
+
+        u32 child = (pos << 1) + 1;
+        if (child < SchedHeapLen) stack[sp++] = child;
+        if ((child + 1) < SchedHeapLen) stack[sp++] = child + 1;
     }
 
+    return num;
+}
+
+u64 NextTarget(s32 maxcycles)
+{
+    u64 ret = SysTimestamp + maxcycles;
+
+    if (SchedNextTimestamp < ret)
+        ret = SchedNextTimestamp;
+
     return ret;
 }
 
@@ -759,24 +1003,208 @@ void RunSystem(u64 timestamp)
 {
     SysTimestamp = timestamp;
 
-    u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
+    if (SchedNextTimestamp > SysTimestamp)
+        return;
+
+    // events that were due when we got here run in ID order, whatever the
+    // ones before them do
+    u8 due[Event_MAX];
+    u32 numdue = GetDueEvents(SysTimestamp, due);
+    for (u32 n = 0; n < numdue; n++)
+    {
+        u32 i = due[n];
+        if (SchedList[i].Timestamp <= SysTimestamp)
+        {
+            if (SchedList[i].Scheduled)
+            {
+                SchedList[i].Scheduled = 0;
+                SchedHeapRemove(i);
+            }
+            Stats.Events[i]++;
+            SchedList[i].Func(SchedList[i].Param);
+        }
+    }
+}
+
+u64 GetHostTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// adds the host time since the last call to the given counter
+void ProfilePhase(u64& counter)
+{
+    u64 now = GetHostTime();
+    counter += now - ProfileTimestamp;
+    ProfileTimestamp = now;
+}
+
+void RunDMA(u32 num)
+{
+    u64& timestamp = (num < 4) ? ARM9Timestamp : ARM7Timestamp;
+    u64 start = timestamp;
+
+    DMAs[num]->Run();
+
+    Stats.DMACycles[num] += timestamp - start;
+}
+
+void RunARM7(u64 target)
+{
+    ARM7Target = target;
+
+    if (CPUStop & 0x0FFF0000)
+    {
+        RunDMA(4);
+        RunDMA(5);
+        RunDMA(6);
+        RunDMA(7);
+    }
+    else
+    {
+        ARM7->Execute();
+    }
+}
+
+// runs the ARM7 and the scheduler up to the given point in the same steps
+// the main loop would have used, for when the ARM9 skips ahead on its own.
+// stops where the main loop would have, if the frame ends on the way there
+bool CatchUpARM7(u64 target, s32 maxcycles)
+{
+    CurCPU = 1;
+
+    for (;;)
+    {
+        u64 t = std::min(NextTarget(maxcycles), target);
+
+        while (ARM7Timestamp < t)
+            RunARM7(t);
+
+        if (t >= target) return true;
+        RunSystem(t);
+
+        if (!Running || GPU::TotalScanlines || (CPUStop & 0x40000000))
+        {
+            ARM9Timestamp = t << ARM9ClockShift;
+            return false;
+        }
+    }
+}
+
+void ARM7ThreadFunc()
+{
+    CurCPU = 1;
+
+    for (;;)
     {
-        if (!mask) break;
-        if (mask & 0x1)
+        Platform::Semaphore_Wait(Sema_ARM7Start);
+        if (!ARM7ThreadRunning) return;
+
+        // slices are way too short to wait on a semaphore for each of them
+        for (;;)
         {
-            if (SchedList[i].Timestamp <= SysTimestamp)
+            u32 cmd;
+            while ((cmd = ARM7Command.load()) == ARM7Cmd_Idle)
+                Platform::Thread_Yield();
+
+            if (cmd == ARM7Cmd_EndFrame)
             {
-                SchedListMask &= ~(1<<i);
-                SchedList[i].Func(SchedList[i].Param);
+                ARM7Command = ARM7Cmd_Idle;
+                break;
             }
+
+            // the ARM9 can still bring the end of the slice closer
+            u64 target;
+            while (ARM7Timestamp < (target = ARM7SliceTarget.load()))
+                RunARM7(target);
+
+            ARM7Parked = true;
+            ARM7Command = ARM7Cmd_Idle;
         }
+    }
+}
 
-        mask >>= 1;
+void StopARM7Thread()
+{
+    if (ARM7ThreadRunning)
+    {
+        ARM7ThreadRunning = false;
+        Platform::Semaphore_Post(Sema_ARM7Start);
+        Platform::Thread_Wait(ARM7Thread);
+        Platform::Thread_Free(ARM7Thread);
     }
 }
 
-u32 RunFrame()
+bool SetupARM7Thread()
+{
+    // the JIT's block tables and invalidation aren't thread safe
+    if (Config::ThreadedARM7 && !Config::JIT_Enable && !Config::JIT_EnableARM7)
+    {
+        if (!ARM7ThreadRunning)
+        {
+            ARM7ThreadRunning = true;
+            ARM7Thread = Platform::Thread_Create(ARM7ThreadFunc);
+        }
+
+        return true;
+    }
+    else
+    {
+        StopARM7Thread();
+        return false;
+    }
+}
+
+void SetupFastMem()
+{
+    // only compiled code uses the mirror, and it isn't free: the memory has to
+    // live in a shared file and there's a SIGSEGV handler
+    static bool failed = false;
+    bool want = Config::JIT_FastMem && (Config::JIT_Enable || Config::JIT_EnableARM7);
+
+    if (want == (FastMem::Base[0] != NULL) || (want && failed))
+        return;
+
+    // the memory gets moved around, nothing can be reading it
+    GPU::Sync2D();
+    GPU3D::SoftRenderer::FinishRendering();
+
+    if (want)
+    {
+        // not a big deal if it fails, the JIT does without
+        failed = !FastMem::Init();
+    }
+    else
+    {
+        failed = false;
+
+        // compiled code has the mirror's address built in
+        ARMJIT::InvalidateAll();
+        FastMem::DeInit();
+    }
+}
+
+void SyncCPUs()
+{
+    // the ARM9 never waits: it's like it ran the whole slice before the ARM7
+    if (!ThreadedSlice || CurCPU == 0) return;
+
+    // (stays parked, the ARM9 is done with the slice once this returns)
+    ARM7Parked = true;
+    while (!ARM9SliceDone.load())
+        Platform::Thread_Yield();
+}
+
+void SyncARM7()
+{
+    if (!ThreadedSlice || CurCPU != 0) return;
+
+    while (!ARM7Parked.load())
+        Platform::Thread_Yield();
+}
+
+u32 RunFrameInternal(bool threaded, s32 maxcycles)
 {
     FrameStartTimestamp = SysTimestamp;
 
@@ -785,59 +1213,136 @@ u32 RunFrame()
 
     GPU::StartFrame();
 
+    if (threaded)
+        Platform::Semaphore_Post(Sema_ARM7Start);
+
+    // the counters that aren't per frame are kept running
+    memset(&Stats, 0, sizeof(Stats));
+    u64 instrs[2] = {ARM9->InstrCount, ARM7->InstrCount};
+    u64 halted[2] = {ARM9->HaltedCycles, ARM7->HaltedCycles};
+    u64 idleskipped[2] = {IdleLoop::SkippedCycles[0], IdleLoop::SkippedCycles[1]};
+
+    bool profiling = Config::FrameProfiling != 0;
+    u64 starttime = 0;
+    if (profiling)
+    {
+        starttime = GetHostTime();
+        ProfileTimestamp = starttime;
+    }
+
     while (Running && GPU::TotalScanlines==0)
     {
         // TODO: give it some margin, so it can directly do 17 cycles instead of 16 then 1
-        u64 target = NextTarget();
+        // when the ARM9 is stalled on the GXFIFO, go straight to the next event
+        // (not with the ARM7 thread, it would run that far ahead of the ARM9)
+        bool gxstall = (CPUStop & 0x80000000) && !threaded;
+        u64 target = NextTarget(gxstall ? kMaxStallCycles : maxcycles);
         ARM9Target = target << ARM9ClockShift;
         CurCPU = 0;
 
+        if (threaded)
+        {
+            ARM9SliceDone = false;
+            ARM7Parked = false;
+            ARM7SliceTarget = target;
+            ThreadedSlice = true;
+            ARM7Command = ARM7Cmd_RunSlice;
+        }
+
         if (CPUStop & 0x80000000)
         {
             // GXFIFO stall
-            s32 cycles = GPU3D::CyclesToRunFor();
+            // skip from one finished 3D command to the next until there's room
+            // in the FIFO again or the slice is over
+            u64 start = ARM9Timestamp;
+            bool frameover = false;
+            for (;;)
+            {
+                s32 cycles = GPU3D::CyclesToRunFor();
+
+                // stopping at the end of a regular slice would have lined the
+                // ARM9 up with the system clock
+                if (gxstall && (ARM9Timestamp+(cycles<<ARM9ClockShift)) > (NextTarget(maxcycles) << ARM9ClockShift))
+                    ARM9Timestamp &= ~((1ULL<<ARM9ClockShift)-1);
+
+                ARM9Timestamp = std::min(ARM9Target, ARM9Timestamp+(cycles<<ARM9ClockShift));
+
+                if (!gxstall || ARM9Timestamp >= ARM9Target || !cycles) break;
+
+                GPU3D::Run();
+                if (!(CPUStop & 0x80000000)) break;
+
+                // still stuck, bring everything else there like usual
+                if (!CatchUpARM7(ARM9Timestamp >> ARM9ClockShift, maxcycles))
+                {
+                    frameover = true;
+                    break;
+                }
+                RunSystem(ARM9Timestamp >> ARM9ClockShift);
+                CurCPU = 0;
 
-            ARM9Timestamp = std::min(ARM9Target, ARM9Timestamp+(cycles<<ARM9ClockShift));
+                // the main loop would be done here too
+                if (!Running || GPU::TotalScanlines || (CPUStop & 0x40000000))
+                {
+                    frameover = true;
+                    break;
+                }
+
+                if (SchedNextTimestamp < (ARM9Target >> ARM9ClockShift))
+                    ARM9Target = SchedNextTimestamp << ARM9ClockShift;
+            }
+            Stats.GXFIFOStallCycles += ARM9Timestamp - start;
+
+            // everything is already there
+            if (frameover) break;
         }
         else if (CPUStop & 0x0FFF)
         {
-            DMAs[0]->Run();
-            if (!(CPUStop & 0x80000000)) DMAs[1]->Run();
-            if (!(CPUStop & 0x80000000)) DMAs[2]->Run();
-            if (!(CPUStop & 0x80000000)) DMAs[3]->Run();
+            RunDMA(0);
+            if (!(CPUStop & 0x80000000)) RunDMA(1);
+            if (!(CPUStop & 0x80000000)) RunDMA(2);
+            if (!(CPUStop & 0x80000000)) RunDMA(3);
         }
         else
         {
             ARM9->Execute();
         }
 
-        RunTimers(0);
+        if (profiling) ProfilePhase(Stats.ARM9Time);
+
         GPU3D::Run();
 
-        target = ARM9Timestamp >> ARM9ClockShift;
-        CurCPU = 1;
+        if (profiling) ProfilePhase(Stats.GPU3DTime);
 
-        while (ARM7Timestamp < target)
+        if (threaded)
         {
-            ARM7Target = target; // might be changed by a reschedule
+            ARM9SliceDone = true;
+            while (ARM7Command.load() != ARM7Cmd_Idle)
+                Platform::Thread_Yield();
+            ThreadedSlice = false;
+        }
 
-            if (CPUStop & 0x0FFF0000)
-            {
-                DMAs[4]->Run();
-                DMAs[5]->Run();
-                DMAs[6]->Run();
-                DMAs[7]->Run();
-            }
-            else
-            {
-                ARM7->Execute();
-            }
+        // with the ARM7 thread, this is only the part the ARM9 ran past the target
+        target = ARM9Timestamp >> ARM9ClockShift;
+        CurCPU = 1;
 
-            RunTimers(1);
+        if (gxstall)
+        {
+            if (!CatchUpARM7(target, maxcycles))
+                break;
+        }
+        else
+        {
+            while (ARM7Timestamp < target)
+                RunARM7(target); // target might be changed by a reschedule
         }
 
+        if (profiling) ProfilePhase(Stats.ARM7Time);
+
         RunSystem(target);
 
+        if (profiling) ProfilePhase(Stats.SystemTime);
+
         if (CPUStop & 0x40000000)
         {
             // checkme: when is sleep mode effective?
@@ -847,6 +1352,13 @@ u32 RunFrame()
         }
     }
 
+    if (threaded)
+    {
+        ARM7Command = ARM7Cmd_EndFrame;
+        while (ARM7Command.load() != ARM7Cmd_Idle)
+            Platform::Thread_Yield();
+    }
+
 #ifdef DEBUG_CHECK_DESYNC
     printf("[%08X%08X] ARM9=%ld, ARM7=%ld, GPU=%ld\n",
            (u32)(SysTimestamp>>32), (u32)SysTimestamp,
@@ -855,17 +1367,147 @@ u32 RunFrame()
            GPU3D::Timestamp-SysTimestamp);
 #endif
 
+    Stats.Frame = NumFrames;
+    Stats.Instrs[0] = ARM9->InstrCount - instrs[0];
+    Stats.Instrs[1] = ARM7->InstrCount - instrs[1];
+    Stats.HaltedCycles[0] = (ARM9->HaltedCycles - halted[0]) >> ARM9ClockShift;
+    Stats.HaltedCycles[1] = ARM7->HaltedCycles - halted[1];
+    Stats.IdleSkippedCycles[0] = (IdleLoop::SkippedCycles[0] - idleskipped[0]) >> ARM9ClockShift;
+    Stats.IdleSkippedCycles[1] = IdleLoop::SkippedCycles[1] - idleskipped[1];
+    Stats.GXFIFOStallCycles >>= ARM9ClockShift;
+    for (int i = 0; i < 4; i++)
+        Stats.DMACycles[i] >>= ARM9ClockShift;
+    if (profiling)
+        Stats.TotalTime = GetHostTime() - starttime;
+    LastFrameStats = Stats;
+
     NumFrames++;
 
     return GPU::TotalScanlines;
 }
 
+void GetCheckHashes(u32* hashes)
+{
+    hashes[0] = CRC32(MainRAM, MAIN_RAM_SIZE);
+    hashes[1] = CRC32(SharedWRAM, 0x8000);
+    hashes[2] = CRC32(ARM7WRAM, 0x10000);
+    hashes[3] = CRC32((u8*)ARM9->R, 16*4) ^ ARM9->CPSR;
+    hashes[4] = CRC32((u8*)ARM7->R, 16*4) ^ ARM7->CPSR;
+    hashes[5] = (u32)ARM9Timestamp;
+    hashes[6] = (u32)ARM7Timestamp;
+}
+
+void DoCheckState(bool save)
+{
+    Savestate* state = new Savestate(&CheckState, save);
+    DoSavestate(state);
+    delete state;
+}
+
+u32 RunFrameChecked(s32 maxcycles)
+{
+    const char* names[7] =
+    {
+        "main RAM", "shared WRAM", "ARM7 WRAM",
+        "ARM9 registers", "ARM7 registers",
+        "ARM9 timestamp", "ARM7 timestamp"
+    };
+    u32 ref[7], res[7];
+    u32 frame = NumFrames;
+
+    // same frame, with the same slices, single-threaded then threaded. only
+    // the second run is heard. both start from the loaded state, savestates
+    // don't have quite everything
+    DoCheckState(true);
+
+    DoCheckState(false);
+    SetSpeculative(true);
+    RunFrameInternal(false, maxcycles);
+    SetSpeculative(false);
+    GetCheckHashes(ref);
+
+    DoCheckState(false);
+    u32 ret = RunFrameInternal(true, maxcycles);
+    GetCheckHashes(res);
+
+    for (int i = 0; i < 7; i++)
+    {
+        if (ref[i] != res[i])
+            printf("ARM7 thread: frame %d: %s differs from the single-threaded run (%08X/%08X)\n",
+                   frame, names[i], res[i], ref[i]);
+    }
+
+    return ret;
+}
+
+void SetSpeculative(bool on)
+{
+    if (on) Speculative++;
+    else if (Speculative) Speculative--;
+
+    SPU::MuteOutput(on);
+}
+
+u32 RunFrame()
+{
+    SetupFastMem();
+
+    if (!SetupARM7Thread())
+        return RunFrameInternal(false, kMaxIterationCycles);
+
+    s32 maxcycles = std::max(Config::ARM7SkewCycles, kMaxIterationCycles);
+
+    if (Config::ThreadedARM7 == 2)
+        return RunFrameChecked(maxcycles);
+
+    return RunFrameInternal(true, maxcycles);
+}
+
+void WriteFrameStatsCSV(FILE* file, bool header)
+{
+    FrameStats& st = LastFrameStats;
+
+    if (header)
+    {
+        fprintf(file, "frame,arm9_instrs,arm7_instrs,arm9_halted,arm7_halted,arm9_idleskipped,arm7_idleskipped,gxfifo_stall");
+        for (int i = 0; i < 8; i++)
+            fprintf(file, ",dma%d", i);
+        for (int i = 0; i < Event_MAX; i++)
+            fprintf(file, ",ev_%s", EventNames[i]);
+        fprintf(file, ",arm9_ns,gpu3d_ns,arm7_ns,system_ns,total_ns\n");
+        return;
+    }
+
+    fprintf(file, "%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu", st.Frame,
+            (unsigned long long)st.Instrs[0], (unsigned long long)st.Instrs[1],
+            (unsigned long long)st.HaltedCycles[0], (unsigned long long)st.HaltedCycles[1],
+            (unsigned long long)st.IdleSkippedCycles[0], (unsigned long long)st.IdleSkippedCycles[1],
+            (unsigned long long)st.GXFIFOStallCycles);
+    for (int i = 0; i < 8; i++)
+        fprintf(file, ",%llu", (unsigned long long)st.DMACycles[i]);
+    for (int i = 0; i < Event_MAX; i++)
+        fprintf(file, ",%u", st.Events[i]);
+    fprintf(file, ",%llu,%llu,%llu,%llu,%llu\n",
+            (unsigned long long)st.ARM9Time, (unsigned long long)st.GPU3DTime,
+            (unsigned long long)st.ARM7Time, (unsigned long long)st.SystemTime,
+            (unsigned long long)st.TotalTime);
+}
+
 void Reschedule(u64 target)
 {
     if (CurCPU == 0)
     {
         if (target < (ARM9Target >> ARM9ClockShift))
             ARM9Target = (target << ARM9ClockShift);
+
+        // the ARM7 thread shouldn't run past where the ARM9 is going to stop
+        // (unless it already has)
+        if (ThreadedSlice && target < ARM7SliceTarget.load())
+        {
+            SyncARM7();
+            ARM7SliceTarget = target;
+            if (target < ARM7Target) ARM7Target = target;
+        }
     }
     else
     {
@@ -876,7 +1518,9 @@ void Reschedule(u64 target)
 
 void ScheduleEvent(u32 id, bool periodic, s32 delay, void (*func)(u32), u32 param)
 {
-    if (SchedListMask & (1<<id))
+    SyncCPUs();
+
+    if (SchedList[id].Scheduled)
     {
         printf("!! EVENT %d ALREADY SCHEDULED\n", id);
         return;
@@ -897,14 +1541,20 @@ void ScheduleEvent(u32 id, bool periodic, s32 delay, void (*func)(u32), u32 para
     evt->Func = func;
     evt->Param = param;
 
-    SchedListMask |= (1<<id);
+    evt->Scheduled = 1;
+    SchedHeapInsert(id);
 
     Reschedule(evt->Timestamp);
 }
 
 void CancelEvent(u32 id)
 {
-    SchedListMask &= ~(1<<id);
+    SyncCPUs();
+
+    if (!SchedList[id].Scheduled) return;
+
+    SchedList[id].Scheduled = 0;
+    SchedHeapRemove(id);
 }
 
 
@@ -967,6 +1617,12 @@ void Halt()
 
 void MapSharedWRAM(u8 val)
 {
+    SyncARM7();
+
+    // compiled code is looked up by CPU address
+    if (val != WRAMCnt)
+        ARMJIT::InvalidateAll();
+
     WRAMCnt = val;
 
     switch (WRAMCnt & 0x3)
@@ -999,6 +1655,122 @@ void MapSharedWRAM(u8 val)
         SWRAM_ARM7Mask = 0x7FFF;
         break;
     }
+
+    RemapPages(0x03000000, 0x04000000);
+}
+
+u8* GetVRAMPage(u32 mask, u32 addr)
+{
+    const u32 banksize[9] = {0x20000, 0x20000, 0x20000, 0x20000, 0x10000, 0x4000, 0x4000, 0x8000, 0x4000};
+
+    // reads OR together every bank mapped at a given address
+    // only the common case of one bank can be done with a pointer
+    if (!mask || (mask & (mask - 1)))
+        return NULL;
+
+    int bank = 0;
+    while (!(mask & (1<<bank))) bank++;
+
+    return &GPU::VRAM[bank][addr & (banksize[bank] - 1)];
+}
+
+void UpdateARM9ReadPage(u32 addr)
+{
+    MemPage& page = ARM9ReadMap[addr >> 14];
+    page.Mem = NULL;
+    page.Mask = 0x3FFF;
+
+    switch (addr & 0xFF000000)
+    {
+    case 0x02000000:
+        page.Mem = &MainRAM[addr & (MAIN_RAM_SIZE - 1)];
+        break;
+
+    case 0x03000000:
+        if (SWRAM_ARM9)
+            page.Mem = &SWRAM_ARM9[addr & SWRAM_ARM9Mask];
+        break;
+
+    case 0x05000000:
+    case 0x07000000:
+        // engine A and B halves can be powered off separately
+        if ((PowerControl9 & ((1<<1) | (1<<9))) == ((1<<1) | (1<<9)))
+        {
+            page.Mem = ((addr & 0xFF000000) == 0x05000000) ? GPU::Palette : GPU::OAM;
+            page.Mask = 0x7FF;
+        }
+        break;
+
+    case 0x06000000:
+        switch (addr & 0x00E00000)
+        {
+        case 0x00000000: page.Mem = GetVRAMPage(GPU::VRAMMap_ABG[(addr >> 14) & 0x1F], addr); break;
+        case 0x00200000: page.Mem = GetVRAMPage(GPU::VRAMMap_BBG[(addr >> 14) & 0x7], addr); break;
+        case 0x00400000: page.Mem = GetVRAMPage(GPU::VRAMMap_AOBJ[(addr >> 14) & 0xF], addr); break;
+        case 0x00600000: page.Mem = GetVRAMPage(GPU::VRAMMap_BOBJ[(addr >> 14) & 0x7], addr); break;
+        default:
+            {
+                // LCDC: banks are laid out one after another
+                const u32 bankstart[10] = {0x00000, 0x20000, 0x40000, 0x60000, 0x80000, 0x90000, 0x94000, 0x98000, 0xA0000, 0xA4000};
+                u32 offset = addr & 0xFC000;
+                for (int bank = 0; bank < 9; bank++)
+                {
+                    if (offset >= bankstart[bank] && offset < bankstart[bank+1])
+                    {
+                        page.Mem = GetVRAMPage(GPU::VRAMMap_LCDC & (1<<bank), addr);
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+        break;
+    }
+}
+
+void UpdateARM7ReadPage(u32 addr)
+{
+    MemPage& page = ARM7ReadMap[addr >> 14];
+    page.Mem = NULL;
+    page.Mask = 0x3FFF;
+
+    switch (addr & 0xFF800000)
+    {
+    case 0x02000000:
+    case 0x02800000:
+        page.Mem = &MainRAM[addr & (MAIN_RAM_SIZE - 1)];
+        break;
+
+    case 0x03000000:
+        if (SWRAM_ARM7)
+            page.Mem = &SWRAM_ARM7[addr & SWRAM_ARM7Mask];
+        else
+            page.Mem = &ARM7WRAM[addr & 0xFFFF];
+        break;
+
+    case 0x03800000:
+        page.Mem = &ARM7WRAM[addr & 0xFFFF];
+        break;
+
+    case 0x06000000:
+    case 0x06800000:
+        page.Mem = GetVRAMPage(GPU::VRAMMap_ARM7[(addr >> 17) & 0x1], addr);
+        break;
+    }
+}
+
+void RemapPages(u32 start, u32 end)
+{
+    SyncARM7();
+
+    for (u32 addr = start; addr < end; addr += 0x4000)
+    {
+        UpdateARM9ReadPage(addr);
+        UpdateARM7ReadPage(addr);
+    }
+
+    ARM9->UpdateMemBlocks(start, end);
+    FastMem::RemapPages(start, end);
 }
 
 
@@ -1047,16 +1819,26 @@ void SetGBASlotTimings()
 
 void SetIRQ(u32 cpu, u32 irq)
 {
+    SyncCPUs();
+    if (cpu) SyncARM7();
+
     IF[cpu] |= (1 << irq);
+    if (cpu) ARM7->Attention = 1;
+    else     ARM9->Attention = 1;
 }
 
 void ClearIRQ(u32 cpu, u32 irq)
 {
+    SyncCPUs();
+    if (cpu) SyncARM7();
+
     IF[cpu] &= ~(1 << irq);
 }
 
 bool HaltInterrupted(u32 cpu)
 {
+    SyncCPUs();
+
     if (cpu == 0)
     {
         if (!(IME[0] & 0x1))
@@ -1071,6 +1853,8 @@ bool HaltInterrupted(u32 cpu)
 
 void StopCPU(u32 cpu, u32 mask)
 {
+    SyncCPUs();
+
     if (cpu)
     {
         CPUStop |= (mask << 16);
@@ -1085,12 +1869,16 @@ void StopCPU(u32 cpu, u32 mask)
 
 void ResumeCPU(u32 cpu, u32 mask)
 {
+    SyncCPUs();
+
     if (cpu) mask <<= 16;
     CPUStop &= ~mask;
 }
 
 void GXFIFOStall()
 {
+    SyncCPUs();
+
     if (CPUStop & 0x80000000) return;
 
     CPUStop |= 0x80000000;
@@ -1107,6 +1895,8 @@ void GXFIFOStall()
 
 void GXFIFOUnstall()
 {
+    SyncCPUs();
+
     CPUStop &= ~0x80000000;
 }
 
@@ -1273,21 +2063,34 @@ void RunTimer(u32 tid, s32 cycles)
 {
     Timer* timer = &Timers[tid];
 
-    u32 oldcount = timer->Counter;
-    timer->Counter += (cycles << timer->CycleShift);
-    if (timer->Counter < oldcount)
-        HandleTimerOverflow(tid);
+    // this can cover a whole period (or more, with a high reload value), so
+    // it has to be done in 64 bits, and every wraparound counts
+    u64 sum = (u64)timer->Counter + ((u64)cycles << timer->CycleShift);
+    while (sum >> 32)
+    {
+        sum -= 0x100000000ULL;
+        timer->Counter = 0;
+        HandleTimerOverflow(tid); // reloads the counter
+        sum += timer->Counter;
+    }
+
+    timer->Counter = (u32)sum;
 }
 
+// timers are only brought up to date when they're read or changed, or when
+// one of them overflows
 void RunTimers(u32 cpu)
 {
     register u32 timermask = TimerCheckMask[cpu];
-    s32 cycles;
+    u64 now = cpu ? ARM7Timestamp : (ARM9Timestamp >> ARM9ClockShift);
 
-    if (cpu == 0)
-        cycles = (ARM9Timestamp >> ARM9ClockShift) - TimerTimestamp[0];
-    else
-        cycles = ARM7Timestamp - TimerTimestamp[1];
+    if (!timermask)
+    {
+        TimerTimestamp[cpu] = now;
+        return;
+    }
+
+    s32 cycles = (s32)(now - TimerTimestamp[cpu]);
 
     if (timermask & 0x1) RunTimer((cpu<<2)+0, cycles);
     if (timermask & 0x2) RunTimer((cpu<<2)+1, cycles);
@@ -1297,6 +2100,31 @@ void RunTimers(u32 cpu)
     TimerTimestamp[cpu] += cycles;
 }
 
+void TimerOverflowEvent(u32 tid)
+{
+    RunTimers(tid >> 2);
+    ScheduleTimerOverflow(tid);
+}
+
+// timers are up to date when this is called
+void ScheduleTimerOverflow(u32 tid)
+{
+    Timer* timer = &Timers[tid];
+
+    CancelEvent(Event_Timer0 + tid);
+    if ((timer->Cnt & 0x84) != 0x80)
+        return;
+
+    // cycles until the counter wraps around, rounded up
+    u64 left = 0x100000000ULL - timer->Counter;
+    s32 delay = (s32)((left + (1ULL << timer->CycleShift) - 1) >> timer->CycleShift);
+
+    // the event goes from when the timers were last run, which isn't quite
+    // what ScheduleEvent() would use from the scheduler
+    SchedList[Event_Timer0 + tid].Timestamp = TimerTimestamp[tid >> 2];
+    ScheduleEvent(Event_Timer0 + tid, true, delay, TimerOverflowEvent, tid);
+}
+
 
 
 bool DMAsInMode(u32 cpu, u32 mode)
@@ -1356,6 +2184,9 @@ void TimerStart(u32 id, u16 cnt)
     u16 curstart = timer->Cnt & (1<<7);
     u16 newstart = cnt & (1<<7);
 
+    // whatever ran before goes with the old settings
+    RunTimers(id >> 2);
+
     timer->Cnt = cnt;
     timer->CycleShift = 16 - TimerPrescaler[cnt & 0x03];
 
@@ -1384,6 +2215,8 @@ void TimerStart(u32 id, u16 cnt)
     }
     else
         TimerCheckMask[id>>2] &= ~(0x11 << (id&0x3));
+
+    ScheduleTimerOverflow(id);
 }
 
 
@@ -1551,6 +2384,12 @@ void debug(u32 param)
 
 u8 ARM9Read8(u32 addr)
 {
+    if (addr < 0x10000000)
+    {
+        MemPage& page = ARM9ReadMap[addr >> 14];
+        if (page.Mem) return *(u8*)&page.Mem[addr & page.Mask];
+    }
+
     if ((addr & 0xFFFFF000) == 0xFFFF0000)
     {
         return *(u8*)&ARM9BIOS[addr & 0xFFF];
@@ -1612,6 +2451,12 @@ u8 ARM9Read8(u32 addr)
 
 u16 ARM9Read16(u32 addr)
 {
+    if (addr < 0x10000000)
+    {
+        MemPage& page = ARM9ReadMap[addr >> 14];
+        if (page.Mem) return *(u16*)&page.Mem[addr & page.Mask];
+    }
+
     if ((addr & 0xFFFFF000) == 0xFFFF0000)
     {
         return *(u16*)&ARM9BIOS[addr & 0xFFF];
@@ -1673,6 +2518,12 @@ u16 ARM9Read16(u32 addr)
 
 u32 ARM9Read32(u32 addr)
 {
+    if (addr < 0x10000000)
+    {
+        MemPage& page = ARM9ReadMap[addr >> 14];
+        if (page.Mem) return *(u32*)&page.Mem[addr & page.Mask];
+    }
+
     if ((addr & 0xFFFFF000) == 0xFFFF0000)
     {
         return *(u32*)&ARM9BIOS[addr & 0xFFF];
@@ -1738,12 +2589,15 @@ void ARM9Write8(u32 addr, u8 val)
     {
     case 0x02000000:
         *(u8*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
+        ARMJIT::InvalidateMainRAMIfNecessary(addr);
         return;
 
     case 0x03000000:
         if (SWRAM_ARM9)
         {
+            SyncARM7();
             *(u8*)&SWRAM_ARM9[addr & SWRAM_ARM9Mask] = val;
+            ARMJIT::InvalidateSWRAMIfNecessary((SWRAM_ARM9 - SharedWRAM) + (addr & SWRAM_ARM9Mask));
         }
         return;
 
@@ -1767,12 +2621,15 @@ void ARM9Write16(u32 addr, u16 val)
     {
     case 0x02000000:
         *(u16*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
+        ARMJIT::InvalidateMainRAMIfNecessary(addr);
         return;
 
     case 0x03000000:
         if (SWRAM_ARM9)
         {
+            SyncARM7();
             *(u16*)&SWRAM_ARM9[addr & SWRAM_ARM9Mask] = val;
+            ARMJIT::InvalidateSWRAMIfNecessary((SWRAM_ARM9 - SharedWRAM) + (addr & SWRAM_ARM9Mask));
         }
         return;
 
@@ -1782,6 +2639,7 @@ void ARM9Write16(u32 addr, u16 val)
 
     case 0x05000000:
         if (!(PowerControl9 & ((addr & 0x400) ? (1<<9) : (1<<1)))) return;
+        GPU::Sync2D();
         *(u16*)&GPU::Palette[addr & 0x7FF] = val;
         return;
 
@@ -1797,7 +2655,9 @@ void ARM9Write16(u32 addr, u16 val)
 
     case 0x07000000:
         if (!(PowerControl9 & ((addr & 0x400) ? (1<<9) : (1<<1)))) return;
+        GPU::Sync2D();
         *(u16*)&GPU::OAM[addr & 0x7FF] = val;
+        GPU::OAMDirty[(addr >> 10) & 0x1] = true;
         return;
     }
 
@@ -1810,12 +2670,15 @@ void ARM9Write32(u32 addr, u32 val)
     {
     case 0x02000000:
         *(u32*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
+        ARMJIT::InvalidateMainRAMIfNecessary(addr);
         return ;
 
     case 0x03000000:
         if (SWRAM_ARM9)
         {
+            SyncARM7();
             *(u32*)&SWRAM_ARM9[addr & SWRAM_ARM9Mask] = val;
+            ARMJIT::InvalidateSWRAMIfNecessary((SWRAM_ARM9 - SharedWRAM) + (addr & SWRAM_ARM9Mask));
         }
         return;
 
@@ -1825,6 +2688,7 @@ void ARM9Write32(u32 addr, u32 val)
 
     case 0x05000000:
         if (!(PowerControl9 & ((addr & 0x400) ? (1<<9) : (1<<1)))) return;
+        GPU::Sync2D();
         *(u32*)&GPU::Palette[addr & 0x7FF] = val;
         return;
 
@@ -1840,7 +2704,9 @@ void ARM9Write32(u32 addr, u32 val)
 
     case 0x07000000:
         if (!(PowerControl9 & ((addr & 0x400) ? (1<<9) : (1<<1)))) return;
+        GPU::Sync2D();
         *(u32*)&GPU::OAM[addr & 0x7FF] = val;
+        GPU::OAMDirty[(addr >> 10) & 0x1] = true;
         return;
     }
 
@@ -1881,6 +2747,12 @@ bool ARM9GetMemRegion(u32 addr, bool write, MemRegion* region)
 
 u8 ARM7Read8(u32 addr)
 {
+    if (addr < 0x10000000)
+    {
+        MemPage& page = ARM7ReadMap[addr >> 14];
+        if (page.Mem) return *(u8*)&page.Mem[addr & page.Mask];
+    }
+
     if (addr < 0x00004000)
     {
         if (ARM7->R[15] >= 0x4000)
@@ -1937,6 +2809,12 @@ u8 ARM7Read8(u32 addr)
 
 u16 ARM7Read16(u32 addr)
 {
+    if (addr < 0x10000000)
+    {
+        MemPage& page = ARM7ReadMap[addr >> 14];
+        if (page.Mem) return *(u16*)&page.Mem[addr & page.Mask];
+    }
+
     if (addr < 0x00004000)
     {
         if (ARM7->R[15] >= 0x4000)
@@ -2000,6 +2878,12 @@ u16 ARM7Read16(u32 addr)
 
 u32 ARM7Read32(u32 addr)
 {
+    if (addr < 0x10000000)
+    {
+        MemPage& page = ARM7ReadMap[addr >> 14];
+        if (page.Mem) return *(u32*)&page.Mem[addr & page.Mask];
+    }
+
     if (addr < 0x00004000)
     {
         if (ARM7->R[15] >= 0x4000)
@@ -2068,22 +2952,26 @@ void ARM7Write8(u32 addr, u8 val)
     case 0x02000000:
     case 0x02800000:
         *(u8*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
+        ARMJIT::InvalidateMainRAMIfNecessary(addr);
         return;
 
     case 0x03000000:
         if (SWRAM_ARM7)
         {
             *(u8*)&SWRAM_ARM7[addr & SWRAM_ARM7Mask] = val;
+            ARMJIT::InvalidateSWRAMIfNecessary((SWRAM_ARM7 - SharedWRAM) + (addr & SWRAM_ARM7Mask));
             return;
         }
         else
         {
             *(u8*)&ARM7WRAM[addr & 0xFFFF] = val;
+            ARMJIT::InvalidateARM7WRAMIfNecessary(addr);
             return;
         }
 
     case 0x03800000:
         *(u8*)&ARM7WRAM[addr & 0xFFFF] = val;
+        ARMJIT::InvalidateARM7WRAMIfNecessary(addr);
         return;
 
     case 0x04000000:
@@ -2106,22 +2994,26 @@ void ARM7Write16(u32 addr, u16 val)
     case 0x02000000:
     case 0x02800000:
         *(u16*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
+        ARMJIT::InvalidateMainRAMIfNecessary(addr);
         return;
 
     case 0x03000000:
         if (SWRAM_ARM7)
         {
             *(u16*)&SWRAM_ARM7[addr & SWRAM_ARM7Mask] = val;
+            ARMJIT::InvalidateSWRAMIfNecessary((SWRAM_ARM7 - SharedWRAM) + (addr & SWRAM_ARM7Mask));
             return;
         }
         else
         {
             *(u16*)&ARM7WRAM[addr & 0xFFFF] = val;
+            ARMJIT::InvalidateARM7WRAMIfNecessary(addr);
             return;
         }
 
     case 0x03800000:
         *(u16*)&ARM7WRAM[addr & 0xFFFF] = val;
+        ARMJIT::InvalidateARM7WRAMIfNecessary(addr);
         return;
 
     case 0x04000000:
@@ -2152,22 +3044,26 @@ void ARM7Write32(u32 addr, u32 val)
     case 0x02000000:
     case 0x02800000:
         *(u32*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
+        ARMJIT::InvalidateMainRAMIfNecessary(addr);
         return;
 
     case 0x03000000:
         if (SWRAM_ARM7)
         {
             *(u32*)&SWRAM_ARM7[addr & SWRAM_ARM7Mask] = val;
+            ARMJIT::InvalidateSWRAMIfNecessary((SWRAM_ARM7 - SharedWRAM) + (addr & SWRAM_ARM7Mask));
             return;
         }
         else
         {
             *(u32*)&ARM7WRAM[addr & 0xFFFF] = val;
+            ARMJIT::InvalidateARM7WRAMIfNecessary(addr);
             return;
         }
 
     case 0x03800000:
         *(u32*)&ARM7WRAM[addr & 0xFFFF] = val;
+        ARMJIT::InvalidateARM7WRAMIfNecessary(addr);
         return;
 
     case 0x04000000:
@@ -2252,6 +3148,8 @@ bool ARM7GetMemRegion(u32 addr, bool write, MemRegion* region)
 
 u8 ARM9IORead8(u32 addr)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x04000130: return KeyInput & 0xFF;
@@ -2320,6 +3218,8 @@ u8 ARM9IORead8(u32 addr)
 
 u16 ARM9IORead16(u32 addr)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x04000004: return GPU::DispStat[0];
@@ -2442,6 +3342,8 @@ u16 ARM9IORead16(u32 addr)
 
 u32 ARM9IORead32(u32 addr)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x04000004: return GPU::DispStat[0] | (GPU::VCount << 16);
@@ -2561,6 +3463,8 @@ u32 ARM9IORead32(u32 addr)
 
 void ARM9IOWrite8(u32 addr, u8 val)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x0400006C:
@@ -2600,7 +3504,7 @@ void ARM9IOWrite8(u32 addr, u8 val)
     case 0x040001AE: NDSCart::ROMCommand[6] = val; return;
     case 0x040001AF: NDSCart::ROMCommand[7] = val; return;
 
-    case 0x04000208: IME[0] = val & 0x1; return;
+    case 0x04000208: IME[0] = val & 0x1; ARM9->Attention = 1; return;
 
     case 0x04000240: GPU::MapVRAM_AB(0, val); return;
     case 0x04000241: GPU::MapVRAM_AB(1, val); return;
@@ -2640,6 +3544,8 @@ void ARM9IOWrite8(u32 addr, u8 val)
 
 void ARM9IOWrite16(u32 addr, u16 val)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x04000004: GPU::SetDispStat(0, val); return;
@@ -2740,9 +3646,9 @@ void ARM9IOWrite16(u32 addr, u16 val)
         SetGBASlotTimings();
         return;
 
-    case 0x04000208: IME[0] = val & 0x1; return;
-    case 0x04000210: IE[0] = (IE[0] & 0xFFFF0000) | val; return;
-    case 0x04000212: IE[0] = (IE[0] & 0x0000FFFF) | (val << 16); return;
+    case 0x04000208: IME[0] = val & 0x1; ARM9->Attention = 1; return;
+    case 0x04000210: IE[0] = (IE[0] & 0xFFFF0000) | val; ARM9->Attention = 1; return;
+    case 0x04000212: IE[0] = (IE[0] & 0x0000FFFF) | (val << 16); ARM9->Attention = 1; return;
     // TODO: what happens when writing to IF this way??
 
     case 0x04000240:
@@ -2802,6 +3708,8 @@ void ARM9IOWrite16(u32 addr, u16 val)
 
 void ARM9IOWrite32(u32 addr, u32 val)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x04000060: GPU3D::Write32(addr, val); return;
@@ -2895,8 +3803,8 @@ void ARM9IOWrite32(u32 addr, u32 val)
     case 0x040001B0: *(u32*)&ROMSeed0[0] = val; return;
     case 0x040001B4: *(u32*)&ROMSeed1[0] = val; return;
 
-    case 0x04000208: IME[0] = val & 0x1; return;
-    case 0x04000210: IE[0] = val; return;
+    case 0x04000208: IME[0] = val & 0x1; ARM9->Attention = 1; return;
+    case 0x04000210: IE[0] = val; ARM9->Attention = 1; return;
     case 0x04000214: IF[0] &= ~val; GPU3D::CheckFIFOIRQ(); return;
 
     case 0x04000240:
@@ -2956,6 +3864,8 @@ void ARM9IOWrite32(u32 addr, u32 val)
 
 u8 ARM7IORead8(u32 addr)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x04000130: return KeyInput & 0xFF;
@@ -3001,6 +3911,8 @@ u8 ARM7IORead8(u32 addr)
 
 u16 ARM7IORead16(u32 addr)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x04000004: return GPU::DispStat[1];
@@ -3080,6 +3992,8 @@ u16 ARM7IORead16(u32 addr)
 
 u32 ARM7IORead32(u32 addr)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x04000004: return GPU::DispStat[1] | (GPU::VCount << 16);
@@ -3166,6 +4080,8 @@ u32 ARM7IORead32(u32 addr)
 
 void ARM7IOWrite8(u32 addr, u8 val)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x04000132:
@@ -3212,7 +4128,7 @@ void ARM7IOWrite8(u32 addr, u8 val)
         SPI::WriteData(val);
         return;
 
-    case 0x04000208: IME[1] = val & 0x1; return;
+    case 0x04000208: IME[1] = val & 0x1; ARM7->Attention = 1; return;
 
     case 0x04000300:
         if (ARM7->R[15] >= 0x4000)
@@ -3240,6 +4156,8 @@ void ARM7IOWrite8(u32 addr, u8 val)
 
 void ARM7IOWrite16(u32 addr, u16 val)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x04000004: GPU::SetDispStat(1, val); return;
@@ -3334,9 +4252,9 @@ void ARM7IOWrite16(u32 addr, u16 val)
         SetWifiWaitCnt(val);
         return;
 
-    case 0x04000208: IME[1] = val & 0x1; return;
-    case 0x04000210: IE[1] = (IE[1] & 0xFFFF0000) | val; return;
-    case 0x04000212: IE[1] = (IE[1] & 0x0000FFFF) | (val << 16); return;
+    case 0x04000208: IME[1] = val & 0x1; ARM7->Attention = 1; return;
+    case 0x04000210: IE[1] = (IE[1] & 0xFFFF0000) | val; ARM7->Attention = 1; return;
+    case 0x04000212: IE[1] = (IE[1] & 0x0000FFFF) | (val << 16); ARM7->Attention = 1; return;
     // TODO: what happens when writing to IF this way??
 
     case 0x04000300:
@@ -3365,6 +4283,8 @@ void ARM7IOWrite16(u32 addr, u16 val)
 
 void ARM7IOWrite32(u32 addr, u32 val)
 {
+    SyncCPUs();
+
     switch (addr)
     {
     case 0x040000B0: DMAs[4]->SrcAddr = val; return;
@@ -3446,8 +4366,8 @@ void ARM7IOWrite32(u32 addr, u32 val)
     case 0x040001B0: *(u32*)&ROMSeed0[8] = val; return;
     case 0x040001B4: *(u32*)&ROMSeed1[8] = val; return;
 
-    case 0x04000208: IME[1] = val & 0x1; return;
-    case 0x04000210: IE[1] = val; return;
+    case 0x04000208: IME[1] = val & 0x1; ARM7->Attention = 1; return;
+    case 0x04000210: IE[1] = val; ARM7->Attention = 1; return;
     case 0x04000214: IF[1] &= ~val; return;
 
     case 0x04000308:
@@ -42,14 +42,50 @@ enum
     Event_Div,
     Event_Sqrt,
 
+    // overflows of the timers that count cycles, 0-3 ARM9 and 4-7 ARM7
+    Event_Timer0,
+    Event_Timer1,
+    Event_Timer2,
+    Event_Timer3,
+    Event_Timer4,
+    Event_Timer5,
+    Event_Timer6,
+    Event_Timer7,
+
+    // no more than 256 of those, the scheduler keeps them in u8s
     Event_MAX
 };
 
+// what went on during the last frame. CPU indexes are 0=ARM9 1=ARM7,
+// cycles are system cycles (33MHz). the host times are only measured with
+// Config::FrameProfiling, the rest is always counted
+struct FrameStats
+{
+    u32 Frame;
+
+    u64 Instrs[2];
+    u64 HaltedCycles[2];
+    u64 IdleSkippedCycles[2];   // loops that were skipped (see IdleLoop)
+    u64 GXFIFOStallCycles;      // ARM9 waiting on the GXFIFO
+    u64 DMACycles[8];
+
+    u32 Events[Event_MAX];
+
+    // host time in nanoseconds. the ARM9 part includes its DMA, same for
+    // the ARM7, the system part is the scheduler events
+    u64 ARM9Time;
+    u64 GPU3DTime;
+    u64 ARM7Time;
+    u64 SystemTime;
+    u64 TotalTime;
+};
+
 typedef struct
 {
     void (*Func)(u32 param);
     u64 Timestamp;
     u32 Param;
+    u8 Scheduled;
 
 } SchedEvent;
 
@@ -105,6 +141,9 @@ extern u64 ARM9Timestamp, ARM9Target;
 extern u64 ARM7Timestamp, ARM7Target;
 extern u32 ARM9ClockShift;
 
+// set while the ARM7 thread is running alongside the ARM9
+extern bool ThreadedSlice;
+
 // hax
 extern u32 IME[2];
 extern u32 IE[2];
@@ -124,6 +163,23 @@ extern u8 ARM7BIOS[0x4000];
 
 extern u8 MainRAM[MAIN_RAM_SIZE];
 
+extern u8 SharedWRAM[0x8000];
+extern u8* SWRAM_ARM9;
+extern u8* SWRAM_ARM7;
+extern u32 SWRAM_ARM9Mask;
+extern u32 SWRAM_ARM7Mask;
+
+extern u8 ARM7WRAM[0x10000];
+
+struct MemPage
+{
+    u8* Mem;
+    u32 Mask;
+};
+
+extern MemPage ARM9ReadMap[0x4000];
+extern MemPage ARM7ReadMap[0x4000];
+
 bool Init();
 void DeInit();
 void Reset();
@@ -141,6 +197,17 @@ void RelocateSave(const char* path, bool write);
 
 u32 RunFrame();
 
+// frames ran between these are thrown away afterwards (run-ahead), so nothing
+// of them must get out of the emulator: they aren't heard, don't write the
+// save file and don't send or take wifi packets. calls nest
+extern u32 Speculative;
+void SetSpeculative(bool on);
+
+extern FrameStats LastFrameStats;
+
+// one line for LastFrameStats, or the column names
+void WriteFrameStatsCSV(FILE* file, bool header);
+
 void PressKey(u32 key);
 void ReleaseKey(u32 key);
 void TouchScreen(u16 x, u16 y);
@@ -161,6 +228,14 @@ void Halt();
 
 void MapSharedWRAM(u8 val);
 
+// call when what's mapped in the given range changed
+void RemapPages(u32 start, u32 end);
+
+// with the ARM7 thread: the ARM7 waits for the ARM9 to be done with the
+// slice, the ARM9 waits for the ARM7 to be out of the way
+void SyncCPUs();
+void SyncARM7();
+
 void SetIRQ(u32 cpu, u32 irq);
 void ClearIRQ(u32 cpu, u32 irq);
 bool HaltInterrupted(u32 cpu);
@@ -22,6 +22,7 @@
 #include "NDSCart.h"
 #include "ARM.h"
 #include "CRC32.h"
+#include "IdleLoop.h"
 
 #include "melon_fopen.h"
 
@@ -442,7 +443,8 @@ void Write(u8 val, u32 hold)
         break;
     }
 
-    if (islast && (CurCmd == 0x02 || CurCmd == 0x0A) && (SRAMLength > 0))
+    // a speculative frame's writes are undone, the real one will do them
+    if (islast && (CurCmd == 0x02 || CurCmd == 0x0A) && (SRAMLength > 0) && !NDS::Speculative)
     {
         FILE* f = melon_fopen(SRAMPath, "wb");
         if (f)
@@ -891,6 +893,7 @@ bool LoadROM(const char* path, const char* sram, bool direct)
     fseek(f, 0x0C, SEEK_SET);
     fread(&gamecode, 4, 1, f);
     printf("Game code: %c%c%c%c\n", gamecode&0xFF, (gamecode>>8)&0xFF, (gamecode>>16)&0xFF, gamecode>>24);
+    IdleLoop::SetTitle(gamecode);
 
     CartROM = new u8[CartROMSize];
     memset(CartROM, 0, CartROMSize);
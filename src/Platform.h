@@ -29,6 +29,8 @@ void StopEmu();
 void* Thread_Create(void (*func)());
 void Thread_Free(void* thread);
 void Thread_Wait(void* thread);
+// let another thread run, for when spinning on something
+void Thread_Yield();
 
 void* Semaphore_Create();
 void Semaphore_Free(void* sema);
@@ -65,6 +65,7 @@ const u32 OutputBufferSize = 2*1024;
 s16 OutputBuffer[2 * OutputBufferSize];
 u32 OutputReadOffset;
 u32 OutputWriteOffset;
+u32 OutputMuted;
 
 
 u16 Cnt;
@@ -100,6 +101,7 @@ void Reset()
     memset(OutputBuffer, 0, 2*OutputBufferSize*2);
     OutputReadOffset = 0;
     OutputWriteOffset = OutputBufferSize;
+    OutputMuted = 0;
 
     Cnt = 0;
     MasterVolume = 0;
@@ -119,6 +121,15 @@ void Stop()
     memset(OutputBuffer, 0, 2*OutputBufferSize*2);
 }
 
+void MuteOutput(bool mute)
+{
+    // the hardware keeps running, but nothing reaches the output buffer
+    // used when emulating frames that aren't meant to be heard
+    // calls nest, so it stays muted until everyone is done
+    if (mute) OutputMuted++;
+    else if (OutputMuted) OutputMuted--;
+}
+
 void DoSavestate(Savestate* file)
 {
     file->Section("SPU.");
@@ -713,6 +724,8 @@ void Mix(u32 samples)
         }
     }
 
+    if (OutputMuted) samples = 0;
+
     for (u32 s = 0; s < samples; s++)
     {
         s32 l = leftoutput[s];
@@ -28,6 +28,7 @@ bool Init();
 void DeInit();
 void Reset();
 void Stop();
+void MuteOutput(bool mute);
 
 void DoSavestate(Savestate* file);
 
@@ -17,6 +17,7 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include "Savestate.h"
 #include "melon_fopen.h"
 
@@ -49,48 +50,63 @@
 
 Savestate::Savestate(char* filename, bool save)
 {
-    char* magic = "MELN";
-
     Error = false;
+    Saving = save;
+    SameSession = false;
 
-    if (save)
+    Buffer = NULL;
+    BufferPos = 0;
+
+    file = melon_fopen(filename, save ? "wb" : "rb");
+    if (!file)
     {
-        Saving = true;
-        file = melon_fopen(filename, "wb");
-        if (!file)
-        {
-            printf("savestate: file %s doesn't exist\n", filename);
-            Error = true;
-            return;
-        }
+        printf("savestate: file %s doesn't exist\n", filename);
+        Error = true;
+        return;
+    }
+
+    Begin();
+}
+
+Savestate::Savestate(std::vector<u8>* buffer, bool save)
+{
+    Error = false;
+    Saving = save;
+    SameSession = true;
 
+    file = NULL;
+
+    Buffer = buffer;
+    BufferPos = 0;
+    if (save) Buffer->clear();
+
+    Begin();
+}
+
+void Savestate::Begin()
+{
+    char* magic = "MELN";
+
+    if (Saving)
+    {
         VersionMajor = SAVESTATE_MAJOR;
         VersionMinor = SAVESTATE_MINOR;
 
-        fwrite(magic, 4, 1, file);
-        fwrite(&VersionMajor, 2, 1, file);
-        fwrite(&VersionMinor, 2, 1, file);
-        fseek(file, 8, SEEK_CUR); // length to be fixed later
+        Write(magic, 4);
+        Write(&VersionMajor, 2);
+        Write(&VersionMinor, 2);
+        Seek(8, SEEK_CUR); // length to be fixed later
     }
     else
     {
-        Saving = false;
-        file = melon_fopen(filename, "rb");
-        if (!file)
-        {
-            printf("savestate: file %s doesn't exist\n", filename);
-            Error = true;
-            return;
-        }
-
         u32 len;
-        fseek(file, 0, SEEK_END);
-        len = (u32)ftell(file);
-        fseek(file, 0, SEEK_SET);
+        Seek(0, SEEK_END);
+        len = (u32)Tell();
+        Seek(0, SEEK_SET);
 
         u32 buf = 0;
 
-        fread(&buf, 4, 1, file);
+        Read(&buf, 4);
         if (buf != ((u32*)magic)[0])
         {
             printf("savestate: invalid magic %08X\n", buf);
@@ -101,7 +117,7 @@ Savestate::Savestate(char* filename, bool save)
         VersionMajor = 0;
         VersionMinor = 0;
 
-        fread(&VersionMajor, 2, 1, file);
+        Read(&VersionMajor, 2);
         if (VersionMajor != SAVESTATE_MAJOR)
         {
             printf("savestate: bad version major %d, expecting %d\n", VersionMajor, SAVESTATE_MAJOR);
@@ -109,11 +125,11 @@ Savestate::Savestate(char* filename, bool save)
             return;
         }
 
-        fread(&VersionMinor, 2, 1, file);
+        Read(&VersionMinor, 2);
         // TODO: handle it???
 
         buf = 0;
-        fread(&buf, 4, 1, file);
+        Read(&buf, 4);
         if (buf != len)
         {
             printf("savestate: bad length %d\n", buf);
@@ -121,7 +137,7 @@ Savestate::Savestate(char* filename, bool save)
             return;
         }
 
-        fseek(file, 4, SEEK_CUR);
+        Seek(4, SEEK_CUR);
     }
 
     CurSection = -1;
@@ -135,19 +151,19 @@ Savestate::~Savestate()
     {
         if (CurSection != -1)
         {
-            u32 pos = (u32)ftell(file);
-            fseek(file, CurSection+4, SEEK_SET);
+            u32 pos = (u32)Tell();
+            Seek(CurSection+4, SEEK_SET);
 
             u32 len = pos - CurSection;
-            fwrite(&len, 4, 1, file);
+            Write(&len, 4);
 
-            fseek(file, pos, SEEK_SET);
+            Seek(pos, SEEK_SET);
         }
 
-        fseek(file, 0, SEEK_END);
-        u32 len = (u32)ftell(file);
-        fseek(file, 8, SEEK_SET);
-        fwrite(&len, 4, 1, file);
+        Seek(0, SEEK_END);
+        u32 len = (u32)Tell();
+        Seek(8, SEEK_SET);
+        Write(&len, 4);
     }
 
     if (file) fclose(file);
@@ -161,29 +177,29 @@ void Savestate::Section(char* magic)
     {
         if (CurSection != -1)
         {
-            u32 pos = (u32)ftell(file);
-            fseek(file, CurSection+4, SEEK_SET);
+            u32 pos = (u32)Tell();
+            Seek(CurSection+4, SEEK_SET);
 
             u32 len = pos - CurSection;
-            fwrite(&len, 4, 1, file);
+            Write(&len, 4);
 
-            fseek(file, pos, SEEK_SET);
+            Seek(pos, SEEK_SET);
         }
 
-        CurSection = (u32)ftell(file);
+        CurSection = (u32)Tell();
 
-        fwrite(magic, 4, 1, file);
-        fseek(file, 12, SEEK_CUR);
+        Write(magic, 4);
+        Seek(12, SEEK_CUR);
     }
     else
     {
-        fseek(file, 0x10, SEEK_SET);
+        Seek(0x10, SEEK_SET);
 
         for (;;)
         {
             u32 buf = 0;
 
-            fread(&buf, 4, 1, file);
+            Read(&buf, 4);
             if (buf != ((u32*)magic)[0])
             {
                 if (buf == 0)
@@ -193,12 +209,12 @@ void Savestate::Section(char* magic)
                 }
 
                 buf = 0;
-                fread(&buf, 4, 1, file);
-                fseek(file, buf-8, SEEK_CUR);
+                Read(&buf, 4);
+                Seek(buf-8, SEEK_CUR);
                 continue;
             }
 
-            fseek(file, 12, SEEK_CUR);
+            Seek(12, SEEK_CUR);
             break;
         }
     }
@@ -210,11 +226,11 @@ void Savestate::Var8(u8* var)
 
     if (Saving)
     {
-        fwrite(var, 1, 1, file);
+        Write(var, 1);
     }
     else
     {
-        fread(var, 1, 1, file);
+        Read(var, 1);
     }
 }
 
@@ -224,11 +240,11 @@ void Savestate::Var16(u16* var)
 
     if (Saving)
     {
-        fwrite(var, 2, 1, file);
+        Write(var, 2);
     }
     else
     {
-        fread(var, 2, 1, file);
+        Read(var, 2);
     }
 }
 
@@ -238,11 +254,11 @@ void Savestate::Var32(u32* var)
 
     if (Saving)
     {
-        fwrite(var, 4, 1, file);
+        Write(var, 4);
     }
     else
     {
-        fread(var, 4, 1, file);
+        Read(var, 4);
     }
 }
 
@@ -252,11 +268,11 @@ void Savestate::Var64(u64* var)
 
     if (Saving)
     {
-        fwrite(var, 8, 1, file);
+        Write(var, 8);
     }
     else
     {
-        fread(var, 8, 1, file);
+        Read(var, 8);
     }
 }
 
@@ -266,10 +282,59 @@ void Savestate::VarArray(void* data, u32 len)
 
     if (Saving)
     {
-        fwrite(data, len, 1, file);
+        Write(data, len);
     }
     else
+    {
+        Read(data, len);
+    }
+}
+
+// files and memory buffers work the same way. seeking past the end and
+// writing there leaves zeroes in between, like it does with files
+void Savestate::Write(void* data, u32 len)
+{
+    if (file)
+    {
+        fwrite(data, len, 1, file);
+        return;
+    }
+
+    if ((BufferPos + len) > Buffer->size())
+        Buffer->resize(BufferPos + len);
+    memcpy(&(*Buffer)[BufferPos], data, len);
+    BufferPos += len;
+}
+
+void Savestate::Read(void* data, u32 len)
+{
+    if (file)
     {
         fread(data, len, 1, file);
+        return;
+    }
+
+    if ((BufferPos + len) > Buffer->size())
+        return;
+    memcpy(data, &(*Buffer)[BufferPos], len);
+    BufferPos += len;
+}
+
+void Savestate::Seek(s32 offset, int origin)
+{
+    if (file)
+    {
+        fseek(file, offset, origin);
+        return;
     }
+
+    if (origin == SEEK_SET)      BufferPos = offset;
+    else if (origin == SEEK_CUR) BufferPos += offset;
+    else                         BufferPos = Buffer->size() + offset;
+}
+
+u32 Savestate::Tell()
+{
+    if (file) return (u32)ftell(file);
+    return BufferPos;
 }
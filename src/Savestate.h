@@ -20,20 +20,26 @@
 #define SAVESTATE_H
 
 #include <stdio.h>
+#include <vector>
 #include "types.h"
 
 #define SAVESTATE_MAJOR 4
-#define SAVESTATE_MINOR 0
+#define SAVESTATE_MINOR 5
 
 class Savestate
 {
 public:
     Savestate(char* filename, bool save);
+    Savestate(std::vector<u8>* buffer, bool save);
     ~Savestate();
 
     bool Error;
 
     bool Saving;
+
+    // the state is in memory (run-ahead). it can only be from this session,
+    // so what's the same as now can be kept as is when loading it
+    bool SameSession;
     u32 VersionMajor;
     u32 VersionMinor;
 
@@ -57,6 +63,16 @@ public:
 
 private:
     FILE* file;
+
+    std::vector<u8>* Buffer;
+    u32 BufferPos;
+
+    void Begin();
+
+    void Write(void* data, u32 len);
+    void Read(void* data, u32 len);
+    void Seek(s32 offset, int origin);
+    u32 Tell();
 };
 
 #endif // SAVESTATE_H
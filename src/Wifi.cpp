@@ -499,7 +499,7 @@ void SendMPDefaultReply()
 	*(u16*)&reply[0xC + 0x16] = IOPORT(W_TXSeqNo) << 4;
 	*(u32*)&reply[0xC + 0x18] = 0;
 
-	int txlen = Platform::MP_SendPacket(reply, 12+28);
+	int txlen = NDS::Speculative ? 0 : Platform::MP_SendPacket(reply, 12+28);
 	WIFI_LOG("wifi: sent %d/40 bytes of MP default reply\n", txlen);
 }
 
@@ -529,7 +529,7 @@ void SendMPAck()
 	*(u16*)&ack[0xC + 0x1A] = 0;
 	*(u32*)&ack[0xC + 0x1C] = 0;
 
-	int txlen = Platform::MP_SendPacket(ack, 12+32);
+	int txlen = NDS::Speculative ? 0 : Platform::MP_SendPacket(ack, 12+32);
 	WIFI_LOG("wifi: sent %d/44 bytes of MP ack, %d %d\n", txlen, ComStatus, RXTime);
 }
 
@@ -653,15 +653,16 @@ bool ProcessTX(TXSlot* slot, int num)
             // set TX addr
             IOPORT(W_RXTXAddr) = slot->Addr >> 1;
 
-            // send
-            int txlen = Platform::MP_SendPacket(&RAM[slot->Addr], 12 + slot->Length);
+            // send. not from frames that get thrown away, they'd be sent
+            // again when the real frame gets there
+            int txlen = NDS::Speculative ? 0 : Platform::MP_SendPacket(&RAM[slot->Addr], 12 + slot->Length);
             WIFI_LOG("wifi: sent %d/%d bytes of slot%d packet, addr=%04X, framectl=%04X, %04X %04X\n",
                      txlen, slot->Length+12, num, slot->Addr, *(u16*)&RAM[slot->Addr + 0xC],
                      *(u16*)&RAM[slot->Addr + 0x24], *(u16*)&RAM[slot->Addr + 0x26]);
 
             // if the packet is being sent via LOC1..3, send it to the AP
             // any packet sent via CMD/REPLY/BEACON isn't going to have much use outside of local MP
-            if (num == 0 || num == 2 || num == 3)
+            if ((num == 0 || num == 2 || num == 3) && !NDS::Speculative)
                 WifiAP::SendPacket(&RAM[slot->Addr], 12 + slot->Length);
 
             if (num == 4)
@@ -814,6 +815,10 @@ bool CheckRX(bool block)
     if (!(IOPORT(W_RXCnt) & 0x8000))
         return false;
 
+    // whatever is received would be lost once the frame is thrown away
+    if (NDS::Speculative)
+        return false;
+
     u16 framelen;
     u16 framectl;
     u8 txrate;
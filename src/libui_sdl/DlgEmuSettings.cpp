@@ -38,6 +38,14 @@ uiWindow* win;
 
 uiCheckbox* cbDirectBoot;
 uiCheckbox* cbThreaded3D;
+uiCheckbox* cbThreaded2D;
+uiCheckbox* cbDeferred2D;
+uiCheckbox* cbJIT;
+uiCheckbox* cbJITARM7;
+uiCheckbox* cbJITCached;
+uiCheckbox* cbDataCache;
+uiCheckbox* cbThreadedARM7;
+uiSpinbox* sbRunAhead;
 uiCheckbox* cbBindAnyAddr;
 
 
@@ -57,6 +65,17 @@ void OnOk(uiButton* btn, void* blarg)
 {
     Config::DirectBoot = uiCheckboxChecked(cbDirectBoot);
     Config::Threaded3D = uiCheckboxChecked(cbThreaded3D);
+    Config::Threaded2D = uiCheckboxChecked(cbThreaded2D);
+    Config::Deferred2D = uiCheckboxChecked(cbDeferred2D);
+    Config::JIT_Enable = uiCheckboxChecked(cbJIT);
+    Config::JIT_EnableARM7 = uiCheckboxChecked(cbJITARM7);
+    Config::JIT_Cached = uiCheckboxChecked(cbJITCached);
+    Config::DataCacheModel = uiCheckboxChecked(cbDataCache);
+    if (!uiCheckboxChecked(cbThreadedARM7))
+        Config::ThreadedARM7 = 0;
+    else if (!Config::ThreadedARM7)
+        Config::ThreadedARM7 = 1; // the checking mode is only set in the ini
+    Config::RunAhead = uiSpinboxValue(sbRunAhead);
     Config::SocketBindAnyAddr = uiCheckboxChecked(cbBindAnyAddr);
 
     Config::Save();
@@ -93,6 +112,37 @@ void Open()
         cbThreaded3D = uiNewCheckbox("Threaded 3D renderer");
         uiBoxAppend(in_ctrl, uiControl(cbThreaded3D), 0);
 
+        cbThreaded2D = uiNewCheckbox("Threaded 2D renderer");
+        uiBoxAppend(in_ctrl, uiControl(cbThreaded2D), 0);
+
+        cbDeferred2D = uiNewCheckbox("Deferred 2D rendering");
+        uiBoxAppend(in_ctrl, uiControl(cbDeferred2D), 0);
+
+        cbJIT = uiNewCheckbox("JIT recompiler (ARM9)");
+        uiBoxAppend(in_ctrl, uiControl(cbJIT), 0);
+
+        cbJITARM7 = uiNewCheckbox("JIT recompiler (ARM7)");
+        uiBoxAppend(in_ctrl, uiControl(cbJITARM7), 0);
+
+        cbJITCached = uiNewCheckbox("JIT: interpret blocks instead of recompiling");
+        uiBoxAppend(in_ctrl, uiControl(cbJITCached), 0);
+
+        cbDataCache = uiNewCheckbox("ARM9 data cache timings");
+        uiBoxAppend(in_ctrl, uiControl(cbDataCache), 0);
+
+        cbThreadedARM7 = uiNewCheckbox("Run the ARM7 on a separate thread (needs JIT off)");
+        uiBoxAppend(in_ctrl, uiControl(cbThreadedARM7), 0);
+
+        uiBox* ra_box = uiNewHorizontalBox();
+        uiBoxSetPadded(ra_box, 1);
+        uiBoxAppend(in_ctrl, uiControl(ra_box), 0);
+
+        uiLabel* label_ra = uiNewLabel("Run-ahead frames:");
+        uiBoxAppend(ra_box, uiControl(label_ra), 0);
+
+        sbRunAhead = uiNewSpinbox(0, 4);
+        uiBoxAppend(ra_box, uiControl(sbRunAhead), 0);
+
         cbBindAnyAddr = uiNewCheckbox("Wifi: bind socket to any address");
         uiBoxAppend(in_ctrl, uiControl(cbBindAnyAddr), 0);
     }
@@ -116,6 +166,14 @@ void Open()
 
     uiCheckboxSetChecked(cbDirectBoot, Config::DirectBoot);
     uiCheckboxSetChecked(cbThreaded3D, Config::Threaded3D);
+    uiCheckboxSetChecked(cbThreaded2D, Config::Threaded2D);
+    uiCheckboxSetChecked(cbDeferred2D, Config::Deferred2D);
+    uiCheckboxSetChecked(cbJIT, Config::JIT_Enable);
+    uiCheckboxSetChecked(cbJITARM7, Config::JIT_EnableARM7);
+    uiCheckboxSetChecked(cbJITCached, Config::JIT_Cached);
+    uiCheckboxSetChecked(cbDataCache, Config::DataCacheModel);
+    uiCheckboxSetChecked(cbThreadedARM7, Config::ThreadedARM7 != 0);
+    uiSpinboxSetValue(sbRunAhead, Config::RunAhead);
     uiCheckboxSetChecked(cbBindAnyAddr, Config::SocketBindAnyAddr);
 
     uiControlShow(uiControl(win));
@@ -134,6 +134,11 @@ void Thread_Wait(void* thread)
     SDL_WaitThread((SDL_Thread*)((ThreadData*)thread)->ID, NULL);
 }
 
+void Thread_Yield()
+{
+    SDL_Delay(0);
+}
+
 
 void* Semaphore_Create()
 {
@@ -400,6 +400,11 @@ int EmuThreadFunc(void* burp)
 
     bool lastlidcmd = false;
 
+    FILE* statsfile = NULL;
+    bool statsfailed = false;
+
+    std::vector<u8> runaheadstate;
+
     Uint8* joybuttons = NULL; int njoybuttons = 0;
     if (Joystick)
     {
@@ -510,6 +515,40 @@ int EmuThreadFunc(void* burp)
 
             if (EmuRunning == 0) break;
 
+            if (Config::FrameProfilingCSV[0] && !statsfailed)
+            {
+                if (!statsfile)
+                {
+                    statsfile = melon_fopen(Config::FrameProfilingCSV, "w");
+                    if (statsfile) NDS::WriteFrameStatsCSV(statsfile, true);
+                    else
+                    {
+                        printf("can't open %s for the frame stats\n", Config::FrameProfilingCSV);
+                        statsfailed = true;
+                    }
+                }
+
+                if (statsfile) NDS::WriteFrameStatsCSV(statsfile, false);
+            }
+
+            // run-ahead: the frame above is the real one. the next ones are
+            // only run to show the last of them, then it goes back
+            if (Config::RunAhead > 0)
+            {
+                Savestate* state = new Savestate(&runaheadstate, true);
+                NDS::DoSavestate(state);
+                delete state;
+
+                NDS::SetSpeculative(true);
+                for (int i = 0; i < Config::RunAhead; i++)
+                    NDS::RunFrame();
+                NDS::SetSpeculative(false);
+
+                state = new Savestate(&runaheadstate, false);
+                NDS::DoSavestate(state);
+                delete state;
+            }
+
             // auto screen layout
             {
                 MainScreenPos[2] = MainScreenPos[1];
@@ -603,6 +642,7 @@ int EmuThreadFunc(void* burp)
 
     EmuStatus = 0;
 
+    if (statsfile) fclose(statsfile);
     if (joybuttons) delete[] joybuttons;
 
     NDS::DeInit();
@@ -1625,6 +1665,7 @@ void ApplyNewSettings()
     while (EmuStatus != 2);
 
     GPU3D::SoftRenderer::SetupRenderThread();
+    GPU::SetupRender2DThread();
 
     if (Wifi::MPInited)
     {
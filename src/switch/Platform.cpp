@@ -52,6 +52,11 @@ void Thread_Wait(void* thread)
     threadWaitForExit((Thread*)thread);
 }
 
+void Thread_Yield()
+{
+    svcSleepThread(0);
+}
+
 void* Semaphore_Create()
 {
     Semaphore* sema = (Semaphore*)malloc(sizeof(Semaphore));
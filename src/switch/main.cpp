@@ -127,6 +127,13 @@ const vector<Setting> Settings =
 {
     { "Boot Game Directly",                 { "Off", "On" },                                                               &Config::DirectBoot },
     { "Threaded 3D Renderer",               { "Off", "On" },                                                               &Config::Threaded3D },
+    { "Threaded 2D Renderer",               { "Off", "On" },                                                               &Config::Threaded2D },
+    { "Deferred 2D Rendering",              { "Off", "On" },                                                               &Config::Deferred2D },
+    { "Cached Interpreter (ARM9)",          { "Off", "On" },                                                               &Config::JIT_Enable },
+    { "Cached Interpreter (ARM7)",          { "Off", "On" },                                                               &Config::JIT_EnableARM7 },
+    { "ARM9 Data Cache Timings",            { "Off", "On" },                                                               &Config::DataCacheModel },
+    { "Threaded ARM7",                      { "Off", "On", "On (Checked)" },                                               &Config::ThreadedARM7 },
+    { "Run-Ahead",                          { "Off", "1 Frame", "2 Frames" },                                              &Config::RunAhead },
     { "Audio Volume",                       { "0%", "25%", "50%", "75%", "100%" },                                         &Config::AudioVolume },
     { "Microphone Input",                   { "None", "Microphone", "White Noise" },                                       &Config::MicInputType },
     { "Separate Savefiles from Savestates", { "Off", "On" },                                                               &Config::SavestateRelocSRAM },
@@ -819,11 +826,31 @@ void SetScreenLayout()
 
 void RunCore(void *args)
 {
+    vector<u8> runaheadstate;
+
     while (!(HotkeyMask & BIT(HK_Menu)))
     {
         chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
         NDS::RunFrame();
+
+        // run-ahead: only the first frame is kept, the others are just shown
+        if (Config::RunAhead > 0)
+        {
+            Savestate *state = new Savestate(&runaheadstate, true);
+            NDS::DoSavestate(state);
+            delete state;
+
+            NDS::SetSpeculative(true);
+            for (int i = 0; i < Config::RunAhead; i++)
+                NDS::RunFrame();
+            NDS::SetSpeculative(false);
+
+            state = new Savestate(&runaheadstate, false);
+            NDS::DoSavestate(state);
+            delete state;
+        }
+
         memcpy(DisplayBuffer, GPU::Framebuffer, sizeof(GPU::Framebuffer));
 
         chrono::duration<double> elapsed = chrono::steady_clock::now() - start;